@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "app_events.hpp"
+#include "threading/thread.hxx"
+#include "util/command_stream.hxx"
+
+namespace k {
+namespace app {
+
+typedef CommandStream<AppClientCommand> ClientCommandStream;
+
+// Fixed size data for AppClientCommand records (trivially copyable; see CommandStream::write()).
+namespace ClientCommand {
+
+    // APP_SET_WORKER_THREAD_COUNT (0 => size automatically; see ThreadManager::setWorkerCount())
+    struct SetWorkerThreadCount { uint32_t count; };
+
+    // WINDOW_SET_TITLE: inline string = window name + title, split at nameLength
+    struct SetWindowTitle { uint32_t nameLength; };
+
+    // CREATE_WINDOW / DESTROY_WINDOW: inline string = window name (no fixed size data)
+
+} // namespace ClientCommand
+
+//
+// Client -> main thread command path (AppInstance::commands).
+//
+// Each client thread (AppClient / module threads) writes its commands into its own
+// ClientCommandStream (SPSC, see util/command_stream.hxx), and publishes them w/ publish(): the
+// main thread dispatches published commands as soon as they arrive, instead of at a frame boundary
+// (see dispatchClientCommands()).
+//
+//  auto& commands = app.commands.writer();                 // client thread, once
+//  commands.setWindowTitle("main", "Hello");
+//  commands.setWorkerThreadCount(4);
+//  commands.publish();                                     // flush + wake the main thread
+//
+//  void onAwaitTasks (KThread&) override {                 // main thread
+//      dispatchClientCommands(app);
+//  }
+//
+// – writer() hands out one Writer per calling thread; it's kept (+ reused) until the queue is
+//   destroyed, so a thread can call writer() again to get the same one back.
+// – publish() wakes the main thread (setReceiver(); see KThread::wake()).
+// – commands from one thread are dispatched in write order; there is no order between threads.
+//
+class ClientCommandQueue {
+public:
+    static constexpr size_t MAX_WRITERS = 64;
+
+    class Writer {
+        ClientCommandQueue& queue;
+        ClientCommandStream stream;
+        std::thread::id     owner;
+        friend class ClientCommandQueue;
+    public:
+        Writer (ClientCommandQueue& queue, std::thread::id owner) : queue(queue), owner(owner) {}
+
+        void createWindow  (std::string_view name) { stream.writeString(AppClientCommand::CREATE_WINDOW, name); }
+        void destroyWindow (std::string_view name) { stream.writeString(AppClientCommand::DESTROY_WINDOW, name); }
+        void setWindowTitle (std::string_view name, std::string_view title) {
+            std::string value;
+            value.reserve(name.size() + title.size());
+            value.append(name).append(title);
+            stream.writeString(AppClientCommand::WINDOW_SET_TITLE,
+                ClientCommand::SetWindowTitle { (uint32_t)name.size() }, value);
+        }
+        void setWorkerThreadCount (uint32_t count) {
+            stream.write(AppClientCommand::APP_SET_WORKER_THREAD_COUNT, ClientCommand::SetWorkerThreadCount { count });
+        }
+
+        // Publish all commands written so far to the main thread.
+        void publish () {
+            stream.flush();
+            if (auto thread = queue.receiver.load(std::memory_order_acquire))
+                thread->wake();
+        }
+    };
+
+    ClientCommandQueue () {}
+    ClientCommandQueue (const ClientCommandQueue&) = delete;
+    ClientCommandQueue& operator= (const ClientCommandQueue&) = delete;
+    ~ClientCommandQueue () {
+        for (size_t i = 0, n = writerCount.load(std::memory_order_acquire); i < n; ++i)
+            delete writers[i].load(std::memory_order_relaxed);
+    }
+
+    // Main thread to wake on publish() (nullptr => none). Set before clients start writing.
+    void setReceiver (thread::KThread* thread) { receiver.store(thread, std::memory_order_release); }
+
+    // Writer for the calling thread (created on first use). Throws std::length_error beyond
+    // MAX_WRITERS threads.
+    Writer& writer () {
+        auto self = std::this_thread::get_id();
+        for (size_t i = 0, n = writerCount.load(std::memory_order_acquire); i < n; ++i) {
+            auto writer = writers[i].load(std::memory_order_relaxed);
+            if (writer->owner == self)
+                return *writer;
+        }
+        std::lock_guard<std::mutex> lock (writerMutex);
+        auto n = writerCount.load(std::memory_order_relaxed);
+        if (n == MAX_WRITERS)
+            throw std::length_error("ClientCommandQueue: too many writer threads");
+        auto writer = new Writer(*this, self);
+        writers[n].store(writer, std::memory_order_relaxed);
+        writerCount.store(n + 1, std::memory_order_release);
+        return *writer;
+    }
+
+    // Main thread: call fn(AppClientCommand, ClientCommandStream&) for each published command (fn
+    // must read the command's data). Returns the number of commands dispatched.
+    template <typename F>
+    size_t dispatch (const F& fn) {
+        size_t count = 0;
+        for (size_t i = 0, n = writerCount.load(std::memory_order_acquire); i < n; ++i) {
+            auto& stream = writers[i].load(std::memory_order_relaxed)->stream;
+            for (auto command = stream.readNext(); command != AppClientCommand::NONE; command = stream.readNext()) {
+                fn(command, stream);
+                ++count;
+            }
+        }
+        return count;
+    }
+private:
+    std::atomic<Writer*>            writers[MAX_WRITERS] {};    // [0, writerCount) in use
+    std::atomic<size_t>             writerCount { 0 };
+    std::mutex                      writerMutex;                // writer() registration
+    std::atomic<thread::KThread*>   receiver { nullptr };
+};
+
+struct AppInstance;
+
+// Main thread: run all published client commands against app (ThreadManager, WindowManager).
+// Returns the number of commands run.
+size_t dispatchClientCommands (AppInstance& app);
+
+}; // namespace app
+}; // namespace k
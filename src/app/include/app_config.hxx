@@ -1,11 +1,16 @@
 
 #pragma once
 
+#include <cstddef>
+#include "threading/thread_affinity.hxx"
+
 namespace k {
 namespace app {
 
 struct AppConfig {
-
+    size_t                      workerThreads = 0;  // worker pool size; 0 => one per hardware thread (minus main)
+    bool                        autoScaleWorkers = false;   // resize the pool from load (see k::thread::AutoScaleConfig)
+    k::thread::AffinityConfig   affinity;           // thread placement (core pinning); default: NONE (set AUTO to opt in)
 };
 
 }
@@ -131,9 +131,8 @@ enum class AppClientCommand {
     APP_FORCE_RELOAD,
     APP_FORCE_SHUTDOWN,
 
-    APP_SET_WORKER_THREAD_COUNT,
-    APP_SET_MODULE_TASK_PRIORITY,
-    APP_SET_
+    APP_SET_WORKER_THREAD_COUNT,    // ThreadManager::setWorkerCount() (0 = auto)
+    APP_SET_MODULE_TASK_PRIORITY,   // k::thread::TaskPriority for a module's thread tasks
 
     DISPATCH_ASYNC_TASK,
 
@@ -141,6 +140,8 @@ enum class AppClientCommand {
 
     CANCEL_WINDOW_REMOVAL,
     CANCEL_APP_SHUTDOWN,
+
+    NONE,   // no command (ClientCommandStream::readNext(): nothing published yet)
 };
 
 
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <chrono>
+
 namespace k {
 namespace app {
 
@@ -9,6 +11,10 @@ struct FrameInfo {
         double dt;          // delta-time since last frame
         double localTime;   // local time since app startup
     } time;
+
+    // When this frame should be done (next buffer swap / vsync). Pinned threads use it to run
+    // slack tasks in their idle time before it (see ThreadManager::setFrameDeadline()).
+    std::chrono::steady_clock::time_point deadline;
 };
 
 }; // namespace app
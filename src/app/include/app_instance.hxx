@@ -7,6 +7,7 @@
 #include "app_thread_manager.hxx"
 #include "app_device_manager.hxx"
 #include "app_event_manager.hxx"
+#include "app_client_commands.hxx"
 
 namespace k {
 namespace app {
@@ -19,6 +20,7 @@ struct AppInstance {
     WindowManager window;   // window creation + management
     DeviceManager device;   // input device querying (state, etc)
     EventManager  event;    // event querying (register event listeners, etc)
+    ClientCommandQueue commands;    // client -> main thread commands (see app_client_commands.hxx)
     //AppLogger     log;      // thread-safe logging subsystem
 
     // Note: this class is NOT user creatable or copyable.
@@ -1,10 +1,118 @@
-
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "app_frame_info.hxx"
+#include "threading/thread.hxx"
+#include "threading/coroutine_task.hxx"
+#include "threading/parallel.hxx"
+#include "threading/thread_affinity.hxx"
+
 namespace k {
+namespace thread { class JobScheduler; }
 namespace app {
 
-class ThreadManager {};
+// Owns the app's worker pool (a work stealing k::thread::JobScheduler).
+// Accessed via AppInstance::thread.
+//
+// – post() schedules a stealable job on any worker (load balanced across cores).
+// – pinned threads (main, GL, window threads) help run jobs when their own queues are empty;
+//   attach them w/ attachPinnedThread(), and detach them w/ detachPinnedThread() before they're
+//   destroyed (window threads come + go while the app runs).
+// – thread placement (core pinning) follows AppConfig::affinity: workers are pinned by start();
+//   named threads ("main", "gl") pin themselves w/ pinCurrentThread(); window threads get their
+//   cpus (affinity().cpusFor("window")) when created.
+// – coroutine tasks (thread::Task<T>) run on the pool via spawn(); co_await nextFrame(frames)
+//   resumes them on the next frame.
+// – pinned threads run slack tasks (KThread::postSlackTask(): resource GC, cache compaction, stats
+//   flushing, ...) in their idle time before the frame deadline; the frame loop passes it on w/
+//   setFrameDeadline().
+// – data parallel loops (parallel_for / parallel_reduce / parallel_sort) split over the pool; the
+//   calling thread helps run them (see threading/parallel.hxx).
+//
+class ThreadManager {
+    std::unique_ptr<thread::JobScheduler> scheduler;
+    thread::AffinityPlan                  placement;
+    thread::AutoScaleConfig               autoScale;
+    std::vector<thread::KThread*>         pinnedThreads;
+    mutable std::mutex                    pinnedMutex;      // pinnedThreads
+public:
+    ThreadManager ();
+    ~ThreadManager ();
+
+    // Start / stop the worker pool. workerCount = 0 => one worker per hardware thread (minus main).
+    // Workers are pinned per affinity (see thread::AffinityConfig).
+    // stop() detaches pinned threads (attach them again after a restart), then runs all remaining
+    // jobs before joining workers.
+    void start (size_t workerCount = 0, const thread::AffinityConfig& affinity = thread::AffinityConfig());
+    void stop  ();
+    bool isRunning () const { return (bool)scheduler; }
+
+    // Post a stealable job. Must be running. BACKGROUND jobs only run when workers are otherwise idle.
+    void post (thread::ThreadTask task, thread::TaskPriority priority = thread::TaskPriority::NORMAL);
+
+    // Run one pending (non BACKGROUND) job on the calling thread; returns false if there was none.
+    bool help ();
+
+    // Let a pinned thread help w/ jobs when idle (see KThread::setJobScheduler()), and get frame
+    // deadlines. Must be running; attach before the frame loop starts.
+    void attachPinnedThread (thread::KThread& thread);
+
+    // Stop a pinned thread from helping (waits for a job it's running) + getting frame deadlines.
+    // Call before destroying an attached thread. Any thread; no-op if it isn't attached.
+    void detachPinnedThread (thread::KThread& thread);
+
+    // Frame loop: pass the current frame's deadline (FrameInfo::deadline) to all pinned threads,
+    // once per frame, so they know how much slack they have for slack tasks.
+    void setFrameDeadline (const FrameInfo& frame);
+
+    size_t workerCount () const;
+
+    // Resize the worker pool at runtime (AppEvent::APP_SET_WORKER_THREAD_COUNT). Removed workers
+    // drain their queued jobs first. count = 0 => size automatically (see setAutoScaleConfig()).
+    // Must be running; not callable from a job.
+    void setWorkerCount (size_t count);
+
+    // Auto sizing parameters, used by setWorkerCount(0).
+    void setAutoScaleConfig (const thread::AutoScaleConfig& config);
+
+    // Pin the calling thread per its name ("main", "gl", "window"); call at thread start.
+    // Returns false if the plan doesn't pin this thread (or pinning is unsupported).
+    bool pinCurrentThread (const std::string& name);
+
+    // Cpu sets per thread name, as planned by start().
+    const thread::AffinityPlan& affinity () const { return placement; }
+
+    // Executor for coroutine tasks on the worker pool. Must be running.
+    thread::TaskExecutor executor (thread::TaskPriority priority = thread::TaskPriority::NORMAL);
+
+    // Start a coroutine task on the worker pool (detached). Must be running.
+    template <typename T>
+    void spawn (thread::Task<T> task, thread::TaskPriority priority = thread::TaskPriority::NORMAL) {
+        thread::spawn(executor(priority), std::move(task));
+    }
+
+    // Data parallel algorithms on the worker pool (serial if not running); see thread::parallel_for().
+    template <typename F>
+    void parallel_for (thread::IndexRange range, size_t grain, const F& fn) {
+        thread::parallel_for(scheduler.get(), range, grain, fn);
+    }
+    template <typename T, typename Map, typename Combine>
+    T parallel_reduce (thread::IndexRange range, size_t grain, T identity, const Map& map, const Combine& combine) {
+        return thread::parallel_reduce(scheduler.get(), range, grain, std::move(identity), map, combine);
+    }
+    template <typename It, typename Compare = std::less<>>
+    void parallel_sort (It first, It last, Compare comp = Compare()) {
+        thread::parallel_sort(scheduler.get(), first, last, comp);
+    }
+
+    // Signaled once per frame by the frame loop (see thread::nextFrame()).
+    thread::FrameSignal frames;
+
+    // Underlying scheduler (stats, etc). Must be running.
+    thread::JobScheduler& jobs () { return *scheduler; }
+};
 
 }; // namespace app
 }; // namespace k
@@ -0,0 +1,34 @@
+#include "app_client_commands.hxx"
+#include "app_instance.hxx"
+#include <cassert>
+#include <string>
+
+namespace k {
+namespace app {
+
+size_t dispatchClientCommands (AppInstance& app) {
+    return app.commands.dispatch([&app](AppClientCommand command, ClientCommandStream& stream) {
+        switch (command) {
+            case AppClientCommand::CREATE_WINDOW:
+                app.window[std::string(stream.readString())].create();
+                break;
+            case AppClientCommand::DESTROY_WINDOW:
+                app.window[std::string(stream.readString())].destroy();
+                break;
+            case AppClientCommand::WINDOW_SET_TITLE: {
+                auto length = stream.read<ClientCommand::SetWindowTitle>()->nameLength;
+                auto value  = stream.readString();
+                app.window[std::string(value.substr(0, length))].title.set(std::string(value.substr(length)));
+            } break;
+            case AppClientCommand::APP_SET_WORKER_THREAD_COUNT:
+                app.thread.setWorkerCount(stream.read<ClientCommand::SetWorkerThreadCount>()->count);
+                break;
+            default:
+                // Only written through ClientCommandQueue::Writer, so we know every record's layout.
+                assert(false && "Unhandled AppClientCommand");
+        }
+    });
+}
+
+}; // namespace app
+}; // namespace k
@@ -1,2 +1,87 @@
 
 #include "app_thread_manager.hxx"
+#include "threading/job_scheduler.hxx"
+#include <algorithm>
+#include <cassert>
+
+namespace k {
+namespace app {
+
+ThreadManager::ThreadManager () {}
+ThreadManager::~ThreadManager () { stop(); }
+
+void ThreadManager::start (size_t workerCount, const thread::AffinityConfig& affinity) {
+    assert(!scheduler && "ThreadManager already started");
+    scheduler.reset(new thread::JobScheduler(workerCount));
+
+    // Plan for every worker slot, so workers added by a resize get pinned too.
+    placement = thread::AffinityPlan(thread::CpuTopology::detect(), affinity, scheduler->maxWorkerCount());
+    for (size_t i = 0; i < scheduler->maxWorkerCount(); ++i)
+        scheduler->setWorkerAffinity(i, placement.cpusFor("worker." + std::to_string(i)));
+}
+void ThreadManager::stop () {
+    // Detach pinned threads first (waits for jobs they're running), so none of them touches the
+    // scheduler once it's gone.
+    std::vector<thread::KThread*> threads;
+    {
+        std::lock_guard<std::mutex> lock (pinnedMutex);
+        threads.swap(pinnedThreads);
+    }
+    for (auto thread : threads)
+        thread->setJobScheduler(nullptr);
+    scheduler.reset();
+}
+
+void ThreadManager::post (thread::ThreadTask task, thread::TaskPriority priority) {
+    assert(scheduler && "ThreadManager not started");
+    scheduler->post(std::move(task), priority);
+}
+bool ThreadManager::help () {
+    return scheduler && scheduler->runOne(thread::JobFilter::NO_BACKGROUND);
+}
+void ThreadManager::attachPinnedThread (thread::KThread& thread) {
+    assert(scheduler && "ThreadManager not started");
+    thread.setJobScheduler(scheduler.get());
+    std::lock_guard<std::mutex> lock (pinnedMutex);
+    pinnedThreads.push_back(&thread);
+}
+void ThreadManager::detachPinnedThread (thread::KThread& thread) {
+    {
+        std::lock_guard<std::mutex> lock (pinnedMutex);
+        auto it = std::find(pinnedThreads.begin(), pinnedThreads.end(), &thread);
+        if (it == pinnedThreads.end())
+            return;
+        pinnedThreads.erase(it);
+    }
+    thread.setJobScheduler(nullptr);
+}
+void ThreadManager::setFrameDeadline (const FrameInfo& frame) {
+    std::lock_guard<std::mutex> lock (pinnedMutex);
+    for (auto thread : pinnedThreads)
+        thread->setFrameDeadline(frame.deadline);
+}
+size_t ThreadManager::workerCount () const {
+    return scheduler ? scheduler->workerCount() : 0;
+}
+void ThreadManager::setWorkerCount (size_t count) {
+    assert(scheduler && "ThreadManager not started");
+    if (count) {
+        scheduler->disableAutoScale();
+        scheduler->setWorkerCount(count);
+    } else {
+        scheduler->enableAutoScale(autoScale);
+    }
+}
+void ThreadManager::setAutoScaleConfig (const thread::AutoScaleConfig& config) {
+    autoScale = config;
+}
+bool ThreadManager::pinCurrentThread (const std::string& name) {
+    return thread::setCurrentThreadAffinity(placement.cpusFor(name));
+}
+thread::TaskExecutor ThreadManager::executor (thread::TaskPriority priority) {
+    assert(scheduler && "ThreadManager not started");
+    return thread::TaskExecutor(*scheduler, priority);
+}
+
+}; // namespace app
+}; // namespace k
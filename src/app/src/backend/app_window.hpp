@@ -129,19 +129,19 @@ public:
     static std::unique_ptr<KThread> mainThread;
     using moodycamel::ConcurrentQueue;
 
-    static void dispatchMainThread (std::function<void()> cb) {
-        mainThread.dispatch(cb);
+    static void dispatchMainThread (k::thread::ThreadTask&& cb) {
+        mainThread.dispatch(std::move(cb));
     }
 
-    void dispatch (std::function<void()> cb) {
-        queue.enqueue(cb);
+    void dispatch (k::thread::ThreadTask&& cb) {
+        queue.enqueue(std::move(cb));
     }
 protected:
-    ConcurrentQueue<std::function<void()>   queue;
+    ConcurrentQueue<k::thread::ThreadTask>  queue;
     std::atomic<bool>                       keepRunning;
 
     void flushQueue () {
-        std::function<void()> item;
+        k::thread::ThreadTask item;
         while (queue.try_dequeue(item)) {
             try {
                 item();
@@ -1,8 +1,9 @@
 
 #include "window_thread.hxx"
-#include <readerwriterqueue.h>
+#include "threading/channel.hxx"
 #include <boost/variant.hpp>
 #include <cassert>
+#include <chrono>
 
 namespace k {
 namespace app {
@@ -10,21 +11,24 @@ namespace backend {
 
 typedef boost::variant<
     WindowThreadCommand::RebindWindow,
-    WindowThreadCommand::DispatchEvents,
     WindowThreadCommand::Kill,
 > WindowThreadTask;
 
+// Max queued commands per window thread (send() fails beyond this).
+static constexpr size_t WINDOW_COMMAND_CAPACITY = 256;
+
 class WindowThread::Impl : public ThreadWorker, public boost::static_visitor<WindowThreadTask> {
     std::shared_ptr<Window>       window;       // our window (partial ownership)
     std::shared_ptr<MainThread>   mainThread;   // handle to main thread for communication, etc.
     std::weak_ptr<WindowThread>   windowThread; // handle to "this" thread (public WindowThread interface)
+    thread::CpuSet                cpus;         // placement (see AffinityPlan: "window")
 
-    ReaderWriterQueue<WindowThreadTask> queue;
+    thread::Channel<WindowThreadTask>   queue { WINDOW_COMMAND_CAPACITY };     // any thread -> window thread
     std::thread                         thread;
     friend class WindowThread;
 public:
-    Impl (WindowThread& worker, decltype(window) window, decltype(mainThread) mainThread) :
-        window(window), mainThread(mainThread), thread(&WindowThread::Impl::launch, this) 
+    Impl (WindowThread& worker, decltype(window) window, decltype(mainThread) mainThread, thread::CpuSet cpus) :
+        window(window), mainThread(mainThread), cpus(std::move(cpus)), thread(&WindowThread::Impl::launch, this) 
     {
         thread.start();
     }
@@ -34,6 +38,8 @@ public:
     //
 
     void onThreadInit () {
+        if (!cpus.empty())
+            thread::setCurrentThreadAffinity(cpus);
         mainThread->send(MainThreadCommand::NotifyWindowThreadCreated{ windowThread, window });
     }
     void onThreadExit () {
@@ -47,9 +53,11 @@ public:
         mainThread->send(MainThreadCommand::NotifyChildThreadException{ windowThread, e, loc });
     }   
     bool maybeRunTask () {
-        WindowThreadTask task;
-        queue.wait_dequeue(task);
-        boost::apply_visitor(*this, task);
+        // Run all queued commands at once; sleep on the channel (until a send) if there are none.
+        auto run = [this](WindowThreadTask&& task) { boost::apply_visitor(*this, task); };
+        if (queue.drain(run))
+            return true;
+        return queue.wait(std::chrono::microseconds(0)) && queue.drain(run);
     }
 
     //
@@ -66,17 +74,14 @@ public:
         // Replace window reference (no notifications)
         window = command.window;
     }
-    void operator()(const WindowThreadCommand::DispatchEvents& command) {
-            
-        // Dispatch window events...
-    }
 };
 
 WindowThread::WindowThread (
     const std::string& name,
     std::weak_ptr<Window> window,
     std::shared_ptr<MainThread> mainThread,
-) : AppThread(name), impl(new WindowThread::Impl(*this, window, mainThread));
+    thread::CpuSet cpus,
+) : AppThread(name), impl(new WindowThread::Impl(*this, window, mainThread, std::move(cpus)));
 
 // Set a backreference to the shared_ptr owning 'this'; called from WindowThread::create().
 void WindowThread::setSelfRef (std::weak_ptr<WindowThread> ptrToSelf) {
@@ -86,14 +91,13 @@ void WindowThread::setSelfRef (std::weak_ptr<WindowThread> ptrToSelf) {
 bool WindowThread::isRunning () override {
     return impl->isRunning();
 }
-void WindowThread::send (const WindowThreadCommand::Kill& command) {
-    impl->queue.enqueue(WindowThreadTask { command });
-}
-void WindowThread::send (const WindowThreadCommand::RebindWindow& command) {
-    impl->queue.enqueue(WindowThreadTask { command });
+// Commands sent to a thread that has stopped would never run (+ a full queue would never drain),
+// so fail fast instead of waiting on the channel.
+bool WindowThread::send (const WindowThreadCommand::Kill& command) {
+    return impl->isRunning() && impl->queue.trySend(WindowThreadTask { command });
 }
-void WindowThread::send (const WindowThreadCommand::DispatchEvents& command) {
-    impl->queue.enqueue(WindowThreadTask { command });
+bool WindowThread::send (const WindowThreadCommand::RebindWindow& command) {
+    return impl->isRunning() && impl->queue.trySend(WindowThreadTask { command });
 }
 
 } // namespace backend
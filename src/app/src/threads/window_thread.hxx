@@ -4,6 +4,7 @@
 #include "main_thread.hxx"
 #include "base_app_thread.hxx"
 #include "util/command_buffer.hxx"      // maybe use this, or replace w/ boost::variant
+#include "threading/thread_affinity.hxx"
 
 namespace k {
 namespace app {
@@ -19,11 +20,6 @@ namespace WindowThreadCommand {
     struct RebindWindow {
         std::weak_ptr<Window> window;     // can be null
     };
-
-    // Dispatch an event list (dispatches all relevant events via AppWindow methods on the target thread)
-    struct DispatchEvents {
-        std::unique_ptr<CommandBuffer<kAppEvent>> events;
-    };
 } // namespace WindowThreadCommand
 
 
@@ -41,29 +37,30 @@ class WindowThread : public AppThread {
 private:
     // Creates + runs a thread w/ partial ownership of window and responsibility
     // for running per-thread tasks on that window (GL calls, etc).
+    // The thread pins itself to cpus at start (ThreadManager::affinity().cpusFor("window"));
+    // empty => not pinned.
     WindowThread (
         std::string                  name,
         std::shared_ptr<AppWindow>&  window,
         std::shared_ptr<MainThread>& mainThread,
+        thread::CpuSet               cpus = thread::CpuSet(),
     );
     void setSelfRef (std::weak_ptr<WindowThread>);
 public:
     // AppThread methods
     bool isRunning () override;
 
-    // Send a message (Command) to be run on that window.
-    // WARNING:
-    //  Uses a single producer / single consumer queue internally (moodycamel::ReaderWriterQueue),
-    //  so these methods should ONLY be called from the main thread (which owns + manages multiple
-    //  child AppThreads).
+    // Send a message (Command) to be run on that window. Any thread (main, module workers, GL
+    // thread, ...): commands go through a bounded multi producer channel (thread::Channel).
+    // Never blocks: returns false (+ drops the command) if the window thread isn't running (eg.
+    // after Kill), or is WINDOW_COMMAND_CAPACITY commands behind (stalled).
     //
-    //  Likewise, AppWindow is only expected to be accessed from this thread (outside of event
-    //  collection, which must be run on the main thread).
+    // Note: AppWindow is only expected to be accessed from this thread (outside of event
+    // collection, which must be run on the main thread).
     //
 
-    void send (const WindowThreadCommand::Kill&);
-    void send (const WindowThreadCommand::RebindWindow&);
-    void send (const WindowThreadCommand::DispatchEvents&);
+    bool send (const WindowThreadCommand::Kill&);
+    bool send (const WindowThreadCommand::RebindWindow&);
 
     template <typename... Args>
     static auto create (Args... args) {
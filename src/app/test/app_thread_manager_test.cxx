@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "app_thread_manager.hxx"
+#include "threading/job_scheduler.hxx"
+
+using namespace k;
+
+struct TestWorker : public thread::IThreadWorker {
+    bool onTaskException (thread::ThreadTask&, const std::exception&) override { return true; }
+    bool onInternalException (thread::KThread&, thread::ThreadErrorLocation, const std::exception&) override { return true; }
+};
+
+// Pinned thread (eg. a window thread) running on its own std::thread; stopped + joined on destruction.
+struct TestThread {
+    thread::KThread thread { new TestWorker() };
+    std::thread     runner;
+
+    TestThread () {
+        runner = std::thread([this]() { thread.runMainLoop(); });
+        while (!thread.isRunning())
+            std::this_thread::yield();
+    }
+    ~TestThread () {
+        thread.setRunning(false);
+        runner.join();
+    }
+};
+
+static app::FrameInfo frameEndingIn (std::chrono::milliseconds ms) {
+    app::FrameInfo frame {};
+    frame.deadline = std::chrono::steady_clock::now() + ms;
+    return frame;
+}
+
+TEST(ThreadManager, DetachedPinnedThreadCanBeDestroyedBeforeStop) {
+    app::ThreadManager threads;
+    threads.start(1);
+
+    TestThread main;
+    auto window = std::make_unique<TestThread>();
+    threads.attachPinnedThread(main.thread);
+    threads.attachPinnedThread(window->thread);
+    threads.setFrameDeadline(frameEndingIn(std::chrono::milliseconds(16)));
+
+    // Window closes: detach, then destroy its thread while the app keeps running.
+    threads.detachPinnedThread(window->thread);
+    window.reset();
+    threads.setFrameDeadline(frameEndingIn(std::chrono::milliseconds(16)));
+
+    std::atomic<int> ran { 0 };
+    for (int i = 0; i < 10; ++i)
+        threads.post([&]() { ran.fetch_add(1); });
+    threads.stop();     // runs remaining jobs; only touches the main thread
+    EXPECT_EQ(ran.load(), 10);
+}
+
+TEST(ThreadManager, DetachIsNoOpForUnattachedThreads) {
+    app::ThreadManager threads;
+    threads.start(1);
+    TestThread t;
+    threads.detachPinnedThread(t.thread);
+    threads.attachPinnedThread(t.thread);
+    threads.detachPinnedThread(t.thread);
+    threads.detachPinnedThread(t.thread);
+    threads.stop();
+}
@@ -1,6 +1,7 @@
 
 #pragma once
 #include "concurrentqueue.h"
+#include "threading/idle_strategy.hxx"
 #include <thread>
 #include <atomic>
 
@@ -15,11 +16,13 @@ public:
     KThread& operator= (const KThread&) = delete;
     virtual ~KThread () {}
 
-    void kill       () { m_keepRunning = false; }
+    void kill       () { m_keepRunning = false; m_idle.wake(); }
     bool isRunning  () const { return m_isRunning; }
     void exec       (const ThreadEvent& ev) {
         eventQueue.enqueue(ev);
+        m_idle.wake();
     }
+    k::thread::IdleStats idleStats () const { return m_idle.stats(); }
     static KThread* mainThread () { return g_mainThread; }
     static KThread* glThread   () { return g_glThread;   }
 protected:
@@ -52,10 +55,11 @@ protected:
         Impl::ThreadEvent ev;
         while (m_keepRunning) {
             tryExec([&this](){
-                if (static_cast<Impl*>(this)->maybeUpdate()) {}
-                else if (m_eventQueue.try_dequeue(ev)) { ev(); }
+                if (static_cast<Impl*>(this)->maybeUpdate()) { m_idle.reset(); }
+                else if (m_eventQueue.try_dequeue(ev)) { m_idle.reset(); ev(); }
                 else {
                     static_cast<Impl*>(this->onQueueEmpty());
+                    m_idle.idle([this]() { return m_eventQueue.size_approx() != 0 || !m_keepRunning; });
                 }
             });
         }
@@ -64,6 +68,7 @@ private:
     ConcurrentQueue<ThreadEvent>  m_eventQueue;
     std::atomic<bool>             m_keepRunning = false;
     std::atomic<bool>             m_isRunning   = false;
+    k::thread::IdleStrategy       m_idle;       // spin -> yield -> park when the queue is empty
 
     static KThread* g_mainThread = nullptr;
     static KThread* g_glThread   = nullptr;
@@ -96,7 +101,7 @@ public:
         return false; 
     }
     void onQueueEmpty () {
-        // wait...?
+        // Nothing to poll; KThread::run() parks until exec() (see k::thread::IdleStrategy).
     }
 };
 class GLThread : public KThread<GLThread> {
@@ -114,7 +119,7 @@ public:
         return false; 
     }
     void onQueueEmpty () {
-        // wait...?
+        // Nothing to poll; KThread::run() parks until exec() (see k::thread::IdleStrategy).
     }
 };
 
@@ -4,6 +4,7 @@
 #include "kinput.hpp"
 #include "kgamepad.hpp"
 #include "kthreads.hpp"
+#include "threading/frame_graph.hxx"
 
 // Flags to control module run state.
 //
@@ -77,6 +78,15 @@ struct ModuleReference {
     // Force module to close; returns true iff module was running (and is now closed).
     bool close  ();
 
+    // Declare resources this module's frame() reads / writes (eg. "input", "windows",
+    // "component.Transform"). Modules w/out conflicting access run in parallel on the worker pool
+    // (see k::thread::FrameGraph); modules that declare nothing run alone, in load order w/ all
+    // other modules (a barrier).
+    // Takes effect on the next frame.
+    void declareReads        (const std::string& resource);
+    void declareWrites       (const std::string& resource);
+    void clearResourceAccess ();
+
     template <typename T>
     void dispatchOnLocalThread (std::function<void(T&)> callback) {
         if (!*this) throw std::runtime_error("Null module reference");
@@ -132,6 +142,13 @@ struct ModuleManager {
     // Get list of all active modules.
     const std::vector<ModuleRef>& modules () const;
 
+    // Run modules' frame() on this worker pool (nullptr => sequentially, on the frame thread).
+    void setJobScheduler (k::thread::JobScheduler* jobs);
+
+    // Last frame's module graph stats: critical path (the chain of modules bounding frame time),
+    // total work, wall time.
+    const k::thread::FrameGraphStats& frameStats () const;
+
     ModuleRef& getModule (const std::string& name);
 private:
     class Impl;
@@ -1,7 +1,11 @@
 
 #include "kmodule.hpp"
+#include "threading/job_scheduler.hxx"
+#include <mutex>
 #include <vector>
 
+using k::thread::FrameGraph;
+
 struct ModuleStatusFlags {
     NEEDS_INIT         = 1 << 1,
     NEEDS_FLAG_UPDATE  = 1 << 2,
@@ -41,6 +45,12 @@ struct KModule : public ModuleReference {
     std::atomic<ModuleStatusFlags> statusFlags;
 
     std::vector<EventListener> eventListeners;
+
+    // Declared resource access: (resource, write). Synced to the frame graph when changed.
+    std::mutex                                  resourceMutex;
+    std::vector<std::pair<std::string, bool>>   resourceAccess;
+    std::atomic<bool>                           resourceAccessChanged { true };
+    FrameGraph::NodeId                          frameNode = FrameGraph::INVALID_NODE;
     std::vector<std::tuple<SubProcess, KModule*, std::chrono::duration, bool>> callTimeInfo;
 
     KModule (ModuleManager& mgr, IModule* module, const std::string& path, ModuleFlags flags) :
@@ -173,6 +183,24 @@ bool ModuleReference::reload () {
 bool ModuleReference::close () {
     static_cast<KModule*>(this)->statusFlags |= ModuleStatusFlags::NEEDS_TEARDOWN;
 }
+void ModuleReference::declareReads (const std::string& resource) {
+    auto module = static_cast<KModule*>(this);
+    std::lock_guard<std::mutex> lock(module->resourceMutex);
+    module->resourceAccess.emplace_back(resource, false);
+    module->resourceAccessChanged = true;
+}
+void ModuleReference::declareWrites (const std::string& resource) {
+    auto module = static_cast<KModule*>(this);
+    std::lock_guard<std::mutex> lock(module->resourceMutex);
+    module->resourceAccess.emplace_back(resource, true);
+    module->resourceAccessChanged = true;
+}
+void ModuleReference::clearResourceAccess () {
+    auto module = static_cast<KModule*>(this);
+    std::lock_guard<std::mutex> lock(module->resourceMutex);
+    module->resourceAccess.clear();
+    module->resourceAccessChanged = true;
+}
 void ModuleReference::dispatchOnLocalThread (std::function<void()> callback) {
     // TODO: implement this properly!
     callback();
@@ -203,6 +231,9 @@ class ModuleManager::Impl {
     unsigned                currentFrame = 0;
     static ModuleRef        g_nullModule;
 
+    FrameGraph                  frameGraph;     // one node per module (processFrame)
+    k::thread::JobScheduler*    jobs = nullptr;
+
     std::vector<std::tuple<SubProcess, KModule*, std::chrono::duration, bool>> callTimeInfo;
 
     ModuleRef& loadModule (IModule* module, ModuleFlags flags) {
@@ -212,13 +243,43 @@ class ModuleManager::Impl {
         return modules.back();
     }
 
+    // Add nodes for new modules, and re-declare changed resource access (the graph is only
+    // rebuilt when something changed).
+    void syncFrameGraph () {
+        std::lock lock (mutex);
+        for (auto& ref : modules) {
+            auto& module = static_cast<KModule&>(*ref);
+            if (module.frameNode == FrameGraph::INVALID_NODE) {
+                module.frameNode = frameGraph.addNode(module.name(), [this, &module]() {
+                    module.processFrame(frameState[currentFrame&1]);
+                });
+            }
+            if (module.resourceAccessChanged.exchange(false)) {
+                std::lock_guard<std::mutex> accessLock (module.resourceMutex);
+                frameGraph.clearAccess(module.frameNode);
+                if (module.resourceAccess.empty())
+                    frameGraph.barrier(module.frameNode);   // legacy module: may touch anything
+                for (auto& access : module.resourceAccess) {
+                    if (access.second) frameGraph.writes(module.frameNode, access.first);
+                    else               frameGraph.reads(module.frameNode, access.first);
+                }
+            }
+        }
+    }
+
     void updateFrame () override {
         // update frame state...
         ++currentFrame;
         callTimeInfo.clear();
+
+        // Run modules in parallel where their resource declarations allow it.
+        // (KModule::run() catches module exceptions, so execute() won't throw for those.)
+        syncFrameGraph();
+        frameGraph.execute(jobs);
+
         for (auto& module : modules) {
-            module->processFrame(frameState[currentFrame&1]);
-            std::copy(callTimeInfo.end(), module->callTimeInfo.begin(), module->callTimeInfo.end());
+            auto& info = static_cast<KModule&>(*module).callTimeInfo;
+            callTimeInfo.insert(callTimeInfo.end(), info.begin(), info.end());
         }
     }
     void updateGL (GLContext& context) override {
@@ -252,4 +313,10 @@ ModuleRef& getModule (const std::string& name) {
 const std::vector<ModuleRef>& modules () const {
     return impl->modules;
 }
+void setJobScheduler (k::thread::JobScheduler* jobs) {
+    impl->jobs = jobs;
+}
+const k::thread::FrameGraphStats& frameStats () const {
+    return impl->frameGraph.stats();
+}
 
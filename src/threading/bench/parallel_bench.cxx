@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <hayai.hpp>
+#include "job_scheduler.hxx"
+#include "parallel.hxx"
+#if defined(K_BENCH_STD_PAR)
+#include <execution>
+#endif
+
+//
+// parallel_for / parallel_reduce / parallel_sort (auto grain) vs a serial loop, and vs
+// std::execution::par when the standard library has a backend for it (K_BENCH_STD_PAR; libstdc++
+// needs TBB).
+//
+// Workloads:
+// – Transform: 256K 4x4 matrix * vec4 (transform update; cheap, memory bound).
+// – Cull:      256K bounding spheres vs 6 planes (a little more math per item).
+// – Reduce:    sum of 1M floats.
+// – Sort:      1M random uint32 keys (fresh copy each run).
+//
+
+using namespace k::thread;
+
+static constexpr size_t TRANSFORM_COUNT = 256 * 1024;
+static constexpr size_t REDUCE_COUNT    = 1024 * 1024;
+static constexpr size_t SORT_COUNT      = 1024 * 1024;
+
+struct Vec4   { float x, y, z, w; };
+struct Mat4   { Vec4 cols[4]; };
+struct Sphere { Vec4 centerRadius; };
+
+static std::unique_ptr<JobScheduler> jobs;
+
+static std::vector<Mat4>     matrices;
+static std::vector<Vec4>     points, transformed;
+static std::vector<Sphere>   spheres;
+static std::vector<uint8_t>  visible;
+static std::vector<float>    values;
+static std::vector<uint32_t> keys, sortKeys;
+static Vec4                  planes[6];
+
+static void setup () {
+    std::mt19937 rng (1);
+    std::uniform_real_distribution<float> dist (-1.0f, 1.0f);
+    matrices.resize(TRANSFORM_COUNT);
+    points.resize(TRANSFORM_COUNT);
+    transformed.resize(TRANSFORM_COUNT);
+    spheres.resize(TRANSFORM_COUNT);
+    visible.resize(TRANSFORM_COUNT);
+    for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+        for (auto& col : matrices[i].cols)
+            col = { dist(rng), dist(rng), dist(rng), dist(rng) };
+        points[i]  = { dist(rng), dist(rng), dist(rng), 1.0f };
+        spheres[i] = { { dist(rng) * 100, dist(rng) * 100, dist(rng) * 100, std::abs(dist(rng)) } };
+    }
+    for (auto& plane : planes) {
+        Vec4 n { dist(rng), dist(rng), dist(rng), 0 };
+        float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        plane = { n.x / len, n.y / len, n.z / len, 50.0f };
+    }
+    values.resize(REDUCE_COUNT);
+    for (auto& v : values)
+        v = dist(rng);
+    keys.resize(SORT_COUNT);
+    for (auto& k : keys)
+        k = (uint32_t)rng();
+}
+
+static void transformOne (size_t i) {
+    auto& m = matrices[i];
+    auto& p = points[i];
+    transformed[i] = {
+        m.cols[0].x * p.x + m.cols[1].x * p.y + m.cols[2].x * p.z + m.cols[3].x * p.w,
+        m.cols[0].y * p.x + m.cols[1].y * p.y + m.cols[2].y * p.z + m.cols[3].y * p.w,
+        m.cols[0].z * p.x + m.cols[1].z * p.y + m.cols[2].z * p.z + m.cols[3].z * p.w,
+        m.cols[0].w * p.x + m.cols[1].w * p.y + m.cols[2].w * p.z + m.cols[3].w * p.w,
+    };
+}
+static void cullOne (size_t i) {
+    auto& s = spheres[i].centerRadius;
+    bool inside = true;
+    for (auto& plane : planes)
+        inside &= plane.x * s.x + plane.y * s.y + plane.z * s.z + plane.w >= -s.w;
+    visible[i] = inside;
+}
+
+// Serial
+BENCHMARK(Parallel, Transform_Serial, 10, 20) {
+    for (size_t i = 0; i < TRANSFORM_COUNT; ++i)
+        transformOne(i);
+}
+BENCHMARK(Parallel, Cull_Serial, 10, 20) {
+    for (size_t i = 0; i < TRANSFORM_COUNT; ++i)
+        cullOne(i);
+}
+BENCHMARK(Parallel, Reduce_Serial, 10, 20) {
+    volatile float sum = std::accumulate(values.begin(), values.end(), 0.0f);
+    (void)sum;
+}
+BENCHMARK(Parallel, Sort_Serial, 5, 5) {
+    sortKeys = keys;
+    std::sort(sortKeys.begin(), sortKeys.end());
+}
+
+// k::thread
+BENCHMARK(Parallel, Transform_Jobs, 10, 20) {
+    parallel_for(jobs.get(), { 0, TRANSFORM_COUNT }, 0, [](size_t i) { transformOne(i); });
+}
+BENCHMARK(Parallel, Cull_Jobs, 10, 20) {
+    parallel_for(jobs.get(), { 0, TRANSFORM_COUNT }, 0, [](size_t i) { cullOne(i); });
+}
+BENCHMARK(Parallel, Reduce_Jobs, 10, 20) {
+    volatile float sum = parallel_reduce(jobs.get(), { 0, REDUCE_COUNT }, 0, 0.0f,
+        [](IndexRange r, float acc) { return std::accumulate(&values[r.begin], &values[0] + r.end, acc); },
+        [](float a, float b) { return a + b; });
+    (void)sum;
+}
+BENCHMARK(Parallel, Sort_Jobs, 5, 5) {
+    sortKeys = keys;
+    parallel_sort(jobs.get(), sortKeys.begin(), sortKeys.end());
+}
+
+#if defined(K_BENCH_STD_PAR)
+// std::execution::par
+BENCHMARK(Parallel, Transform_StdPar, 10, 20) {
+    std::for_each(std::execution::par, matrices.begin(), matrices.end(), [](const Mat4& m) {
+        transformOne((size_t)(&m - matrices.data()));
+    });
+}
+BENCHMARK(Parallel, Cull_StdPar, 10, 20) {
+    std::for_each(std::execution::par, spheres.begin(), spheres.end(), [](const Sphere& s) {
+        cullOne((size_t)(&s - spheres.data()));
+    });
+}
+BENCHMARK(Parallel, Reduce_StdPar, 10, 20) {
+    volatile float sum = std::reduce(std::execution::par, values.begin(), values.end(), 0.0f);
+    (void)sum;
+}
+BENCHMARK(Parallel, Sort_StdPar, 5, 5) {
+    sortKeys = keys;
+    std::sort(std::execution::par, sortKeys.begin(), sortKeys.end());
+}
+#endif
+
+int main (int argc, const char** argv) {
+    setup();
+    jobs.reset(new JobScheduler());
+    printf("JobScheduler: %zu workers (+ calling thread)\n", jobs->workerCount());
+#if !defined(K_BENCH_STD_PAR)
+    printf("std::execution::par: not available (skipped)\n");
+#endif
+
+    hayai::ConsoleOutputter outputter;
+    hayai::Benchmarker::AddOutputter(outputter);
+    hayai::Benchmarker::RunAllTests();
+    jobs.reset();
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <hayai.hpp>
+#include <concurrentqueue.h>
+#include "thread.hxx"
+
+//
+// ThreadTask (InplaceTask<48>) vs std::function<void()>, posted through the same
+// moodycamel::ConcurrentQueue that KThread uses.
+//
+// Captures are what thread tasks typically hold: a shared_ptr + a value (eg. window property
+// setters, KThread::dispatchMainThread() calls).
+//
+// Before running the timed benchmarks, prints heap allocations per post (steady state, after the
+// queue has allocated its blocks), counted by replacing global operator new.
+//
+
+static std::atomic<uint64_t> allocations { 0 };
+
+void* operator new (size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete (void* ptr) noexcept { std::free(ptr); }
+void operator delete (void* ptr, size_t) noexcept { std::free(ptr); }
+
+using k::thread::ThreadTask;
+
+static constexpr size_t TASK_COUNT = 4096;
+
+struct Target {
+    uint64_t    sum = 0;
+    std::string title;
+};
+static std::shared_ptr<Target> target = std::make_shared<Target>();
+
+// Typical captures: shared_ptr + int, shared_ptr + 4 floats, this-ptr + std::string + int.
+template <typename Task>
+static void postSmall (moodycamel::ConcurrentQueue<Task>& queue, uint32_t i) {
+    auto t = target;
+    queue.enqueue(Task([t, i]() { t->sum += i; }));
+}
+template <typename Task>
+static void postVec4 (moodycamel::ConcurrentQueue<Task>& queue, uint32_t i) {
+    auto t = target;
+    float x = (float)i, y = x, z = x, w = x;
+    queue.enqueue(Task([t, x, y, z, w]() { t->sum += (uint64_t)(x + y + z + w); }));
+}
+template <typename Task>
+static void postString (moodycamel::ConcurrentQueue<Task>& queue, uint32_t i) {
+    auto t = target.get();
+    std::string title = "title";    // SSO; the string itself doesn't allocate
+    queue.enqueue(Task([t, title, i]() { t->title = title; t->sum += i; }));
+}
+
+template <typename Task>
+static void drain (moodycamel::ConcurrentQueue<Task>& queue) {
+    Task task;
+    while (queue.try_dequeue(task))
+        task();
+}
+
+template <typename Task, void (*post)(moodycamel::ConcurrentQueue<Task>&, uint32_t)>
+static void postAndRun (moodycamel::ConcurrentQueue<Task>& queue) {
+    for (uint32_t i = 0; i < TASK_COUNT; ++i)
+        post(queue, i);
+    drain(queue);
+}
+
+template <typename Task, void (*post)(moodycamel::ConcurrentQueue<Task>&, uint32_t)>
+static double allocationsPerPost () {
+    moodycamel::ConcurrentQueue<Task> queue;
+    postAndRun<Task, post>(queue);      // warm up (queue blocks)
+
+    auto before = allocations.load();
+    postAndRun<Task, post>(queue);
+    return (double)(allocations.load() - before) / TASK_COUNT;
+}
+
+typedef std::function<void()> FunctionTask;
+
+#define K_BENCH_TASK(Name, post) \
+    BENCHMARK(PostTask, Function_##Name, 10, 100) { \
+        static moodycamel::ConcurrentQueue<FunctionTask> queue; \
+        postAndRun<FunctionTask, post<FunctionTask>>(queue); \
+    } \
+    BENCHMARK(PostTask, ThreadTask_##Name, 10, 100) { \
+        static moodycamel::ConcurrentQueue<ThreadTask> queue; \
+        postAndRun<ThreadTask, post<ThreadTask>>(queue); \
+    }
+
+K_BENCH_TASK(Small,  postSmall)
+K_BENCH_TASK(Vec4,   postVec4)
+K_BENCH_TASK(String, postString)
+
+int main (int argc, const char** argv) {
+    printf("Allocations per postTask (steady state):\n");
+    printf("  %-10s std::function %5.2f   ThreadTask %5.2f\n", "Small",
+        allocationsPerPost<FunctionTask, postSmall<FunctionTask>>(),
+        allocationsPerPost<ThreadTask, postSmall<ThreadTask>>());
+    printf("  %-10s std::function %5.2f   ThreadTask %5.2f\n", "Vec4",
+        allocationsPerPost<FunctionTask, postVec4<FunctionTask>>(),
+        allocationsPerPost<ThreadTask, postVec4<ThreadTask>>());
+    printf("  %-10s std::function %5.2f   ThreadTask %5.2f\n", "String",
+        allocationsPerPost<FunctionTask, postString<FunctionTask>>(),
+        allocationsPerPost<ThreadTask, postString<ThreadTask>>());
+
+    hayai::ConsoleOutputter outputter;
+    hayai::Benchmarker::AddOutputter(outputter);
+    hayai::Benchmarker::RunAllTests();
+    return 0;
+}
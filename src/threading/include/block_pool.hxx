@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+namespace k {
+namespace thread {
+
+// Pooled allocator for small, short lived blocks (coroutine frames, future states): power of 2 size
+// classes (64 bytes .. 4k), w/ a per-thread free list for each class. Blocks are often freed on
+// another thread than the one that allocated them; they go to the freeing thread's list, which
+// hands batches over to a shared (locked) list when it overflows, and allocating threads refill
+// from it when theirs run empty -- so producer / consumer threads recycle the same blocks.
+// Larger blocks use operator new. deallocate() must get the size passed to allocate().
+class BlockPool {
+public:
+    static void* allocate   (size_t size);
+    static void  deallocate (void* ptr, size_t size) noexcept;
+};
+
+}; // namespace thread
+}; // namespace k
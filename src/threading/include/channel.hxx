@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+#include "idle_strategy.hxx"
+#include "thread.hxx"
+
+namespace k {
+namespace thread {
+
+//
+// Typed, bounded multi producer / single consumer channel.
+//
+//  Channel<WindowCommand> commands (256);
+//  commands.setReceiver(&windowThread);                   // wake it on send
+//  commands.send(WindowCommand::SetTitle { "foo" });      // any thread
+//  ...
+//  void onAwaitTasks (KThread&) override {                // receiving thread
+//      commands.drain([this](WindowCommand&& command) { run(command); });
+//  }
+//
+// – any number of threads can send(); one thread at a time receives.
+// – fixed capacity (rounded up to a power of 2), allocated up front: send / receive never allocate.
+//   trySend() fails when the channel is full; send() waits (spin, then yield) for the receiver.
+// – drain() / tryReceive(out, max) receive a batch of messages at once.
+// – wake up: each send wakes the receiving KThread (setReceiver(); see KThread::wake()), and / or a
+//   thread blocked in wait(); both cost a fence + a load when the receiver isn't idle.
+// – messages from one sender are received in send order.
+//
+// Lock free ring of sequence numbered slots (Vyukov's bounded queue); senders claim a slot w/ one
+// CAS, the receiver doesn't use any.
+//
+template <typename T>
+class Channel {
+public:
+    explicit Channel (size_t capacity = 256)
+        : mask(roundUp(capacity) - 1), slots(new Slot[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    ~Channel () {
+        drain([](T&&) {});
+    }
+
+    Channel (const Channel&) = delete;
+    Channel& operator= (const Channel&) = delete;
+
+    // KThread to wake when a message is sent (nullptr => none). Set before sending.
+    void setReceiver (KThread* thread) { receiver = thread; }
+
+    // Send a message; returns false if the channel is full. Any thread.
+    bool trySend (T&& value) { return push(std::move(value)); }
+    bool trySend (const T& value) { return push(value); }
+
+    // Send a message, waiting for space if the channel is full. Any thread, except the receiver
+    // (which would wait for itself).
+    void send (T&& value) {
+        for (uint32_t attempt = 0; !push(std::move(value)); ++attempt)
+            backoff(attempt);
+    }
+    void send (const T& value) {
+        for (uint32_t attempt = 0; !push(value); ++attempt)
+            backoff(attempt);
+    }
+
+    // Receive one message; returns false if there are none. Receiving thread only.
+    bool tryReceive (T& value) {
+        auto& slot = slots[head & mask];
+        if (slot.seq.load(std::memory_order_acquire) != head + 1)
+            return false;
+        value = std::move(*slot.value());
+        pop(slot);
+        return true;
+    }
+
+    // Receive up to max messages into out; returns the count. Receiving thread only.
+    size_t tryReceive (T* out, size_t max) {
+        size_t count = 0;
+        while (count < max && tryReceive(out[count]))
+            ++count;
+        return count;
+    }
+
+    // Call fn(T&&) for up to max messages (those sent so far); returns the count.
+    // Receiving thread only. If fn throws, its message is dropped + the rest stay queued.
+    template <typename F>
+    size_t drain (const F& fn, size_t max = SIZE_MAX) {
+        size_t count = 0;
+        for (; count < max; ++count) {
+            auto& slot = slots[head & mask];
+            if (slot.seq.load(std::memory_order_acquire) != head + 1)
+                break;
+            T value (std::move(*slot.value()));
+            pop(slot);
+            fn(std::move(value));
+        }
+        return count;
+    }
+
+    // Block until there is a message, or timeout passes (0 = no timeout). Returns !empty().
+    // For receivers that aren't KThreads (a KThread receiver parks in its run loop instead).
+    bool wait (std::chrono::microseconds timeout) {
+        auto token = parker.prepare();
+        if (!empty()) {
+            parker.cancel();
+            return true;
+        }
+        parker.park(token, timeout);
+        return !empty();
+    }
+
+    // Approximate message count (exact on the receiving thread when no sends are in flight).
+    size_t size () const {
+        auto tail = this->tail.load(std::memory_order_acquire);
+        auto head = this->headCount.load(std::memory_order_acquire);
+        return tail > head ? (size_t)(tail - head) : 0;
+    }
+    size_t capacity () const { return mask + 1; }
+
+    // True if the next message hasn't been published yet.
+    bool empty () const {
+        auto head = headCount.load(std::memory_order_acquire);
+        return slots[head & mask].seq.load(std::memory_order_acquire) != head + 1;
+    }
+private:
+    struct Slot {
+        std::atomic<uint64_t>   seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value () { return std::launder(reinterpret_cast<T*>(&storage)); }
+    };
+
+    static size_t roundUp (size_t capacity) {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        return size;
+    }
+
+    template <typename V>
+    bool push (V&& value) {
+        auto pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            auto seq  = slot->seq.load(std::memory_order_acquire);
+            auto diff = (int64_t)(seq - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;   // full: slot not yet released by the receiver
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        new (&slot->storage) T(std::forward<V>(value));
+        slot->seq.store(pos + 1, std::memory_order_release);
+
+        parker.unpark();
+        if (receiver)
+            receiver->wake();
+        return true;
+    }
+
+    void pop (Slot& slot) {
+        slot.value()->~T();
+        slot.seq.store(head + mask + 1, std::memory_order_release);
+        headCount.store(++head, std::memory_order_release);
+    }
+
+    static void backoff (uint32_t attempt) {
+        if (attempt < 64) cpuRelax();
+        else              std::this_thread::yield();
+    }
+
+    const size_t                        mask;
+    std::unique_ptr<Slot[]>             slots;
+    KThread*                            receiver = nullptr;
+    Parker                              parker;
+
+    alignas(64) std::atomic<uint64_t>   tail { 0 };         // next slot to claim (senders)
+    alignas(64) uint64_t                head = 0;           // next slot to receive (receiver only)
+    std::atomic<uint64_t>               headCount { 0 };    // head, for size() / empty() from any thread
+};
+
+}; // namespace thread
+}; // namespace k
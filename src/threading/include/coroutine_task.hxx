@@ -0,0 +1,385 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "block_pool.hxx"
+#include "task_executor.hxx"
+
+namespace k {
+namespace thread {
+
+//
+// C++20 coroutine tasks, scheduled on KThreads / JobScheduler workers.
+//
+// Example -- a load pipeline as straight line code:
+//
+//  Task<void> loadMesh (FSInstance& fs, KThread& glThread, std::string path) {
+//      auto file = co_await loadFile(fs, path);                       // see vfs_await.hpp
+//      auto mesh = decodeMesh(*file);                                  // on a worker
+//      co_await callOn(TaskExecutor(glThread), [&]() { upload(mesh); }); // GL thread round-trip
+//      co_await nextFrame(app.thread.frames);
+//      ...
+//  }
+//  spawn(app.thread.executor(), loadMesh(fs, glThread, "foo.obj"));
+//
+// – tasks are lazy: nothing runs until the task is spawn()ed or co_awaited.
+// – a suspended coroutine holds no thread: every awaitable here resumes the coroutine by posting
+//   a ThreadTask to the coroutine's TaskExecutor (inherited from the awaiting task, if not set).
+// – co_awaiting a Task runs it inline (symmetric transfer), and rethrows its exception.
+// – coroutine frames are allocated from BlockPool (per-thread free lists).
+//
+
+template <typename T> class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;   // awaiting coroutine, if any
+    std::exception_ptr      exception;
+    TaskExecutor            executor;
+    bool                    detached = false;
+
+    static void* operator new (size_t size) { return BlockPool::allocate(size); }
+    static void  operator delete (void* ptr, size_t size) noexcept { BlockPool::deallocate(ptr, size); }
+
+    struct FinalAwaiter {
+        bool await_ready () noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend (std::coroutine_handle<Promise> handle) noexcept {
+            auto& promise = handle.promise();
+            if (promise.continuation)
+                return promise.continuation;
+            if (promise.detached) {
+                // Nobody to rethrow to: rethrow from a task on the executor (ie. onTaskException()).
+                auto exception = promise.exception;
+                auto executor  = promise.executor;
+                handle.destroy();
+                if (exception)
+                    executor.post([exception]() { std::rethrow_exception(exception); });
+            }
+            return std::noop_coroutine();
+        }
+        void await_resume () noexcept {}
+    };
+
+    std::suspend_always initial_suspend () noexcept { return {}; }
+    FinalAwaiter        final_suspend   () noexcept { return {}; }
+    void unhandled_exception () { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object ();
+    template <typename U>
+    void return_value (U&& result) { value.emplace(std::forward<U>(result)); }
+
+    T result () {
+        if (exception)
+            std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object ();
+    void return_void () {}
+
+    void result () {
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+};
+
+// Executor of an awaiting coroutine (empty if it isn't one of our tasks).
+template <typename Promise>
+TaskExecutor executorOf (std::coroutine_handle<Promise> handle) {
+    if constexpr (std::is_base_of<TaskPromiseBase, Promise>::value)
+        return handle.promise().executor;
+    else
+        return TaskExecutor();
+}
+
+}; // namespace detail
+
+// Lazy, move-only coroutine task. co_await it from another task, or spawn() it.
+template <typename T = void>
+class Task {
+public:
+    typedef detail::TaskPromise<T> promise_type;
+
+    Task () {}
+    explicit Task (std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task (Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator= (Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Task (const Task&) = delete;
+    Task& operator= (const Task&) = delete;
+    ~Task () { reset(); }
+
+    explicit operator bool () const { return (bool)handle; }
+    bool done () const { return handle && handle.done(); }
+
+    struct Awaiter {
+        std::coroutine_handle<promise_type> handle;
+
+        bool await_ready () { return !handle || handle.done(); }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend (std::coroutine_handle<Promise> awaiting) {
+            auto& promise = handle.promise();
+            promise.continuation = awaiting;
+            if (!promise.executor)
+                promise.executor = detail::executorOf(awaiting);
+            return handle;
+        }
+        T await_resume () { return handle.promise().result(); }
+    };
+    Awaiter operator co_await () && { return Awaiter { handle }; }
+
+    // Give up ownership of the coroutine (see spawn()).
+    std::coroutine_handle<promise_type> release () { return std::exchange(handle, nullptr); }
+private:
+    void reset () {
+        if (handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object () {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+inline Task<void> TaskPromise<void>::get_return_object () {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+}; // namespace detail
+
+// Start a task on executor, detached: the coroutine frame is freed when it finishes, and its result
+// is dropped. An exception thrown out of the task is rethrown from a task posted to the executor
+// (ie. reaches IThreadWorker::onTaskException() / the JobScheduler exception handler).
+template <typename T>
+void spawn (const TaskExecutor& executor, Task<T> task) {
+    auto handle = task.release();
+    if (!handle)
+        return;
+    handle.promise().executor = executor;
+    handle.promise().detached = true;
+    executor.resume(handle);
+}
+
+//
+// Awaitables
+//
+
+// Continue the coroutine on another executor (from now on: later awaits resume there too).
+//  co_await switchTo(TaskExecutor(glThread));
+struct SwitchToAwaiter {
+    TaskExecutor executor;
+
+    bool await_ready () { return false; }
+    template <typename Promise>
+    void await_suspend (std::coroutine_handle<Promise> handle) {
+        if constexpr (std::is_base_of<detail::TaskPromiseBase, Promise>::value)
+            handle.promise().executor = executor;
+        executor.resume(handle);
+    }
+    void await_resume () {}
+};
+inline SwitchToAwaiter switchTo (TaskExecutor executor) { return SwitchToAwaiter { executor }; }
+
+// Run fn on another executor (eg. the GL thread), then resume on the coroutine's own executor w/
+// fn's result (or exception). The coroutine holds no thread while fn is queued / running.
+//  auto id = co_await callOn(TaskExecutor(glThread), [&]() { return uploadTexture(image); });
+template <typename F>
+struct CallOnAwaiter {
+    typedef decltype(std::declval<F&>()()) Result;
+    typedef typename std::conditional<std::is_void<Result>::value, bool, Result>::type Stored;
+
+    TaskExecutor            target;
+    F                       fn;
+    TaskExecutor            resumeOn;
+    std::optional<Stored>   result;
+    std::exception_ptr      exception;
+
+    CallOnAwaiter (TaskExecutor target, F&& fn) : target(target), fn(std::move(fn)) {}
+
+    bool await_ready () { return false; }
+    template <typename Promise>
+    void await_suspend (std::coroutine_handle<Promise> handle) {
+        resumeOn = detail::executorOf(handle);
+        target.postResume([this, handle]() {
+            try {
+                if constexpr (std::is_void<Result>::value) {
+                    fn();
+                    result.emplace(true);
+                } else {
+                    result.emplace(fn());
+                }
+            } catch (...) {
+                exception = std::current_exception();
+            }
+            resumeOn.resume(handle);
+        });
+    }
+    Result await_resume () {
+        if (exception)
+            std::rethrow_exception(exception);
+        if constexpr (!std::is_void<Result>::value)
+            return std::move(*result);
+    }
+};
+template <typename F>
+CallOnAwaiter<F> callOn (TaskExecutor target, F fn) { return CallOnAwaiter<F>(target, std::move(fn)); }
+
+// Resumes coroutines waiting for the next frame. The frame loop calls signal() once per frame.
+//  auto frame = co_await nextFrame(app.thread.frames);
+class FrameSignal {
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        TaskExecutor            executor;
+    };
+    std::mutex              mutex;
+    std::vector<Waiter>     waiting, resuming;
+    std::atomic<uint64_t>   frame { 0 };
+public:
+    uint64_t currentFrame () const { return frame.load(std::memory_order_acquire); }
+
+    void wait (std::coroutine_handle<> handle, const TaskExecutor& executor) {
+        std::lock_guard<std::mutex> lock(mutex);
+        waiting.push_back({ handle, executor });
+    }
+
+    // Frame loop only.
+    void signal () {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frame.fetch_add(1, std::memory_order_release);
+            std::swap(waiting, resuming);
+        }
+        for (auto& waiter : resuming)
+            waiter.executor.resume(waiter.handle);
+        resuming.clear();
+    }
+};
+
+// Suspend until the next FrameSignal::signal(); returns the new frame index.
+struct NextFrameAwaiter {
+    FrameSignal& frames;
+
+    bool await_ready () { return false; }
+    template <typename Promise>
+    void await_suspend (std::coroutine_handle<Promise> handle) {
+        frames.wait(handle, detail::executorOf(handle));
+    }
+    uint64_t await_resume () { return frames.currentFrame(); }
+};
+inline NextFrameAwaiter nextFrame (FrameSignal& frames) { return NextFrameAwaiter { frames }; }
+
+// Completion handle for callback based async APIs (see awaitCallback()). Copyable; the first
+// resolve() / reject() wins, later calls are ignored (eg. reload callbacks).
+template <typename T>
+class Completion {
+    typedef typename std::conditional<std::is_void<T>::value, bool, T>::type Stored;
+public:
+    struct State {
+        std::atomic<bool>       completed { false };
+        std::optional<Stored>   value;
+        std::exception_ptr      exception;
+        std::coroutine_handle<> handle;
+        TaskExecutor            executor;
+        std::mutex              keepAliveMutex;
+        std::shared_ptr<void>   keepAlive;      // see Completion::keepAlive()
+    };
+
+    explicit Completion (std::shared_ptr<State> state) : state(std::move(state)) {}
+
+    template <typename... Args>
+    void resolve (Args&&... args) const {
+        if (state->completed.exchange(true))
+            return;
+        if constexpr (std::is_void<T>::value)
+            state->value.emplace(true);
+        else
+            state->value.emplace(std::forward<Args>(args)...);
+        auto keepAlive = release();
+        state->executor.resume(state->handle);
+    }
+    void reject (std::exception_ptr exception) const {
+        if (state->completed.exchange(true))
+            return;
+        state->exception = exception;
+        auto keepAlive = release();
+        state->executor.resume(state->handle);
+    }
+
+    // Keep object (eg. the request the callbacks belong to, if the API only holds it weakly) alive
+    // until the completion is resolved / rejected. Ignored if it already was.
+    void keepAlive (std::shared_ptr<void> object) const {
+        std::lock_guard<std::mutex> lock(state->keepAliveMutex);
+        if (!state->completed.load())
+            state->keepAlive = std::move(object);
+    }
+private:
+    // Take the kept object; resolve() / reject() drop it after resuming the coroutine.
+    std::shared_ptr<void> release () const {
+        std::lock_guard<std::mutex> lock(state->keepAliveMutex);
+        return std::move(state->keepAlive);
+    }
+
+    std::shared_ptr<State> state;
+};
+
+// Adapt a callback based async API: start(Completion<T>) is called when the coroutine suspends, and
+// the coroutine resumes (on its executor) once the completion is resolved / rejected.
+//  auto bytes = co_await awaitCallback<Bytes>([&](Completion<Bytes> done) {
+//      readAsync(path, [done](Bytes b) { done.resolve(std::move(b)); });
+//  });
+template <typename T, typename F>
+struct CallbackAwaiter {
+    typedef typename Completion<T>::State State;
+
+    F                       start;
+    std::shared_ptr<State>  state;
+
+    CallbackAwaiter (F&& start) : start(std::move(start)), state(std::make_shared<State>()) {}
+
+    bool await_ready () { return false; }
+    template <typename Promise>
+    void await_suspend (std::coroutine_handle<Promise> handle) {
+        state->handle   = handle;
+        state->executor = detail::executorOf(handle);
+
+        // The completion may resume (+ destroy) this awaiter before start() returns.
+        F run = std::move(start);
+        run(Completion<T>(state));
+    }
+    T await_resume () {
+        if (state->exception)
+            std::rethrow_exception(state->exception);
+        if constexpr (!std::is_void<T>::value)
+            return std::move(*state->value);
+    }
+};
+template <typename T, typename F>
+CallbackAwaiter<T, F> awaitCallback (F start) { return CallbackAwaiter<T, F>(std::move(start)); }
+
+}; // namespace thread
+}; // namespace k
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "idle_strategy.hxx"
+#include "thread.hxx"
+
+namespace k {
+namespace thread {
+
+class JobScheduler;
+
+// Stats for the last FrameGraph::execute().
+struct FrameGraphStats {
+    size_t                  nodes  = 0;         // nodes run (incl. disabled nodes)
+    size_t                  edges  = 0;
+    uint64_t                builds = 0;         // times the DAG has been (re)built, total
+    TaskClock::duration     wallTime {};        // execute() start -> end
+    TaskClock::duration     totalWork {};       // sum of node run times
+    TaskClock::duration     criticalPath {};    // longest dependency chain, by node run time
+    std::vector<uint32_t>   criticalNodes;      // ... its nodes, first to last
+};
+
+//
+// Per-frame task graph. Nodes (modules, ECS systems, ...) declare read / write access to named
+// resources ("input", "windows", "component.Transform", ...), and execute() runs them in parallel
+// on a JobScheduler, in an order consistent w/ those declarations:
+//
+// – a node that reads a resource runs after the last node (in add order) that writes it.
+// – a node that writes a resource runs after the last writer and all readers since then.
+// – nodes w/ no shared resources (or only reads) can run in parallel.
+// – a barrier node (eg. one that can't say what it touches) runs after all earlier nodes, and
+//   before all later ones.
+//
+// The DAG is built on the first execute() after declarations change, and cached until then.
+// execute() blocks the calling thread, which helps run jobs until the graph is done (parking w/ an
+// IdleStrategy when there are none; the last node wakes it), and records per node run times + the
+// critical path (what actually bounds the frame; see stats()). Steady state execute() doesn't
+// allocate (besides posting jobs).
+//
+// Not threadsafe: add / remove nodes + change declarations between execute() calls only.
+//
+class FrameGraph {
+public:
+    typedef uint32_t NodeId;
+    typedef uint32_t ResourceId;
+    static constexpr NodeId INVALID_NODE = ~(NodeId)0;
+
+    FrameGraph ();
+    ~FrameGraph ();
+
+    FrameGraph (const FrameGraph&) = delete;
+    FrameGraph& operator= (const FrameGraph&) = delete;
+
+    // Get the id for a named resource (created on first use).
+    ResourceId resource (const std::string& name);
+
+    // Add a node; run() is called once per execute() (from any thread) while the node is enabled.
+    NodeId addNode    (const std::string& name, std::function<void()> run);
+    void   removeNode (NodeId node);
+
+    // Declare resource access. Add order (not declaration order) decides which of two conflicting
+    // nodes runs first.
+    void reads       (NodeId node, ResourceId resource);
+    void writes      (NodeId node, ResourceId resource);
+    void reads       (NodeId node, const std::string& resource) { reads(node, this->resource(resource)); }
+    void writes      (NodeId node, const std::string& resource) { writes(node, this->resource(resource)); }
+    void barrier     (NodeId node);
+    void clearAccess (NodeId node);     // incl. barrier()
+
+    // Disabled nodes are skipped, but keep their place in the graph (no rebuild).
+    void setEnabled (NodeId node, bool enabled);
+
+    const std::string& nodeName (NodeId node) const;
+    size_t             nodeCount () const { return order.size(); }
+
+    // Run all nodes. jobs = nullptr => run serially on the calling thread, in add order.
+    // Rethrows the first exception thrown by a node, once all nodes have run.
+    void execute (JobScheduler* jobs);
+
+    const FrameGraphStats& stats () const { return lastStats; }
+private:
+    struct Node;
+
+    void build ();
+    void runNode (NodeId node);
+    void post (NodeId node);
+    void updateStats (TaskClock::time_point start);
+
+    std::vector<std::unique_ptr<Node>>          nodes;      // by NodeId (nullptr => removed)
+    std::vector<NodeId>                         freeIds;
+    std::vector<NodeId>                         order;      // live nodes, in add order
+    std::vector<NodeId>                         roots;      // nodes w/out dependencies
+    std::unordered_map<std::string, ResourceId> resourceIds;
+    bool                                        dirty = true;
+
+    // Per execute():
+    JobScheduler*                               jobs = nullptr;
+    std::atomic<size_t>                         outstanding { 0 };
+    std::atomic<size_t>                         finishing { 0 };    // runNode()s that may be waking idle
+    IdleStrategy                                idle;               // execute()'s calling thread
+    std::mutex                                  exceptionMutex;
+    std::exception_ptr                          exception;
+    FrameGraphStats                             lastStats;
+};
+
+}; // namespace thread
+}; // namespace k
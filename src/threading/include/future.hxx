@@ -0,0 +1,376 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "block_pool.hxx"
+#include "task_executor.hxx"
+
+namespace k {
+namespace thread {
+
+//
+// Lightweight futures for thread tasks.
+//
+//  postTask(glThread, [=]() { return uploadTexture(image); })
+//      .then(mainThread, [](TextureId id) { textures.add(id); });
+//
+// – postTask(executor, fn) posts fn (to a KThread / JobScheduler, see TaskExecutor) and returns a
+//   Future for its result; KThread::postTask() stays fire and forget (no shared state).
+// – then(executor, fn) runs fn w/ the result once it's ready (inline, for an empty executor), and
+//   returns a Future for that.
+// – exceptions skip continuations and propagate down the chain; get() rethrows.
+// – cancel() skips the task / continuation producing a future if it hasn't started, and cancels
+//   everything chained after it (get() throws FutureCancelled).
+// – whenAll(futures) completes once all inputs have.
+// – there is no blocking wait: chain a continuation instead (or poll ready()).
+//
+// Shared state is an intrusively refcounted block from BlockPool, and continuations are stored
+// inline (ThreadTask), so in steady state a cross-thread call + continuation doesn't allocate.
+// Captures are limited to 40 bytes for postTask() tasks, 32 for continuations (InplaceTask).
+//
+// A Future has a single consumer: get() moves the value out, and then() consumes the future.
+//
+
+struct FutureCancelled : public std::runtime_error {
+    FutureCancelled () : std::runtime_error("Future cancelled") {}
+};
+
+template <typename T> class Future;
+template <typename T> class Promise;
+
+namespace detail {
+
+enum class FutureStatus : uint8_t { PENDING, VALUE, EXCEPTION, CANCELLED };
+
+template <typename T>
+class FutureState {
+    typedef typename std::conditional<std::is_void<T>::value, bool, T>::type Stored;
+
+    enum : uint8_t { COMPLETED = 1 << 0, HAS_CONTINUATION = 1 << 1 };
+
+    std::atomic<uint32_t>       refs { 1 };
+    std::atomic<FutureStatus>   status { FutureStatus::PENDING };
+    std::atomic<uint8_t>        flags { 0 };
+    alignas(Stored) unsigned char storage[sizeof(Stored)];
+    std::exception_ptr          exception;
+    ThreadTask                  continuation;
+    TaskExecutor                continuationExecutor;
+
+    FutureState () {}
+    ~FutureState () {
+        if (status.load(std::memory_order_relaxed) == FutureStatus::VALUE)
+            value().~Stored();
+    }
+
+    // Runs the continuation iff both the result + the continuation are in.
+    void setFlag (uint8_t flag) {
+        auto other = flag == COMPLETED ? HAS_CONTINUATION : COMPLETED;
+        if (flags.fetch_or(flag, std::memory_order_acq_rel) & other) {
+            // Moved out first: the continuation may hold the last reference to this state.
+            ThreadTask task (std::move(continuation));
+            auto executor = continuationExecutor;
+            executor.post(std::move(task));
+        }
+    }
+    bool complete (FutureStatus result) {
+        auto expected = FutureStatus::PENDING;
+        if (!status.compare_exchange_strong(expected, result, std::memory_order_acq_rel))
+            return false;
+        setFlag(COMPLETED);
+        return true;
+    }
+public:
+    static FutureState* create () {
+        return new (BlockPool::allocate(sizeof(FutureState))) FutureState();
+    }
+    void retain () { refs.fetch_add(1, std::memory_order_relaxed); }
+    void release () {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~FutureState();
+            BlockPool::deallocate(this, sizeof(FutureState));
+        }
+    }
+
+    FutureStatus getStatus () const { return status.load(std::memory_order_acquire); }
+    Stored&      value () { return *std::launder(reinterpret_cast<Stored*>(storage)); }
+
+    // Producer side. Each returns false (+ drops the result) if the future was already completed
+    // (ie. cancelled).
+    template <typename... Args>
+    bool setValue (Args&&... args) {
+        if (getStatus() != FutureStatus::PENDING)
+            return false;
+        new (storage) Stored(std::forward<Args>(args)...);
+        auto expected = FutureStatus::PENDING;
+        if (!status.compare_exchange_strong(expected, FutureStatus::VALUE, std::memory_order_acq_rel)) {
+            value().~Stored();
+            return false;
+        }
+        setFlag(COMPLETED);
+        return true;
+    }
+    bool setException (std::exception_ptr e) {
+        // Written before the status CAS publishes it; a losing setter's write is never read.
+        if (getStatus() != FutureStatus::PENDING)
+            return false;
+        exception = e;
+        return complete(FutureStatus::EXCEPTION);
+    }
+    bool cancel () { return complete(FutureStatus::CANCELLED); }
+
+    // Consumer side; at most one continuation.
+    void setContinuation (const TaskExecutor& executor, ThreadTask&& task) {
+        continuation         = std::move(task);
+        continuationExecutor = executor;
+        setFlag(HAS_CONTINUATION);
+    }
+    std::exception_ptr getException () const { return exception; }
+};
+
+// Owning (refcounted) pointer to a FutureState.
+template <typename T>
+class StateRef {
+    FutureState<T>* state = nullptr;
+public:
+    StateRef () {}
+    explicit StateRef (FutureState<T>* state) : state(state) {}     // adopts a reference
+    StateRef (const StateRef& other) : state(other.state) { if (state) state->retain(); }
+    StateRef (StateRef&& other) noexcept : state(std::exchange(other.state, nullptr)) {}
+    StateRef& operator= (StateRef other) noexcept { std::swap(state, other.state); return *this; }
+    ~StateRef () { if (state) state->release(); }
+
+    FutureState<T>* operator-> () const { return state; }
+    explicit operator bool () const { return state != nullptr; }
+};
+
+// Complete promise w/ the result of fn(args...) (or its exception).
+template <typename T, typename F, typename... Args>
+void fulfill (Promise<T>& promise, F& fn, Args&&... args);
+
+template <typename T, typename F>
+struct ContinuationResult {
+    typedef decltype(std::declval<F&>()(std::declval<T>())) type;
+};
+template <typename F>
+struct ContinuationResult<void, F> {
+    typedef decltype(std::declval<F&>()()) type;
+};
+
+}; // namespace detail
+
+template <typename T>
+class Future {
+    template <typename> friend class Future;
+    template <typename> friend class Promise;
+    typedef detail::FutureStatus Status;
+
+    detail::StateRef<T> state;
+
+    explicit Future (detail::StateRef<T> state) : state(std::move(state)) {}
+public:
+    Future () {}
+    Future (Future&&) = default;
+    Future& operator= (Future&&) = default;
+    Future (const Future&) = delete;
+    Future& operator= (const Future&) = delete;
+
+    bool valid     () const { return (bool)state; }
+    bool ready     () const { return state && state->getStatus() != Status::PENDING; }
+    bool cancelled () const { return state && state->getStatus() == Status::CANCELLED; }
+
+    // Cancel: skips the producing task / continuation if it hasn't started yet.
+    void cancel () { if (state) state->cancel(); }
+
+    // Result (moved out). Throws the task's exception, FutureCancelled, or std::logic_error if the
+    // future isn't ready.
+    T get () {
+        if (!ready())
+            throw std::logic_error("Future::get(): not ready");
+        switch (state->getStatus()) {
+            case Status::EXCEPTION: std::rethrow_exception(state->getException());
+            case Status::CANCELLED: throw FutureCancelled();
+            default: break;
+        }
+        if constexpr (!std::is_void<T>::value)
+            return std::move(state->value());
+    }
+
+    // Run fn(result) on executor once this future is ready (inline for an empty executor, on
+    // whichever thread completes it). Consumes this future.
+    template <typename F>
+    auto then (const TaskExecutor& executor, F fn) -> Future<typename detail::ContinuationResult<T, F>::type> {
+        typedef typename detail::ContinuationResult<T, F>::type R;
+        if (!state)
+            throw std::logic_error("Future::then(): invalid future");
+        Promise<R> promise;
+        auto next   = promise.getFuture();
+        auto sourceState = state.operator->();
+
+        sourceState->setContinuation(executor, [source = std::move(state), promise = std::move(promise), fn = std::move(fn)]() mutable {
+            switch (source->getStatus()) {
+                case Status::CANCELLED: promise.cancel(); return;
+                case Status::EXCEPTION: promise.setException(source->getException()); return;
+                default: break;
+            }
+            if (promise.cancelled())
+                return;
+            if constexpr (std::is_void<T>::value)
+                detail::fulfill(promise, fn);
+            else
+                detail::fulfill(promise, fn, std::move(source->value()));
+        });
+        return next;
+    }
+    template <typename F>
+    auto then (F fn) { return then(TaskExecutor(), std::move(fn)); }
+
+    // Internal (whenAll()): raw continuation, run inline on completion.
+    void onComplete (ThreadTask&& task) { state->setContinuation(TaskExecutor(), std::move(task)); }
+};
+
+// Producer side of a Future, for results that don't come from postTask() (eg. callbacks).
+// Dropping a Promise w/out setting it cancels its future (so continuations don't leak).
+template <typename T>
+class Promise {
+    detail::StateRef<T> state;
+public:
+    Promise () : state(detail::FutureState<T>::create()) {}
+    ~Promise () { if (state) state->cancel(); }
+
+    Promise (Promise&&) noexcept = default;
+    Promise& operator= (Promise&& other) noexcept {
+        if (state) state->cancel();
+        state = std::move(other.state);
+        return *this;
+    }
+    Promise (const Promise&) = delete;
+    Promise& operator= (const Promise&) = delete;
+
+    Future<T> getFuture () { return Future<T>(state); }
+
+    // Returns false if the future was cancelled (or already set).
+    template <typename... Args>
+    bool setValue (Args&&... args) {
+        if constexpr (std::is_void<T>::value)
+            return state->setValue(true);
+        else
+            return state->setValue(std::forward<Args>(args)...);
+    }
+    bool setException (std::exception_ptr e) { return state->setException(e); }
+
+    // Give up: cancels the future.
+    void cancel () { state->cancel(); }
+    bool cancelled () const { return state->getStatus() == detail::FutureStatus::CANCELLED; }
+};
+
+template <typename T, typename F, typename... Args>
+void detail::fulfill (Promise<T>& promise, F& fn, Args&&... args) {
+    try {
+        if constexpr (std::is_void<T>::value) {
+            fn(std::forward<Args>(args)...);
+            promise.setValue();
+        } else {
+            promise.setValue(fn(std::forward<Args>(args)...));
+        }
+    } catch (...) {
+        promise.setException(std::current_exception());
+    }
+}
+
+// Post fn to executor (a KThread, JobScheduler, ...); returns a Future for its result. fn is
+// skipped if the future is cancelled before it starts.
+template <typename F>
+auto postTask (const TaskExecutor& executor, F fn) -> Future<decltype(fn())> {
+    typedef decltype(fn()) R;
+    Promise<R> promise;
+    auto future = promise.getFuture();
+    executor.post([promise = std::move(promise), fn = std::move(fn)]() mutable {
+        if (!promise.cancelled())
+            detail::fulfill(promise, fn);
+    });
+    return future;
+}
+
+namespace detail {
+
+// whenAll(): inputs + a countdown, freed by the last input's continuation.
+template <typename T, typename R>
+struct WhenAll {
+    std::vector<Future<T>>  inputs;
+    std::atomic<size_t>     remaining;
+    Promise<R>              promise;
+
+    explicit WhenAll (std::vector<Future<T>>&& inputs)
+        : inputs(std::move(inputs)), remaining(this->inputs.size()) {}
+
+    void complete () {
+        // First cancellation / exception wins (in input order).
+        for (auto& input : inputs) {
+            if (input.cancelled())
+                return promise.cancel();
+        }
+        try {
+            if constexpr (std::is_void<T>::value) {
+                for (auto& input : inputs)
+                    input.get();
+                promise.setValue();
+            } else {
+                R values;
+                values.reserve(inputs.size());
+                for (auto& input : inputs)
+                    values.push_back(input.get());
+                promise.setValue(std::move(values));
+            }
+        } catch (...) {
+            promise.setException(std::current_exception());
+        }
+    }
+
+    static Future<R> start (std::vector<Future<T>>&& inputs) {
+        for (auto& input : inputs) {
+            if (!input.valid())
+                throw std::logic_error("whenAll(): invalid future");
+        }
+        auto block = new (BlockPool::allocate(sizeof(WhenAll))) WhenAll(std::move(inputs));
+        auto future = block->promise.getFuture();
+        if (block->inputs.empty()) {
+            block->complete();
+            destroy(block);
+            return future;
+        }
+        for (auto& input : block->inputs) {
+            input.onComplete([block]() {
+                if (block->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    block->complete();
+                    destroy(block);
+                }
+            });
+        }
+        return future;
+    }
+    static void destroy (WhenAll* block) {
+        block->~WhenAll();
+        BlockPool::deallocate(block, sizeof(WhenAll));
+    }
+};
+
+}; // namespace detail
+
+// Future for all of futures (consumed); values in input order. Fails w/ the first (by input order)
+// exception, or is cancelled if any input was.
+template <typename T>
+Future<std::vector<T>> whenAll (std::vector<Future<T>> futures) {
+    return detail::WhenAll<T, std::vector<T>>::start(std::move(futures));
+}
+inline Future<void> whenAll (std::vector<Future<void>> futures) {
+    return detail::WhenAll<void, void>::start(std::move(futures));
+}
+
+}; // namespace thread
+}; // namespace k
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace k {
+namespace thread {
+
+// Spin-wait hint (x86 pause / arm yield).
+inline void cpuRelax () {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+//
+// Parks (blocks) a consumer thread until a producer calls unpark(). Uses a futex on linux, and a
+// mutex + condition variable elsewhere.
+//
+// Consumer protocol (avoids lost wakeups):
+//      auto token = parker.prepare();
+//      if (haveWork()) parker.cancel();        // re-check AFTER prepare()
+//      else            parker.park(token, timeout);
+//
+// Producers publish work, then call unpark(); that is a fence + one load when nobody is parked.
+//
+class Parker {
+    std::atomic<uint32_t> epoch    { 0 };
+    std::atomic<uint32_t> sleepers { 0 };
+#if !defined(__linux__)
+    std::mutex              mutex;
+    std::condition_variable cv;
+#endif
+public:
+    uint32_t prepare () {
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_acquire);
+    }
+    void cancel () {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Sleep until unpark() is called (after prepare() returned token), or timeout (0 = none).
+    void park (uint32_t token, std::chrono::microseconds timeout) {
+#if defined(__linux__)
+        struct timespec ts, *tsp = nullptr;
+        if (timeout.count() > 0) {
+            ts.tv_sec  = (time_t)(timeout.count() / 1000000);
+            ts.tv_nsec = (long)(timeout.count() % 1000000) * 1000;
+            tsp = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, token, tsp, nullptr, 0);
+#else
+        std::unique_lock<std::mutex> lock(mutex);
+        auto woken = [this, token]() { return epoch.load(std::memory_order_acquire) != token; };
+        if (timeout.count() > 0)
+            cv.wait_for(lock, timeout, woken);
+        else
+            cv.wait(lock, woken);
+#endif
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Wake parked threads, if any. Returns true if there was a thread to wake.
+    bool unpark () {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0)
+            return false;
+#if defined(__linux__)
+        epoch.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            epoch.fetch_add(1, std::memory_order_release);
+        }
+        cv.notify_all();
+#endif
+        return true;
+    }
+};
+
+// Idle behavior for a thread w/ an empty queue: spin, then yield, then park.
+struct IdleConfig {
+    uint32_t                  spinCount   = 64;     // idle steps that spin (spinPauses cpuRelax() each)
+    uint32_t                  spinPauses  = 32;
+    uint32_t                  yieldCount  = 16;     // idle steps that yield, after spinning
+    std::chrono::microseconds parkTimeout { 10000 }; // max park time (0 = park until woken)
+};
+
+// Per-thread idle counters (cumulative).
+struct IdleStats {
+    uint64_t spins  = 0;    // idle steps spent spinning
+    uint64_t yields = 0;    // ... yielding
+    uint64_t parks  = 0;    // times the thread parked
+    uint64_t wakes  = 0;    // wake() calls that had to unpark the thread
+};
+
+//
+// Adaptive idle strategy: call idle() each time the owning thread finds no work, and reset() once it
+// finds some. Successive idle() calls spin w/ cpuRelax(), then yield, then park until a producer
+// calls wake() (or parkTimeout passes, for threads that also poll other sources).
+//
+class IdleStrategy {
+    IdleConfig            config;
+    uint32_t              step = 0;
+    Parker                parker;
+    std::atomic<uint64_t> spins { 0 }, yields { 0 }, parks { 0 }, wakes { 0 };
+
+    // Single writer counters (the owning thread).
+    static void bump (std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+public:
+    IdleStrategy () {}
+    IdleStrategy (const IdleConfig& config) : config(config) {}
+
+    // Owning thread only (and not while idle).
+    void configure (const IdleConfig& config) { this->config = config; }
+
+    // Owning thread: found work.
+    void reset () { step = 0; }
+
+    // Owning thread: no work found; wait a little (or a lot). hasWork() is re-checked before parking.
+    // wakeAt: park no later than this (eg. the thread's next timer); returns right away once passed.
+    template <typename F>
+    void idle (const F& hasWork, std::chrono::steady_clock::time_point wakeAt = std::chrono::steady_clock::time_point::max()) {
+        if (step < config.spinCount) {
+            ++step;
+            for (uint32_t i = 0; i < config.spinPauses; ++i)
+                cpuRelax();
+            bump(spins);
+        } else if (step < config.spinCount + config.yieldCount) {
+            ++step;
+            std::this_thread::yield();
+            bump(yields);
+        } else {
+            auto token = parker.prepare();
+            if (hasWork()) {
+                parker.cancel();
+                return;
+            }
+            auto timeout = config.parkTimeout;
+            if (wakeAt != std::chrono::steady_clock::time_point::max()) {
+                auto now = std::chrono::steady_clock::now();
+                if (wakeAt <= now) {
+                    parker.cancel();
+                    return;
+                }
+                auto untilWake = std::chrono::ceil<std::chrono::microseconds>(wakeAt - now);
+                if (timeout.count() == 0 || untilWake < timeout)
+                    timeout = untilWake;
+            }
+            bump(parks);
+            parker.park(token, timeout);
+        }
+    }
+
+    // Any thread: call after publishing work for the owning thread.
+    void wake () {
+        if (parker.unpark())
+            wakes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    IdleStats stats () const {
+        IdleStats s;
+        s.spins  = spins.load(std::memory_order_relaxed);
+        s.yields = yields.load(std::memory_order_relaxed);
+        s.parks  = parks.load(std::memory_order_relaxed);
+        s.wakes  = wakes.load(std::memory_order_relaxed);
+        return s;
+    }
+};
+
+}; // namespace thread
+}; // namespace k
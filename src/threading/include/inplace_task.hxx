@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace k {
+namespace thread {
+
+//
+// Move-only void() callable w/ a fixed size inline buffer (never allocates).
+//
+// Replaces std::function<void()> for thread tasks: std::function heap allocates for any capture
+// larger than ~2 pointers (eg. a shared_ptr + a value). InplaceTask stores the callable inline,
+// and capturing more than SIZE bytes is a compile error (capture less, eg. move a unique_ptr to a
+// larger payload into the lambda, or use a bigger InplaceTask<N>).
+//
+// Callables must be nothrow move constructible (lambdas w/ movable captures are).
+//
+template <size_t SIZE = 48>
+class InplaceTask {
+    struct Ops {
+        void (*invoke)   (void* fn);
+        void (*relocate) (void* dst, void* src);   // move construct dst from src + destroy src
+        void (*destroy)  (void* fn);
+    };
+    template <typename F>
+    struct OpsFor {
+        static void invoke (void* fn) { (*static_cast<F*>(fn))(); }
+        static void relocate (void* dst, void* src) {
+            new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy (void* fn) { static_cast<F*>(fn)->~F(); }
+        static constexpr Ops ops { &invoke, &relocate, &destroy };
+    };
+
+    alignas(std::max_align_t) unsigned char storage[SIZE];
+    const Ops*                              ops = nullptr;
+
+    template <typename F>
+    using EnableIfCallable = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, InplaceTask>::value &&
+        !std::is_same<typename std::decay<F>::type, std::nullptr_t>::value
+    >::type;
+public:
+    static constexpr size_t CAPACITY = SIZE;
+
+    InplaceTask () noexcept {}
+    InplaceTask (std::nullptr_t) noexcept {}
+
+    template <typename F, typename = EnableIfCallable<F>>
+    InplaceTask (F&& fn) {
+        typedef typename std::decay<F>::type Fn;
+        static_assert(sizeof(Fn) <= SIZE,
+            "InplaceTask: callable is too large for the inline buffer (capture less, or use a larger InplaceTask<N>)");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "InplaceTask: callable is over-aligned");
+        static_assert(std::is_nothrow_move_constructible<Fn>::value, "InplaceTask: callable must be nothrow movable");
+        new (storage) Fn(std::forward<F>(fn));
+        ops = &OpsFor<Fn>::ops;
+    }
+
+    InplaceTask (InplaceTask&& other) noexcept { moveFrom(other); }
+    InplaceTask& operator= (InplaceTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+    InplaceTask (const InplaceTask&) = delete;
+    InplaceTask& operator= (const InplaceTask&) = delete;
+
+    ~InplaceTask () { reset(); }
+
+    void reset () {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+    explicit operator bool () const { return ops != nullptr; }
+
+    void operator() () { ops->invoke(storage); }
+private:
+    void moveFrom (InplaceTask& other) {
+        if (other.ops) {
+            other.ops->relocate(storage, other.storage);
+            ops = other.ops;
+            other.ops = nullptr;
+        }
+    }
+};
+
+}; // namespace thread
+}; // namespace k
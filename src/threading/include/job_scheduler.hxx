@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "thread.hxx"
+#include "thread_affinity.hxx"
+#include "work_stealing_deque.hxx"
+
+namespace k {
+namespace thread {
+
+// Per-worker counters (cumulative; relaxed reads, so approximate while workers are running).
+struct JobWorkerStats {
+    uint64_t executed = 0;  // jobs run by this worker
+    uint64_t local    = 0;  // ... taken from its own deque
+    uint64_t injected = 0;  // ... taken from the injection queue
+    uint64_t stolen   = 0;  // ... stolen from another worker
+    uint64_t sleeps   = 0;  // times this worker went to sleep (no work anywhere)
+};
+
+// Automatic worker pool sizing (see JobScheduler::enableAutoScale()).
+//
+// The monitor samples queue depth + sleeping workers every sampleInterval, and makes a decision
+// every samplesPerDecision samples. Hysteresis: grow after growAfter consecutive "busy" decisions,
+// shrink after shrinkAfter consecutive "idle" ones (any other decision resets both), by one worker
+// at a time.
+struct AutoScaleConfig {
+    size_t                      minWorkers         = 1;
+    size_t                      maxWorkers         = 0;     // 0 => JobScheduler::maxWorkerCount()
+    std::chrono::milliseconds   sampleInterval     { 10 };
+    uint32_t                    samplesPerDecision = 25;
+    double                      growQueueDepth     = 2.0;   // busy: avg queued jobs per worker above this...
+    double                      growIdleRatio      = 0.1;   // ...and fewer than this fraction of workers asleep
+    double                      shrinkIdleRatio    = 0.5;   // idle: more than this fraction of workers asleep
+    uint32_t                    growAfter          = 1;
+    uint32_t                    shrinkAfter        = 4;
+
+    // Back off when the box is oversubscribed (eg. several processes per host): the box is
+    // overloaded once the 1 minute load average, minus this pool's awake workers, exceeds
+    // overloadFactor * hardware threads, and stays so until it drops below recoverFactor * hardware
+    // threads (hysteresis). While overloaded, the pool never grows, and shrinks by one worker
+    // (down to minWorkers) after backoffAfter consecutive overloaded decisions.
+    bool                        respectSystemLoad  = true;
+    double                      overloadFactor     = 1.0;
+    double                      recoverFactor      = 0.8;
+    uint32_t                    backoffAfter       = 8;
+    std::function<double()>     loadAverage;                // load source; empty => getloadavg() (linux only)
+};
+
+// Which jobs JobScheduler::runOne() may take / pendingJobs() counts.
+enum class JobFilter {
+    ANY,
+    NO_BACKGROUND,      // skip TaskPriority::BACKGROUND jobs: for threads that help while idle / waiting
+};
+
+//
+// Work stealing job scheduler, used for all stealable (not thread specific) work.
+//
+// – each worker thread has a Chase-Lev deque (see WorkStealingDeque); jobs posted from a worker go
+//   to the bottom of its own deque (LIFO, cache warm), and idle workers steal from the top of a
+//   random victim's deque.
+// – jobs posted from any other thread go to a global (MPMC) injection queue.
+// – pinned threads (main, GL, window threads) keep their own KThread queues, but can call
+//   runOne(JobFilter::NO_BACKGROUND) to help w/ stealable jobs when they're idle (see
+//   KThread::setJobScheduler()). Attached threads are registered as helpers: when a job is posted
+//   while no worker is asleep to take it, one (parked) helper is woken, round robin.
+// – TaskPriority::BACKGROUND jobs go to a separate queue, only taken by workers when there is no
+//   other work (own deque, injection queue and steal attempts all came up empty); helpers skip
+//   them, so a long asset decode never stalls a frame critical thread. Other priorities are
+//   scheduled alike.
+// – workers w/ nothing to do sleep until a job is posted.
+// – jobs come from BlockPool, so posting doesn't allocate in steady state.
+// – the pool can be resized at runtime (setWorkerCount(), or enableAutoScale()); worker slots are
+//   preallocated (maxWorkerCount()), and a removed worker stops taking new jobs, drains its own
+//   deque, then exits, so no job is lost or run twice.
+//
+// Job order is NOT FIFO; use a KThread queue (or a single job) for work that must run in order.
+//
+class JobScheduler {
+public:
+    // Worker thread count; 0 => one per hardware thread, minus one (for the main thread).
+    // maxWorkers: upper bound for setWorkerCount(); 0 => max(workerCount, hardware threads).
+    explicit JobScheduler (size_t workerCount = 0, size_t maxWorkers = 0);
+    ~JobScheduler ();   // runs remaining jobs, then joins workers
+
+    JobScheduler (const JobScheduler&) = delete;
+    JobScheduler& operator= (const JobScheduler&) = delete;
+
+    // Post a job. Safe to call from any thread (incl. from jobs).
+    void post (ThreadTask task, TaskPriority priority = TaskPriority::NORMAL);
+
+    // Run one stealable job on the calling thread, if there is one. Returns false if no job was found.
+    // Safe to call from any thread. Threads that help while idle / waiting (pinned threads,
+    // FrameGraph::execute(), parallel_for) pass JobFilter::NO_BACKGROUND.
+    bool runOne (JobFilter filter = JobFilter::ANY);
+
+    // Called if a job throws. Default: std::terminate().
+    // Must be set before posting jobs.
+    void setExceptionHandler (std::function<void(const std::exception&)> handler);
+
+    // Active worker count (workers being drained after a shrink aren't counted).
+    size_t workerCount    () const { return activeWorkers.load(std::memory_order_relaxed); }
+    size_t maxWorkerCount () const { return workers.size(); }
+
+    // Grow / shrink the pool (clamped to [1, maxWorkerCount()]). Shrinking doesn't block: removed
+    // workers finish their current job + drain their deque in the background.
+    // Call from any thread except this scheduler's workers (throws std::logic_error).
+    void setWorkerCount (size_t count);
+
+    // Size the pool automatically (see AutoScaleConfig); runs a monitor thread until disabled.
+    void enableAutoScale  (const AutoScaleConfig& config);
+    void disableAutoScale ();
+
+    // Pin worker i to cpus (see thread_affinity.hxx); also applies when worker i is (re)started by a
+    // resize. Returns false if pinning failed / unsupported, or worker i isn't running.
+    bool setWorkerAffinity (size_t worker, const CpuSet& cpus);
+
+    // Index of the calling thread if it is a worker of this scheduler, or -1.
+    int currentWorker () const;
+
+    // Counters for worker slot i (< maxWorkerCount()).
+    JobWorkerStats stats (size_t worker) const;
+
+    // Register / unregister a pinned thread to wake for jobs (called by KThread::setJobScheduler()).
+    // Up to MAX_HELPERS threads; more still help, but aren't woken. removeHelper() waits for a
+    // post() that may be waking thread, so it's safe to destroy thread once it returns.
+    static constexpr size_t MAX_HELPERS = 16;
+    void addHelper    (KThread* thread);
+    void removeHelper (KThread* thread);
+
+    // Approximate number of jobs queued (not yet started).
+    size_t pendingJobs (JobFilter filter = JobFilter::ANY) const {
+        auto count = queued.load(std::memory_order_relaxed);
+        if (filter == JobFilter::NO_BACKGROUND)
+            count -= queuedBackground.load(std::memory_order_relaxed);
+        return (size_t)std::max<int64_t>(count, 0);
+    }
+private:
+    struct Job;
+    struct InjectionQueue;
+    struct Worker;
+
+    Job* findJob (Worker* self, JobFilter filter);
+    void runJob (Job* job);
+    void workerLoop (size_t index);
+    void wake (bool helpers);
+    void wakeHelper ();
+    void autoScaleLoop (AutoScaleConfig config);
+
+    std::vector<std::unique_ptr<Worker>>        workers;        // all slots; [0, activeWorkers) running
+    std::unique_ptr<InjectionQueue>             injected;
+    std::function<void(const std::exception&)>  exceptionHandler;
+
+    alignas(64) std::atomic<int64_t>    queued   { 0 };     // jobs posted but not yet taken
+    std::atomic<int64_t>                queuedBackground { 0 };     // ... of which BACKGROUND
+    std::atomic<size_t>                 sleepers { 0 };
+    std::atomic<bool>                   stopping { false };
+    std::mutex                          sleepMutex;
+    std::condition_variable             sleepCv;
+
+    std::atomic<KThread*>               helpers[MAX_HELPERS] {};   // [0, helperCount) registered
+    std::atomic<size_t>                 helperCount   { 0 };
+    std::atomic<int>                    wakingHelpers { 0 };        // post()s in wakeHelper()
+    std::mutex                          helperMutex;                // add / remove
+
+    std::mutex                          resizeMutex;
+    std::atomic<size_t>                 activeWorkers { 0 };
+
+    std::thread                         autoScaleThread;
+    std::mutex                          autoScaleMutex;
+    std::condition_variable             autoScaleCv;
+    bool                                autoScaleStop = false;
+};
+
+}; // namespace thread
+}; // namespace k
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "thread.hxx"
+
+namespace k {
+namespace thread {
+
+class JobScheduler;
+
+//
+// Data parallel algorithms over a JobScheduler (the app's worker pool: ThreadManager::jobs()).
+//
+//  parallel_for(jobs, { 0, transforms.size() }, 0, [&](size_t i) { transforms[i].update(); });
+//  auto sum = parallel_reduce(jobs, { 0, n }, 0, 0.0, [&](size_t i) { return weights[i]; },
+//                             [](double a, double b) { return a + b; });
+//  parallel_sort(jobs, keys.begin(), keys.end());
+//
+// – ranges are split recursively (in halves, at grain boundaries): each job posts its upper half
+//   and keeps splitting the lower one, so workers steal big pieces and run small ones locally.
+// – grain = 0 => automatic: the calling thread times a few items first (doubling batches), and
+//   picks a grain that makes chunks ~PARALLEL_CHUNK_TIME long, w/ enough chunks for all workers.
+//   Items run by the probe count as done (nothing runs twice).
+// – the calling thread doesn't block: it runs jobs (any but BACKGROUND ones; see
+//   JobScheduler::runOne()) until its range is done, so it's safe to call from a worker, or from
+//   a job (nested loops).
+// – jobs == nullptr (or a scheduler w/out workers) => runs serially on the calling thread.
+// – if fn throws, chunks that haven't started are skipped, and the first exception is rethrown
+//   once all running chunks are done.
+//
+// Chunks are posted as TaskPriority::FRAME_CRITICAL jobs (the caller is waiting on them).
+//
+
+// Half open index range [begin, end).
+struct IndexRange {
+    size_t begin = 0, end = 0;
+
+    IndexRange () {}
+    IndexRange (size_t begin, size_t end) : begin(begin), end(std::max(begin, end)) {}
+    size_t size  () const { return end - begin; }
+    bool   empty () const { return begin == end; }
+};
+
+// Target run time per chunk when the grain is picked automatically (≫ job post + steal overhead).
+static constexpr std::chrono::microseconds PARALLEL_CHUNK_TIME { 25 };
+
+// Max time the automatic grain probe runs serially before posting anything.
+static constexpr std::chrono::microseconds PARALLEL_PROBE_TIME { 10 };
+
+namespace detail {
+
+// Shared state for one parallel call; lives on the caller's stack until wait() returns.
+class ParallelContext {
+public:
+    ParallelContext (JobScheduler* jobs, size_t base, size_t count, size_t grain)
+        : jobs(*jobs), base(base), grain(grain), remaining(count) {}
+
+    ParallelContext (const ParallelContext&) = delete;
+    ParallelContext& operator= (const ParallelContext&) = delete;
+
+    void post (ThreadTask task);
+    void fail ();
+    bool failed () const { return cancelled.load(std::memory_order_relaxed); }
+
+    // Mark count items done. Nothing may touch the context after the last call (wait() returns).
+    void done (size_t count) { remaining.fetch_sub(count, std::memory_order_acq_rel); }
+
+    // Run jobs until all items are done; rethrows the first exception.
+    void wait ();
+
+    JobScheduler&       jobs;
+    const size_t        base;       // leaves start at base + k * grain
+    const size_t        grain;
+private:
+    std::atomic<size_t> remaining;
+    std::atomic<bool>   cancelled { false };
+    std::mutex          exceptionMutex;
+    std::exception_ptr  exception;
+};
+
+// Worker count of jobs (0 for nullptr).
+size_t parallelWorkers (JobScheduler* jobs);
+
+// Grain for count remaining items, given a probe that ran probed items in elapsed.
+size_t autoGrain (TaskClock::duration elapsed, size_t probed, size_t count, size_t workers);
+
+// Run [lo, hi) as leaves of ctx.grain items (leaf(lo, hi)), posting upper halves as jobs.
+template <typename Leaf>
+void parallelSplit (ParallelContext& ctx, const Leaf& leaf, size_t lo, size_t hi) {
+    while (hi - lo > ctx.grain) {
+        size_t chunks = (hi - lo + ctx.grain - 1) / ctx.grain;
+        size_t mid    = lo + chunks / 2 * ctx.grain;
+        ParallelContext* context = &ctx;
+        const Leaf*      body    = &leaf;
+        ctx.post([context, body, mid, hi]() { parallelSplit(*context, *body, mid, hi); });
+        hi = mid;
+    }
+    if (!ctx.failed()) {
+        try {
+            leaf(lo, hi);
+        } catch (...) {
+            ctx.fail();
+        }
+    }
+    ctx.done(hi - lo);
+}
+
+// Run [range.begin, range.begin + probed) serially in doubling batches (run(lo, hi)) and pick a
+// grain for the rest. Returns the number of items run.
+template <typename Run>
+size_t probeGrain (IndexRange range, size_t workers, size_t& grain, const Run& run) {
+    size_t count    = range.size();
+    size_t maxProbe = std::max<size_t>(1, count / (8 * (workers + 1)));
+    size_t probed   = 0, batch = 1;
+    auto   start    = TaskClock::now();
+    auto   elapsed  = TaskClock::duration::zero();
+    while (probed < maxProbe && elapsed < PARALLEL_PROBE_TIME) {
+        batch = std::min(batch, maxProbe - probed);
+        run(range.begin + probed, range.begin + probed + batch);
+        probed += batch;
+        batch  *= 2;
+        elapsed = TaskClock::now() - start;
+    }
+    grain = autoGrain(elapsed, probed, count - probed, workers);
+    return probed;
+}
+
+// Call fn w/ an IndexRange, or per index.
+template <typename F>
+void parallelInvoke (const F& fn, size_t lo, size_t hi) {
+    if constexpr (std::is_invocable_v<const F&, IndexRange>) {
+        fn(IndexRange(lo, hi));
+    } else {
+        for (size_t i = lo; i < hi; ++i)
+            fn(i);
+    }
+}
+
+// Fold [lo, hi) into acc w/ map(IndexRange, T) -> T, or combine(acc, map(i)).
+template <typename T, typename Map, typename Combine>
+T parallelFold (const Map& map, const Combine& combine, T acc, size_t lo, size_t hi) {
+    if constexpr (std::is_invocable_v<const Map&, IndexRange, T>) {
+        return map(IndexRange(lo, hi), std::move(acc));
+    } else {
+        for (size_t i = lo; i < hi; ++i)
+            acc = combine(std::move(acc), map(i));
+        return acc;
+    }
+}
+
+}; // namespace detail
+
+// Run fn for every index in range: fn(size_t i), or fn(IndexRange chunk) (to vectorize, hoist
+// per chunk setup, etc). grain: items per chunk; 0 => automatic.
+template <typename F>
+void parallel_for (JobScheduler* jobs, IndexRange range, size_t grain, const F& fn) {
+    size_t workers = detail::parallelWorkers(jobs);
+    if (!workers || range.size() <= std::max<size_t>(grain, 1)) {
+        detail::parallelInvoke(fn, range.begin, range.end);
+        return;
+    }
+    if (!grain) {
+        range.begin += detail::probeGrain(range, workers, grain, [&fn](size_t lo, size_t hi) {
+            detail::parallelInvoke(fn, lo, hi);
+        });
+        if (range.empty())
+            return;
+    }
+    auto leaf = [&fn](size_t lo, size_t hi) { detail::parallelInvoke(fn, lo, hi); };
+    detail::ParallelContext ctx (jobs, range.begin, range.size(), grain);
+    detail::parallelSplit(ctx, leaf, range.begin, range.end);
+    ctx.wait();
+}
+
+// Reduce range to one value: map(size_t i) -> T (folded w/ combine), or map(IndexRange chunk,
+// T init) -> T. Chunk results are combined in index order (left to right), so the result only
+// depends on the grain, not on scheduling; combine must be associative, and identity its identity.
+template <typename T, typename Map, typename Combine>
+T parallel_reduce (JobScheduler* jobs, IndexRange range, size_t grain, T identity, const Map& map, const Combine& combine) {
+    size_t workers = detail::parallelWorkers(jobs);
+    if (!workers || range.size() <= std::max<size_t>(grain, 1))
+        return detail::parallelFold(map, combine, std::move(identity), range.begin, range.end);
+
+    T head = identity;
+    if (!grain) {
+        range.begin += detail::probeGrain(range, workers, grain, [&](size_t lo, size_t hi) {
+            head = detail::parallelFold(map, combine, std::move(head), lo, hi);
+        });
+        if (range.empty())
+            return head;
+    }
+    std::vector<T> partials ((range.size() + grain - 1) / grain, identity);
+    detail::ParallelContext ctx (jobs, range.begin, range.size(), grain);
+    auto leaf = [&](size_t lo, size_t hi) {
+        auto& partial = partials[(lo - ctx.base) / ctx.grain];
+        partial = detail::parallelFold(map, combine, std::move(partial), lo, hi);
+    };
+    detail::parallelSplit(ctx, leaf, range.begin, range.end);
+    ctx.wait();
+
+    for (auto& partial : partials)
+        head = combine(std::move(head), std::move(partial));
+    return head;
+}
+
+// Sort [first, last) w/ comp (not stable). Sorts chunks in parallel (std::sort), then merges them
+// pairwise, each merge split into independent pieces; uses a temporary buffer of last - first
+// elements (values are moved, never copied). Small ranges are sorted serially.
+template <typename It, typename Compare = std::less<>>
+void parallel_sort (JobScheduler* jobs, It first, It last, Compare comp = Compare()) {
+    typedef typename std::iterator_traits<It>::value_type Value;
+    static constexpr size_t SERIAL_SORT = 4096;     // below this, std::sort wins
+    static constexpr size_t MERGE_PIECE = 4096;     // min elements per merge piece
+
+    size_t count   = (size_t)std::distance(first, last);
+    size_t workers = detail::parallelWorkers(jobs);
+    if (!workers || count <= SERIAL_SORT) {
+        std::sort(first, last, comp);
+        return;
+    }
+    std::vector<Value> buffer (std::make_move_iterator(first), std::make_move_iterator(last));
+
+    // Sort runs of ~count / (2 * (workers + 1)) elements in the buffer.
+    size_t runs = std::min((workers + 1) * 2, count / SERIAL_SORT);
+    std::vector<size_t> bounds (runs + 1);
+    for (size_t i = 0; i <= runs; ++i)
+        bounds[i] = count * i / runs;
+    parallel_for(jobs, { 0, runs }, 1, [&](size_t i) {
+        std::sort(buffer.begin() + bounds[i], buffer.begin() + bounds[i + 1], comp);
+    });
+
+    // Merge pairs of runs (ping-ponging between buffer + [first, last)) until one is left.
+    struct Piece { size_t a, aEnd, b, bEnd, out; };
+    std::vector<Piece> pieces;
+    bool inBuffer = true;
+    auto merge = [&](auto src, auto dst) {
+        pieces.clear();
+        std::vector<size_t> merged;
+        for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+            size_t lo = bounds[i], mid = bounds[i + 1];
+            size_t hi = i + 2 < bounds.size() ? bounds[i + 2] : mid;    // odd run out: moved as is
+            merged.push_back(lo);
+
+            // Split at pivots from the left run: right run elements < pivot go before it.
+            size_t parts = std::max<size_t>(1, (hi - lo) / MERGE_PIECE);
+            size_t a = lo, b = mid;
+            for (size_t p = 1; p <= parts; ++p) {
+                size_t aEnd = p == parts ? mid : lo + (mid - lo) * p / parts;
+                size_t bEnd = p == parts ? hi
+                    : (size_t)(std::lower_bound(src + b, src + hi, src[aEnd], comp) - src);
+                pieces.push_back({ a, aEnd, b, bEnd, a + (b - mid) });
+                a = aEnd;
+                b = bEnd;
+            }
+        }
+        merged.push_back(count);
+        parallel_for(jobs, { 0, pieces.size() }, 1, [&](size_t i) {
+            auto& piece = pieces[i];
+            std::merge(std::make_move_iterator(src + piece.a), std::make_move_iterator(src + piece.aEnd),
+                       std::make_move_iterator(src + piece.b), std::make_move_iterator(src + piece.bEnd),
+                       dst + piece.out, comp);
+        });
+        bounds = std::move(merged);
+    };
+    while (bounds.size() > 2) {
+        if (inBuffer) merge(buffer.begin(), first);
+        else          merge(first, buffer.begin());
+        inBuffer = !inBuffer;
+    }
+    if (inBuffer) {
+        parallel_for(jobs, { 0, count }, 0, [&](IndexRange r) {
+            std::move(buffer.begin() + r.begin, buffer.begin() + r.end, first + r.begin);
+        });
+    }
+}
+
+}; // namespace thread
+}; // namespace k
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <coroutine>
+#include "thread.hxx"
+#include "job_scheduler.hxx"
+
+namespace k {
+namespace thread {
+
+// Where a task / continuation runs: a KThread (at a priority), or any JobScheduler worker.
+// An empty executor runs tasks inline, on the calling thread.
+struct TaskExecutor {
+    KThread*      thread   = nullptr;
+    JobScheduler* jobs     = nullptr;
+    TaskPriority  priority = TaskPriority::NORMAL;
+
+    TaskExecutor () {}
+    TaskExecutor (KThread& thread, TaskPriority priority = TaskPriority::NORMAL)
+        : thread(&thread), priority(priority) {}
+    TaskExecutor (JobScheduler& jobs, TaskPriority priority = TaskPriority::NORMAL)
+        : jobs(&jobs), priority(priority) {}
+
+    explicit operator bool () const { return thread || jobs; }
+
+    void post (ThreadTask&& task) const {
+        if (thread)    thread->postTask(priority, std::move(task));
+        else if (jobs) jobs->post(std::move(task), priority);
+        else           task();
+    }
+    // Post a task that resumes a coroutine: never dropped by a bounded KThread level (that would
+    // leak the coroutine + hang its awaiters); see KThread::postResume().
+    void postResume (ThreadTask&& task) const {
+        if (thread) thread->postResume(priority, std::move(task));
+        else        post(std::move(task));
+    }
+    void resume (std::coroutine_handle<> handle) const {
+        postResume([handle]() { handle.resume(); });
+    }
+};
+
+}; // namespace thread
+}; // namespace k
@@ -1,12 +1,122 @@
 
 #pragma once
 
-#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include "idle_strategy.hxx"
+#include "inplace_task.hxx"
 
 namespace k {
 namespace thread {
 
-typedef std::function<void()> ThreadTask;
+// Move-only task w/ 48 bytes of inline capture storage (64 byte objects); never allocates.
+// Larger captures are a compile error (see InplaceTask).
+typedef InplaceTask<48> ThreadTask;
+
+class KThread;
+class KThreadImpl;
+class JobScheduler;
+
+// Task priority levels, highest first.
+enum class TaskPriority : uint8_t {
+    REALTIME = 0,       // input handling, etc
+    FRAME_CRITICAL,     // work the current frame waits on
+    NORMAL,             // default
+    BACKGROUND,         // asset decode, autosave, etc
+    COUNT
+};
+static constexpr size_t TASK_PRIORITY_COUNT = (size_t)TaskPriority::COUNT;
+
+// Clock for task deadlines + timers.
+typedef std::chrono::steady_clock TaskClock;
+
+// Timer handle (see KThread::postTaskAfter()); 0 is never a valid id.
+typedef uint64_t TimerId;
+
+// What a bounded task queue does w/ a post that would exceed its capacity (see KThread::setQueueLimit()).
+enum class OverflowPolicy : uint8_t {
+    BLOCK,          // wait for the thread to catch up (not when posting from the thread itself,
+                    // or while it isn't running)
+    DROP_OLDEST,    // drop the oldest queued task(s) to make room; like REJECT if that can't make
+                    // room (resumes + deadline tasks the thread has already taken aren't dropped)
+    REJECT,         // drop the new task; post returns PostStatus::REJECTED
+    COALESCE,       // keyed posts replace the queued task w/ the same key; otherwise like REJECT
+};
+
+// Per priority level queue bound. capacity = 0 => unbounded (default).
+struct QueueLimit {
+    size_t          capacity = 0;
+    OverflowPolicy  policy   = OverflowPolicy::BLOCK;
+};
+
+// Result of KThread::postTask() / postTasks().
+enum class PostStatus : uint8_t {
+    POSTED,
+    COALESCED,          // replaced a queued task w/ the same key
+    DROPPED_OLDEST,     // posted, after dropping older task(s)
+    REJECTED,           // not posted (queue full); the task is not moved from
+};
+
+// Key for coalescing posts (see KThread::postTask(priority, key, task)).
+typedef uint64_t CoalesceKey;
+
+// Overflow counters for one priority level (cumulative).
+struct QueueStats {
+    uint64_t overflows = 0;     // posts that found the queue full
+    uint64_t blocked   = 0;     // ... and waited (BLOCK)
+    uint64_t dropped   = 0;     // tasks dropped to make room (DROP_OLDEST)
+    uint64_t rejected  = 0;     // posts rejected (REJECT, COALESCE)
+    uint64_t coalesced = 0;     // keyed posts that replaced a queued task (COALESCE; not overflows)
+};
+
+// Slack task scheduling (see KThread::postSlackTask()).
+struct SlackConfig {
+    std::chrono::microseconds reserve  { 1000 };    // keep this much of the time before the frame deadline free
+    std::chrono::microseconds minSlice { 250 };     // don't start slack tasks w/ less time than this
+    std::chrono::microseconds maxSlice { 4000 };    // max time per slack window (also w/out a frame deadline)
+};
+
+// Slack task counters (cumulative).
+struct SlackStats {
+    uint64_t            windows   = 0;      // slack windows used (idle time before a deadline)
+    uint64_t            runs      = 0;      // slack task calls
+    uint64_t            continued = 0;      // ... that called SlackBudget::continueLater()
+    uint64_t            skipped   = 0;      // times slack tasks were waiting, but there was too little slack
+    TaskClock::duration busy {};            // time spent in slack tasks
+};
+
+// Time budget for the running slack task. Long slack tasks should work in steps, check expired()
+// between them, and call continueLater() if they stop early:
+//
+//  thread.postSlackTask([cache]() {
+//      auto& slack = SlackBudget::current();
+//      while (cache->compactStep())
+//          if (slack.expired()) { slack.continueLater(); return; }
+//  });
+//
+class SlackBudget {
+public:
+    // Budget for the slack task running on this thread (an expired one outside slack tasks).
+    static SlackBudget& current ();
+
+    // Out of time, or the thread has other (non slack) work to do, incl. pending stealable jobs.
+    bool expired () const;
+
+    TaskClock::time_point end       () const { return until; }
+    TaskClock::duration   remaining () const { return until - TaskClock::now(); }
+
+    // Run this task again (in place, so it keeps its state) in the next slack window, before
+    // other slack tasks.
+    void continueLater () { again = true; }
+private:
+    friend class KThreadImpl;
+    const KThreadImpl*    thread = nullptr;
+    TaskClock::time_point until;
+    bool                  again = false;
+};
 
 // Used to signal error location in onInternalException.
 enum class ThreadErrorLocation {
@@ -24,6 +134,9 @@ enum class ThreadErrorLocation {
 
 // Defines thread behavior outside of run + execute tasks.
 class IThreadWorker {
+public:
+    virtual ~IThreadWorker () {}
+
     // Called when thread main loop begins (before all tasks).
     virtual void onThreadInit (KThread&) {}
 
@@ -34,7 +147,10 @@ class IThreadWorker {
     // Note: exceptions get caught automatically + passed to onTaskException.
     virtual void runTask (KThread&, ThreadTask& task) { task(); }
 
-    // Called when task queue is empty. Can block / sleep, etc.
+    // Called when task queue is empty (and there were no stealable jobs to help with; see
+    // KThread::setJobScheduler()). Can poll other event sources (eg. receive from Channels), etc.
+    // Should not block: KThread idles by itself afterwards (spin -> yield -> park, see IdleStrategy +
+    // KThread::setIdleConfig()), until a task is posted or KThread::wake() is called.
     virtual void onAwaitTasks (KThread&) {}
 
     // Called when an exception is thrown while executing a ThreadTask.
@@ -53,10 +169,34 @@ class IThreadWorker {
     virtual bool onInternalException (KThread&, ThreadErrorLocation, const std::exception&) = 0;
 };
 
-class KThreadImpl;
-
 // Basic, opaque thread class.
-// Internally uses moodycamel::ConcurrentQueue (concurrentqueue.h) to store tasks.
+// Internally uses moodycamel::ConcurrentQueue (concurrentqueue.h) to store tasks. Each posting
+// thread gets its own (cached) producer token, and the run loop dequeues tasks in batches.
+// Idle threads spin briefly, then yield, then park until a task is posted (see IdleStrategy).
+//
+// Tasks are queued per TaskPriority:
+// – the run loop takes tasks from the highest priority non-empty level, and stops a batch early
+//   when higher priority tasks arrive (BACKGROUND tasks run one at a time).
+// – starvation protection: a lower level that has been waiting longer than its starvation limit
+//   gets to run one task / batch ahead of higher levels (see setStarvationLimit()).
+// – tasks posted w/ a deadline run before plain tasks of the same level, earliest deadline first.
+// Tasks of the same level (w/out deadlines) run in FIFO order per posting thread.
+//
+// Queues are unbounded by default. setQueueLimit() bounds a level's queue (tasks posted, not yet
+// picked up by the thread) w/ an OverflowPolicy, so a stalled thread doesn't build up an unbounded
+// backlog. The bound is approximate: threads posting at the same time can overshoot it by one post
+// each. Dropped / rejected tasks are destroyed without running (a Future posted through
+// postTask(executor, fn) then completes as cancelled: its Promise is destroyed w/ the task).
+// Coroutine resumes (TaskExecutor) are never dropped; see postResume().
+//
+// Slack tasks (postSlackTask()) are background work for frame driven threads (main, GL, window
+// threads): they only run when the thread is idle and, given the frame deadline (setFrameDeadline(),
+// eg. the next buffer swap), predicts enough idle time before it (SlackConfig), and they get a
+// SlackBudget to yield by. They run after stealable jobs (see setJobScheduler()).
+//
+// Timers (postTaskAfter() / postTaskAt() / postPeriodic()) are kept in a per-thread timer wheel,
+// and run on the thread once due, ahead of queued tasks. A thread w/ nothing else to do parks until
+// its next timer is due (instead of its idle parkTimeout), so timers don't need polling threads.
 class KThread {
     std::unique_ptr<KThreadImpl> impl;
 public:
@@ -67,8 +207,97 @@ public:
     bool isRunning ();
     void setRunning (bool running);
 
-    // Post a thread task to run on this thread.
-    void postTask (const ThreadTask& task);
+    // Post a thread task (eg. a lambda) to run on this thread (default: TaskPriority::NORMAL).
+    // Always PostStatus::POSTED for unbounded queues (see setQueueLimit()).
+    PostStatus postTask (ThreadTask&& task) { return postTask(TaskPriority::NORMAL, std::move(task)); }
+    PostStatus postTask (TaskPriority priority, ThreadTask&& task);
+
+    // Post a task w/ a deadline; runs before tasks w/out deadlines at the same priority.
+    PostStatus postTask (TaskPriority priority, TaskClock::time_point deadline, ThreadTask&& task);
+
+    // Post a task that must not be dropped (coroutine resumes; see TaskExecutor::resume()). Ignores
+    // the level's OverflowPolicy: waits for room like OverflowPolicy::BLOCK, and DROP_OLDEST skips
+    // it. Runs w/ the level's deadline tasks (deadline: now), ahead of its plain tasks.
+    void postResume (TaskPriority priority, ThreadTask&& task);
+
+    // Post a task that supersedes any queued task w/ the same key (eg. "resize window 3", "save
+    // settings"), on levels w/ OverflowPolicy::COALESCE; elsewhere the same as postTask(priority, task).
+    PostStatus postTask (TaskPriority priority, CoalesceKey key, ThreadTask&& task);
+
+    // Post many tasks at once (one queue operation); tasks are moved from (unless rejected: a
+    // bounded level takes all of them or, for REJECT / COALESCE, none).
+    // Use for fan-out (per-entity / per-module jobs, etc).
+    PostStatus postTasks (TaskPriority priority, ThreadTask* tasks, size_t count);
+    PostStatus postTasks (ThreadTask* tasks, size_t count) { return postTasks(TaskPriority::NORMAL, tasks, count); }
+
+    template <typename Range>
+    PostStatus postTasks (Range& tasks) { return postTasks(std::data(tasks), std::size(tasks)); }
+    template <typename Range>
+    PostStatus postTasks (TaskPriority priority, Range& tasks) { return postTasks(priority, std::data(tasks), std::size(tasks)); }
+
+    // Run a task once, at / after time (or delay from now). Any thread; returns an id for
+    // cancelTimer(). Timer tasks run at most ~one task batch late when the thread is busy.
+    TimerId postTaskAt    (TaskClock::time_point time, ThreadTask&& task);
+    TimerId postTaskAfter (TaskClock::duration delay, ThreadTask&& task) { return postTaskAt(TaskClock::now() + delay, std::move(task)); }
+
+    // Run a task every period (fixed rate from first, default now + period; if the thread falls
+    // behind, missed runs are skipped rather than run back to back). The task is run in place, so
+    // it can keep state between runs.
+    TimerId postPeriodic (TaskClock::duration period, ThreadTask&& task) { return postPeriodic(TaskClock::now() + period, period, std::move(task)); }
+    TimerId postPeriodic (TaskClock::time_point first, TaskClock::duration period, ThreadTask&& task);
+
+    // Post a slack task: runs when the thread has idle time before its frame deadline, in post order.
+    // Tasks that don't finish in their budget call SlackBudget::current().continueLater(). Any thread.
+    void postSlackTask (ThreadTask&& task);
+
+    // Deadline for the current frame (eg. FrameInfo::deadline: next swap / vsync). Slack tasks don't
+    // run past it (minus SlackConfig::reserve) until the next frame's deadline is set; w/out one,
+    // idle threads run slack tasks in SlackConfig::maxSlice windows. Any thread.
+    void setFrameDeadline (TaskClock::time_point deadline);
+
+    // Slack window sizing. Must be set before runMainLoop().
+    void setSlackConfig (const SlackConfig& config);
+
+    SlackStats slackStats () const;
+
+    // Cancel a timer (any thread, incl. from its own task). Takes effect on the owning thread: a
+    // timer that is already due (or running) at that point may still run once.
+    void cancelTimer (TimerId id);
+
+    // Wake the thread if it's idle, so it runs onAwaitTasks() again (eg. to receive messages: see
+    // Channel::setReceiver()). Any thread; a fence + a load when the thread isn't parked.
+    void wake ();
+
+    // Help run stealable jobs from a JobScheduler whenever this thread's own queue is empty
+    // (pinned threads: main, GL, window threads). BACKGROUND jobs are left to workers.
+    // nullptr => don't help (default).
+    // Any thread, any time: once it returns, this thread won't touch the old scheduler again (it
+    // waits for a job this thread is running from it), so detach before destroying a scheduler.
+    // Don't call it from a job (of the old scheduler) running on this thread.
+    void setJobScheduler (JobScheduler* scheduler);
+
+    // Max tasks dequeued at once by the run loop (default 32). Must be set before runMainLoop().
+    void setTaskBatchSize (size_t batchSize);
+
+    // Max time tasks at a priority level can be passed over for higher priority tasks before one of
+    // them runs anyway. Defaults: FRAME_CRITICAL 4ms, NORMAL 16ms, BACKGROUND 100ms (REALTIME is
+    // never passed over). Must be set before runMainLoop().
+    void setStarvationLimit (TaskPriority priority, std::chrono::microseconds limit);
+
+    // Bound the task queue of a priority level (default: unbounded). Must be set before posting
+    // tasks to that level.
+    void setQueueLimit (TaskPriority priority, const QueueLimit& limit);
+
+    // Overflow counters for a priority level.
+    QueueStats queueStats (TaskPriority priority) const;
+
+    // Idle (empty queue) behavior. Must be set before runMainLoop().
+    // Threads polling onAwaitTasks() should keep a finite parkTimeout (JobScheduler helpers are
+    // woken for jobs).
+    void setIdleConfig (const IdleConfig& config);
+
+    // Spin / yield / park counts for this thread.
+    IdleStats idleStats () const;
 
     // Launch the main thread. If already running throws a std::runtime_exception.
     void runMainLoop ();
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace k {
+namespace thread {
+
+typedef std::vector<int> CpuSet;    // logical cpu ids (sorted)
+
+// Parse a linux cpu list ("0-3,8,10-11"). Returns an empty set on malformed input.
+CpuSet parseCpuList (const std::string& list);
+
+// Logical cpu layout, from /sys/devices/system/cpu (linux), restricted to the cpus this process is
+// allowed to run on (taskset, container cpusets). Elsewhere (or if /sys is unreadable): one
+// physical core + L3 domain per allowed cpu / hardware thread.
+struct CpuTopology {
+    struct Cpu {
+        int id      = 0;    // logical cpu
+        int core    = 0;    // physical core (index into cores)
+        int l3      = 0;    // L3 cache domain (index into l3Domains)
+    };
+    std::vector<Cpu>    cpus;
+    std::vector<CpuSet> cores;      // SMT siblings per physical core
+    std::vector<CpuSet> l3Domains;  // cpus sharing an L3 cache
+
+    static CpuTopology detect ();
+};
+
+// Thread placement, set at launch (see AppConfig::affinity).
+//
+// Threads are named: "main", "gl", "window" (all window threads), "worker.N".
+// – AUTO: main + gl get separate physical cores (all SMT siblings of it, so the OS can't migrate
+//   them to another core); workers are spread round robin across L3 domains, each pinned to its
+//   domain (minus the main / gl cores when there are enough cores left), so they can balance within
+//   a domain but don't migrate across; window threads may run anywhere but the gl core.
+//   AUTO picks the same cores in every process, so only opt in when the app has the machine (or
+//   its cpuset) to itself; co-hosted processes would fight over them.
+// – NONE: no pinning (OS scheduling). Default.
+// Explicit pins (eg. pin["gl"] = { 2 }, pin["worker.0"] = { 4, 5 }) override the policy.
+//
+struct AffinityConfig {
+    enum class Mode { NONE, AUTO };
+
+    Mode                          mode = Mode::NONE;
+    std::map<std::string, CpuSet> pin;
+
+    // Parse explicit pins, eg. "gl=2;main=0;worker.0=4-5". Returns false on malformed input.
+    bool parsePins (const std::string& pins);
+};
+
+// Cpu set per thread name (see AffinityConfig). Names w/out an entry aren't pinned.
+class AffinityPlan {
+    std::map<std::string, CpuSet> sets;
+public:
+    AffinityPlan () {}
+    AffinityPlan (const CpuTopology& topology, const AffinityConfig& config, size_t workerCount);
+
+    // Cpus for thread name (worker threads: "worker.N"); empty => don't pin.
+    const CpuSet& cpusFor (const std::string& name) const;
+    const std::map<std::string, CpuSet>& all () const { return sets; }
+};
+
+// Pin a thread to cpus (pthread_setaffinity_np). Returns false if unsupported / failed, or cpus is
+// empty.
+bool setThreadAffinity        (std::thread& thread, const CpuSet& cpus);
+bool setCurrentThreadAffinity (const CpuSet& cpus);
+
+}; // namespace thread
+}; // namespace k
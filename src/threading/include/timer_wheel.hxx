@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "inplace_task.hxx"
+#include "thread.hxx"
+
+namespace k {
+namespace thread {
+
+//
+// Hierarchical timer wheel (single threaded; KThread runs one per thread, see postTaskAfter()).
+//
+// LEVEL_COUNT levels of SLOT_COUNT slots; a level 0 slot is one tick (resolution, default 1ms), a
+// level 1 slot SLOT_COUNT ticks, etc (4 x 64 slots at 1ms: ~4.6 hours; later deadlines are parked in
+// the last slot + re-inserted). Timers cascade down a level each time the level below wraps, and
+// a level 0 slot's timers move to a small heap ordered by exact deadline when the slot is reached,
+// so they fire at their deadline (not the tick boundary), and nextDeadline() is exact.
+//
+// Add / cancel are O(1) (+ a hash lookup for cancel); runDue() is O(ticks elapsed / SLOT_COUNT)
+// when idle (empty slots are skipped a level 0 round at a time) + O(log n) per timer fired.
+//
+class TimerWheel {
+public:
+    static constexpr uint32_t LEVEL_COUNT = 4;
+    static constexpr uint32_t SLOT_BITS   = 6;
+    static constexpr uint32_t SLOT_COUNT  = 1 << SLOT_BITS;
+
+    explicit TimerWheel (TaskClock::duration resolution = std::chrono::milliseconds(1),
+                         TaskClock::time_point origin = TaskClock::now());
+
+    TimerWheel (const TimerWheel&) = delete;
+    TimerWheel& operator= (const TimerWheel&) = delete;
+
+    // Add a timer w/ a (caller chosen, unique) id. period > 0 => runs every period after deadline
+    // (fixed rate; missed periods are skipped, not run back to back).
+    void add (TimerId id, TaskClock::time_point deadline, TaskClock::duration period, ThreadTask&& task);
+
+    // Cancel a timer. Returns false if there is no such timer (fired, or already cancelled).
+    // Can be called from a running timer task (incl. to cancel itself).
+    bool cancel (TimerId id);
+
+    // Run all timers due at now, by deadline.
+    void runDue (TaskClock::time_point now) { runDue(now, [](ThreadTask& task) { task(); }); }
+    template <typename F>
+    void runDue (TaskClock::time_point now, const F& run);
+
+    size_t size  () const { return ids.size(); }
+    bool   empty () const { return ids.empty(); }
+
+    // Earliest time a timer may be due (time_point::max() if there are none). Exact for timers in
+    // the next SLOT_COUNT ticks; for later timers, a (conservative) time the wheel needs to cascade.
+    TaskClock::time_point nextDeadline () const;
+private:
+    static constexpr uint32_t NONE = ~(uint32_t)0;
+
+    enum class TimerState : uint8_t { FREE, WHEEL, DUE, RUNNING, CANCELLED };
+
+    struct Timer {
+        TimerId                 id = 0;
+        TaskClock::time_point   deadline;
+        TaskClock::duration     period {};
+        ThreadTask              task;
+        uint32_t                prev = NONE, next = NONE;   // slot list
+        uint8_t                 level = 0, slot = 0;
+        TimerState              state = TimerState::FREE;
+    };
+    struct DueTimer {
+        TaskClock::time_point   deadline;
+        uint32_t                index;
+
+        // Min heap (std::*_heap are max heaps).
+        bool operator< (const DueTimer& other) const { return deadline > other.deadline; }
+    };
+
+    uint64_t tickOf (TaskClock::time_point time) const;
+    void     insert (uint32_t index);
+    void     unlink (uint32_t index);
+    void     release (uint32_t index);
+    void     cascade (uint32_t level, uint32_t slot);
+    void     expire (uint32_t slot);
+    void     advance (uint64_t tick);
+    void     reschedule (uint32_t index, TaskClock::time_point now);
+
+    TaskClock::duration                     resolution;
+    TaskClock::time_point                   origin;
+    uint64_t                                currentTick = 0;    // next tick to process
+
+    std::deque<Timer>                       timers;             // stable: tasks run in place
+    std::vector<uint32_t>                   freeTimers;
+    std::unordered_map<TimerId, uint32_t>   ids;                // live timers => index
+    uint32_t                                heads[LEVEL_COUNT][SLOT_COUNT];
+    uint64_t                                occupied[LEVEL_COUNT] = {};     // bit per non-empty slot
+    std::vector<DueTimer>                   due;                // min heap; may hold cancelled timers
+};
+
+template <typename F>
+void TimerWheel::runDue (TaskClock::time_point now, const F& run) {
+    advance(tickOf(now));
+    while (!due.empty() && due.front().deadline <= now) {
+        std::pop_heap(due.begin(), due.end());
+        auto index = due.back().index;
+        due.pop_back();
+
+        auto& timer = timers[index];
+        if (timer.state == TimerState::CANCELLED) {
+            release(index);
+            continue;
+        }
+        // Runs in place (+ the timer stays registered), so periodic tasks keep their state and
+        // the task can cancel itself; a cancel while running takes effect once it returns.
+        timer.state = TimerState::RUNNING;
+        struct Finish {
+            TimerWheel* wheel;
+            uint32_t    index;
+            TaskClock::time_point now;
+            ~Finish () { wheel->reschedule(index, now); }
+        } finish { this, index, now };
+        run(timer.task);
+    }
+}
+
+}; // namespace thread
+}; // namespace k
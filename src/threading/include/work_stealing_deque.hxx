@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace k {
+namespace thread {
+
+//
+// Chase-Lev work stealing deque (w/ the C11 memory orderings from Lê et al, "Correct and Efficient
+// Work-Stealing for Weak Memory Models", 2013).
+//
+// – push() / pop() may only be called by the owning thread, and work on the bottom (LIFO).
+// – steal() may be called from any thread, and takes from the top (FIFO).
+// – the ring buffer grows when full; old buffers are kept until the deque is destroyed, since
+//   concurrent thieves may still be reading from them.
+//
+// T should be a small trivially copyable type (eg. a pointer).
+//
+template <typename T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque values must be trivially copyable");
+
+    struct Ring {
+        int64_t                             mask;
+        std::unique_ptr<std::atomic<T>[]>   slots;
+
+        Ring (int64_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+        int64_t capacity () const { return mask + 1; }
+        T    get (int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put (int64_t i, T value) { slots[i & mask].store(value, std::memory_order_relaxed); }
+
+        Ring* grow (int64_t top, int64_t bottom) const {
+            auto ring = new Ring(capacity() * 2);
+            for (auto i = top; i != bottom; ++i)
+                ring->put(i, get(i));
+            return ring;
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> top    { 0 };
+    alignas(64) std::atomic<int64_t> bottom { 0 };
+    std::atomic<Ring*>               ring;
+    std::vector<std::unique_ptr<Ring>> rings;     // current + retired rings (owner only)
+public:
+    // capacity must be a power of 2.
+    WorkStealingDeque (size_t capacity = 256) : ring(new Ring((int64_t)capacity)) {
+        rings.emplace_back(ring.load(std::memory_order_relaxed));
+    }
+    WorkStealingDeque (const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator= (const WorkStealingDeque&) = delete;
+
+    // Owner: push a value onto the bottom.
+    void push (T value) {
+        auto b = bottom.load(std::memory_order_relaxed);
+        auto t = top.load(std::memory_order_acquire);
+        auto r = ring.load(std::memory_order_relaxed);
+        if (b - t > r->capacity() - 1) {
+            r = r->grow(t, b);
+            rings.emplace_back(r);
+            ring.store(r, std::memory_order_release);
+        }
+        r->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner: pop a value from the bottom. Returns false if empty (or the last value was stolen).
+    bool pop (T& value) {
+        auto b = bottom.load(std::memory_order_relaxed) - 1;
+        auto r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        value = r->get(b);
+        if (t == b) {
+            // Last value: race thieves for it.
+            bool won = top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread: steal a value from the top. Returns false if empty or lost a race.
+    bool steal (T& value) {
+        auto t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        value = ring.load(std::memory_order_acquire)->get(t);
+        return top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Approximate number of values (exact if called by the owner w/ no concurrent thieves).
+    size_t size () const {
+        auto b = bottom.load(std::memory_order_relaxed);
+        auto t = top.load(std::memory_order_relaxed);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+    bool empty () const { return size() == 0; }
+};
+
+}; // namespace thread
+}; // namespace k
@@ -0,0 +1,121 @@
+#include "../include/block_pool.hxx"
+#include <mutex>
+#include <new>
+
+namespace k {
+namespace thread {
+
+static constexpr size_t BLOCK_MIN_SHIFT     = 6;    // 64 bytes
+static constexpr size_t BLOCK_CLASS_COUNT   = 7;    // .. 4k
+static constexpr size_t BLOCK_MAX_SIZE      = (size_t)1 << (BLOCK_MIN_SHIFT + BLOCK_CLASS_COUNT - 1);
+static constexpr size_t BLOCK_CACHE_LIMIT   = 64;   // max free blocks kept per class, per thread
+static constexpr size_t BLOCK_SHARED_LIMIT  = 1024; // max free blocks kept per class, shared
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// Shared free lists, for blocks that pile up on one thread (eg. frames allocated by one thread +
+// freed by another): thread caches hand half their blocks over when they overflow, and take a batch
+// back when they run empty. Never destroyed, so thread caches can flush into it at exit.
+struct BlockShared {
+    std::mutex mutex;
+    FreeBlock* heads  [BLOCK_CLASS_COUNT] = {};
+    size_t     counts [BLOCK_CLASS_COUNT] = {};
+};
+static BlockShared& sharedBlocks () {
+    static BlockShared& shared = *new BlockShared();
+    return shared;
+}
+
+static void freeBlocks (FreeBlock* list) {
+    while (list) {
+        auto next = list->next;
+        ::operator delete(list);
+        list = next;
+    }
+}
+
+// Per-thread free lists (flushed to the shared lists when the thread exits).
+struct BlockCache {
+    FreeBlock* heads  [BLOCK_CLASS_COUNT] = {};
+    size_t     counts [BLOCK_CLASS_COUNT] = {};
+
+    BlockCache () { sharedBlocks(); }
+    ~BlockCache () {
+        for (size_t index = 0; index < BLOCK_CLASS_COUNT; ++index)
+            flush(index, counts[index]);
+    }
+
+    // Move up to n blocks from the shared list of class index into this cache.
+    void refill (size_t index, size_t n) {
+        auto& shared = sharedBlocks();
+        std::lock_guard<std::mutex> lock (shared.mutex);
+        for (; n && shared.heads[index]; --n) {
+            auto block = shared.heads[index];
+            shared.heads[index] = block->next; --shared.counts[index];
+            block->next = heads[index]; heads[index] = block; ++counts[index];
+        }
+    }
+
+    // Move n blocks of class index into the shared list; past BLOCK_SHARED_LIMIT they go back to
+    // the heap.
+    void flush (size_t index, size_t n) {
+        auto& shared = sharedBlocks();
+        FreeBlock* overflow = nullptr;
+        {
+            std::lock_guard<std::mutex> lock (shared.mutex);
+            for (; n && heads[index]; --n) {
+                auto block = heads[index];
+                heads[index] = block->next; --counts[index];
+                if (shared.counts[index] < BLOCK_SHARED_LIMIT) {
+                    block->next = shared.heads[index]; shared.heads[index] = block; ++shared.counts[index];
+                } else {
+                    block->next = overflow; overflow = block;
+                }
+            }
+        }
+        freeBlocks(overflow);
+    }
+};
+static thread_local BlockCache tlsBlockCache;
+
+static size_t blockClass (size_t size) {
+    size_t index = 0;
+    while (((size_t)1 << (BLOCK_MIN_SHIFT + index)) < size)
+        ++index;
+    return index;
+}
+
+void* BlockPool::allocate (size_t size) {
+    if (size > BLOCK_MAX_SIZE)
+        return ::operator new(size);
+
+    auto  index = blockClass(size);
+    auto& cache = tlsBlockCache;
+    if (!cache.heads[index])
+        cache.refill(index, BLOCK_CACHE_LIMIT / 2);
+    if (auto block = cache.heads[index]) {
+        cache.heads[index] = block->next;
+        --cache.counts[index];
+        return block;
+    }
+    return ::operator new((size_t)1 << (BLOCK_MIN_SHIFT + index));
+}
+
+void BlockPool::deallocate (void* ptr, size_t size) noexcept {
+    if (size > BLOCK_MAX_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    auto  index = blockClass(size);
+    auto& cache = tlsBlockCache;
+    auto  block = static_cast<FreeBlock*>(ptr);
+    block->next = cache.heads[index];
+    cache.heads[index] = block;
+    if (++cache.counts[index] > BLOCK_CACHE_LIMIT)
+        cache.flush(index, BLOCK_CACHE_LIMIT / 2);
+}
+
+}; // namespace thread
+}; // namespace k
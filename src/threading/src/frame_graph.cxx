@@ -0,0 +1,273 @@
+#include "../include/frame_graph.hxx"
+#include "../include/job_scheduler.hxx"
+#include <algorithm>
+#include <stdexcept>
+
+namespace k {
+namespace thread {
+
+struct FrameGraph::Node {
+    std::string                 name;
+    std::function<void()>       run;
+    bool                        enabled = true;
+    bool                        barrier = false;
+    std::vector<ResourceId>     readSet, writeSet;
+
+    // Built by build():
+    std::vector<NodeId>         successors, predecessors;
+
+    // Per execute():
+    std::atomic<uint32_t>       remaining { 0 };    // predecessors not yet done
+    TaskClock::duration         duration {};
+
+    // Per updateStats():
+    TaskClock::duration         finish {};          // end of the longest chain ending at this node
+    NodeId                      criticalPred = INVALID_NODE;
+};
+
+FrameGraph::FrameGraph () {}
+FrameGraph::~FrameGraph () {}
+
+FrameGraph::ResourceId FrameGraph::resource (const std::string& name) {
+    auto it = resourceIds.find(name);
+    if (it != resourceIds.end())
+        return it->second;
+    auto id = (ResourceId)resourceIds.size();
+    resourceIds.emplace(name, id);
+    return id;
+}
+
+FrameGraph::NodeId FrameGraph::addNode (const std::string& name, std::function<void()> run) {
+    std::unique_ptr<Node> node (new Node());
+    node->name = name;
+    node->run  = std::move(run);
+
+    NodeId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        nodes[id] = std::move(node);
+    } else {
+        id = (NodeId)nodes.size();
+        nodes.push_back(std::move(node));
+    }
+    order.push_back(id);
+    dirty = true;
+    return id;
+}
+
+void FrameGraph::removeNode (NodeId node) {
+    if (node >= nodes.size() || !nodes[node])
+        throw std::out_of_range("FrameGraph: invalid node");
+    nodes[node].reset();
+    freeIds.push_back(node);
+    order.erase(std::find(order.begin(), order.end(), node));
+    dirty = true;
+}
+
+void FrameGraph::reads (NodeId node, ResourceId resource) {
+    nodes.at(node)->readSet.push_back(resource);
+    dirty = true;
+}
+void FrameGraph::writes (NodeId node, ResourceId resource) {
+    nodes.at(node)->writeSet.push_back(resource);
+    dirty = true;
+}
+void FrameGraph::barrier (NodeId node) {
+    nodes.at(node)->barrier = true;
+    dirty = true;
+}
+void FrameGraph::clearAccess (NodeId node) {
+    nodes.at(node)->readSet.clear();
+    nodes.at(node)->writeSet.clear();
+    nodes.at(node)->barrier = false;
+    dirty = true;
+}
+void FrameGraph::setEnabled (NodeId node, bool enabled) {
+    nodes.at(node)->enabled = enabled;
+}
+const std::string& FrameGraph::nodeName (NodeId node) const {
+    return nodes.at(node)->name;
+}
+
+// Build edges from resource declarations, walking nodes in add order.
+void FrameGraph::build () {
+    struct ResourceState {
+        NodeId              lastWriter = INVALID_NODE;
+        std::vector<NodeId> readers;    // since lastWriter
+    };
+    std::vector<ResourceState> resources (resourceIds.size());
+
+    for (auto id : order) {
+        nodes[id]->successors.clear();
+        nodes[id]->predecessors.clear();
+    }
+    auto addEdge = [this](NodeId from, NodeId to) {
+        if (from != INVALID_NODE && from != to)
+            nodes[to]->predecessors.push_back(from);
+    };
+    NodeId              lastBarrier = INVALID_NODE;
+    std::vector<NodeId> sinceBarrier;
+    for (auto id : order) {
+        auto& node = *nodes[id];
+        if (node.barrier) {
+            // After everything since the last barrier (which ran after everything before it).
+            addEdge(lastBarrier, id);
+            for (auto prev : sinceBarrier)
+                addEdge(prev, id);
+            lastBarrier = id;
+            sinceBarrier.clear();
+            resources.assign(resources.size(), ResourceState());   // ordered by the barrier now
+            continue;
+        }
+        addEdge(lastBarrier, id);
+        sinceBarrier.push_back(id);
+        for (auto r : node.readSet) {
+            addEdge(resources[r].lastWriter, id);
+            resources[r].readers.push_back(id);
+        }
+        for (auto r : node.writeSet) {
+            auto& resource = resources[r];
+            addEdge(resource.lastWriter, id);
+            for (auto reader : resource.readers)
+                addEdge(reader, id);
+            resource.lastWriter = id;
+            resource.readers.clear();
+        }
+    }
+
+    roots.clear();
+    size_t edges = 0;
+    for (auto id : order) {
+        auto& preds = nodes[id]->predecessors;
+        std::sort(preds.begin(), preds.end());
+        preds.erase(std::unique(preds.begin(), preds.end()), preds.end());
+        for (auto pred : preds)
+            nodes[pred]->successors.push_back(id);
+        if (preds.empty())
+            roots.push_back(id);
+        edges += preds.size();
+    }
+    lastStats.edges = edges;
+    ++lastStats.builds;
+    dirty = false;
+}
+
+void FrameGraph::post (NodeId node) {
+    jobs->post([this, node]() { runNode(node); }, TaskPriority::FRAME_CRITICAL);
+}
+
+// Run a node, then (if running on jobs) release its successors: the first one that becomes ready
+// runs next on this thread (no queue round trip), the rest are posted.
+void FrameGraph::runNode (NodeId id) {
+    while (id != INVALID_NODE) {
+        auto& node = *nodes[id];
+        auto  start = TaskClock::now();
+        if (node.enabled) {
+            try {
+                node.run();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!exception)
+                    exception = std::current_exception();
+            }
+        }
+        node.duration = TaskClock::now() - start;
+        if (!jobs)
+            return;
+
+        NodeId next = INVALID_NODE;
+        for (auto successor : node.successors) {
+            if (nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (next == INVALID_NODE) next = successor;
+                else                      post(successor);
+            }
+        }
+        // Nothing may touch the graph after the last node finishes (execute() returns), except
+        // to wake execute(), which waits for finishing to drop to 0.
+        finishing.fetch_add(1, std::memory_order_relaxed);
+        if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            idle.wake();
+        finishing.fetch_sub(1, std::memory_order_release);
+        id = next;
+    }
+}
+
+void FrameGraph::execute (JobScheduler* jobs) {
+    if (dirty)
+        build();
+
+    auto start = TaskClock::now();
+    for (auto id : order)
+        nodes[id]->remaining.store((uint32_t)nodes[id]->predecessors.size(), std::memory_order_relaxed);
+    exception = nullptr;
+
+    if (!jobs || !jobs->workerCount()) {
+        // Add order is a valid topological order.
+        this->jobs = nullptr;
+        for (auto id : order)
+            runNode(id);
+    } else {
+        this->jobs = jobs;
+        outstanding.store(order.size(), std::memory_order_release);
+        for (auto id : roots)
+            post(id);
+
+        // Help w/ (non background) jobs until the graph is done; park when there are none.
+        idle.reset();
+        while (outstanding.load(std::memory_order_acquire) > 0) {
+            if (jobs->runOne(JobFilter::NO_BACKGROUND)) {
+                idle.reset();
+                continue;
+            }
+            idle.idle([this, jobs]() {
+                return outstanding.load(std::memory_order_acquire) == 0
+                    || jobs->pendingJobs(JobFilter::NO_BACKGROUND) > 0;
+            });
+        }
+        while (finishing.load(std::memory_order_acquire) > 0)
+            cpuRelax();
+    }
+    updateStats(start);
+
+    if (exception) {
+        auto e = exception;
+        exception = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+// Critical path: longest chain of node run times through the DAG (order is topological).
+void FrameGraph::updateStats (TaskClock::time_point start) {
+    lastStats.wallTime  = TaskClock::now() - start;
+    lastStats.nodes     = order.size();
+    lastStats.totalWork = TaskClock::duration::zero();
+    lastStats.criticalPath = TaskClock::duration::zero();
+    lastStats.criticalNodes.clear();
+
+    NodeId last = INVALID_NODE;
+    for (auto id : order) {
+        auto& node = *nodes[id];
+        node.finish       = TaskClock::duration::zero();
+        node.criticalPred = INVALID_NODE;
+        for (auto pred : node.predecessors) {
+            auto& p = *nodes[pred];
+            if (p.finish > node.finish || node.criticalPred == INVALID_NODE) {
+                node.finish       = p.finish;
+                node.criticalPred = pred;
+            }
+        }
+        node.finish += node.duration;
+        lastStats.totalWork += node.duration;
+        if (last == INVALID_NODE || node.finish > lastStats.criticalPath) {
+            lastStats.criticalPath = node.finish;
+            last = id;
+        }
+    }
+    for (auto id = last; id != INVALID_NODE; id = nodes[id]->criticalPred)
+        lastStats.criticalNodes.push_back(id);
+    std::reverse(lastStats.criticalNodes.begin(), lastStats.criticalNodes.end());
+}
+
+}; // namespace thread
+}; // namespace k
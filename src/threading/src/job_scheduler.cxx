@@ -0,0 +1,353 @@
+#include "../include/job_scheduler.hxx"
+#include "../include/block_pool.hxx"
+#include "concurrentqueue.h"
+#include <stdexcept>
+#if defined(__linux__)
+#include <cstdlib>
+#endif
+
+namespace k {
+namespace thread {
+
+// Pooled (see BlockPool): jobs are freed on whichever thread ran them, and recycled from there.
+struct JobScheduler::Job {
+    ThreadTask task;
+
+    static void* operator new (size_t size) { return BlockPool::allocate(size); }
+    static void  operator delete (void* ptr, size_t size) noexcept { BlockPool::deallocate(ptr, size); }
+};
+struct JobScheduler::InjectionQueue {
+    moodycamel::ConcurrentQueue<Job*> jobs;
+    moodycamel::ConcurrentQueue<Job*> background;   // TaskPriority::BACKGROUND, from any thread
+};
+
+// Counters are only written by the owning worker.
+struct JobWorkerCounters {
+    std::atomic<uint64_t> executed { 0 }, local { 0 }, injected { 0 }, stolen { 0 }, sleeps { 0 };
+
+    static void bump (std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+struct JobScheduler::Worker {
+    WorkStealingDeque<Job*> deque;
+    std::thread             thread;
+    JobWorkerCounters       counters;
+    std::atomic<bool>       retiring { false };     // removed by a shrink: drain deque, then exit
+    CpuSet                  affinity;               // resizeMutex
+};
+
+// Scheduler + worker index of the calling thread (if it is a worker thread).
+static thread_local const JobScheduler* tlsScheduler   = nullptr;
+static thread_local size_t              tlsWorkerIndex = 0;
+
+// Per-thread xorshift, for picking steal victims.
+static size_t randomIndex (size_t n) {
+    static thread_local uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (size_t)(state % n);
+}
+
+JobScheduler::JobScheduler (size_t workerCount, size_t maxWorkers) : injected(new InjectionQueue()) {
+    auto hardwareThreads = (size_t)std::thread::hardware_concurrency();
+    if (!workerCount)
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    if (!maxWorkers)
+        maxWorkers = std::max(workerCount, hardwareThreads);
+    maxWorkers = std::max(maxWorkers, workerCount);
+
+    // All slots exist up front (workers steal from each other; the slot list never changes).
+    for (size_t i = 0; i < maxWorkers; ++i)
+        workers.emplace_back(new Worker());
+    setWorkerCount(workerCount);
+}
+
+JobScheduler::~JobScheduler () {
+    disableAutoScale();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping.store(true);
+    }
+    sleepCv.notify_all();
+    std::lock_guard<std::mutex> lock(resizeMutex);
+    for (auto& worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+}
+
+void JobScheduler::setWorkerCount (size_t count) {
+    if (tlsScheduler == this)
+        throw std::logic_error("JobScheduler::setWorkerCount() called from a worker thread");
+    count = std::min(std::max<size_t>(count, 1), workers.size());
+
+    std::lock_guard<std::mutex> lock(resizeMutex);
+    size_t active = activeWorkers.load();
+    if (count > active) {
+        for (size_t i = active; i < count; ++i) {
+            auto& worker = *workers[i];
+            if (worker.thread.joinable())
+                worker.thread.join();   // still draining from an earlier shrink
+            worker.retiring.store(false);
+            worker.thread = std::thread(&JobScheduler::workerLoop, this, i);
+            if (!worker.affinity.empty())
+                setThreadAffinity(worker.thread, worker.affinity);
+        }
+    } else if (count < active) {
+        // Highest slots retire; they drain their own deques, so nothing is lost.
+        for (size_t i = count; i < active; ++i)
+            workers[i]->retiring.store(true);
+        std::lock_guard<std::mutex> sleepLock(sleepMutex);
+        sleepCv.notify_all();
+    }
+    activeWorkers.store(count);
+}
+
+void JobScheduler::setExceptionHandler (std::function<void(const std::exception&)> handler) {
+    exceptionHandler = std::move(handler);
+}
+
+bool JobScheduler::setWorkerAffinity (size_t worker, const CpuSet& cpus) {
+    std::lock_guard<std::mutex> lock(resizeMutex);
+    auto& slot = *workers.at(worker);
+    slot.affinity = cpus;
+    return worker < activeWorkers.load() && setThreadAffinity(slot.thread, cpus);
+}
+
+int JobScheduler::currentWorker () const {
+    return tlsScheduler == this ? (int)tlsWorkerIndex : -1;
+}
+
+JobWorkerStats JobScheduler::stats (size_t worker) const {
+    auto& counters = workers[worker]->counters;
+    JobWorkerStats stats;
+    stats.executed = counters.executed.load(std::memory_order_relaxed);
+    stats.local    = counters.local.load(std::memory_order_relaxed);
+    stats.injected = counters.injected.load(std::memory_order_relaxed);
+    stats.stolen   = counters.stolen.load(std::memory_order_relaxed);
+    stats.sleeps   = counters.sleeps.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void JobScheduler::post (ThreadTask task, TaskPriority priority) {
+    auto job = new Job { std::move(task) };
+    bool background = priority == TaskPriority::BACKGROUND;
+    if (background) {
+        queuedBackground.fetch_add(1, std::memory_order_relaxed);   // before queued: helpers never see it as theirs
+        injected->background.enqueue(job);
+    } else if (tlsScheduler == this)
+        workers[tlsWorkerIndex]->deque.push(job);
+    else
+        injected->jobs.enqueue(job);
+
+    // seq_cst: pairs w/ the sleepers increment + queued check in workerLoop().
+    queued.fetch_add(1);
+    wake(!background);
+}
+
+// Wake a sleeping worker, or (all workers busy) a pinned helper thread (unless helpers can't take
+// the job).
+void JobScheduler::wake (bool helpers) {
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCv.notify_one();
+    } else if (helpers && helperCount.load(std::memory_order_relaxed) > 0) {
+        wakeHelper();
+    }
+}
+
+void JobScheduler::wakeHelper () {
+    static thread_local size_t cursor = 0;
+    wakingHelpers.fetch_add(1);     // seq_cst: pairs w/ the slot store + wakingHelpers load in removeHelper()
+    if (auto count = helperCount.load()) {
+        if (auto thread = helpers[cursor++ % count].load())
+            thread->wake();
+    }
+    wakingHelpers.fetch_sub(1, std::memory_order_release);
+}
+
+void JobScheduler::addHelper (KThread* thread) {
+    std::lock_guard<std::mutex> lock(helperMutex);
+    auto count = helperCount.load();
+    if (count < MAX_HELPERS) {
+        helpers[count].store(thread);
+        helperCount.store(count + 1);
+    }
+}
+void JobScheduler::removeHelper (KThread* thread) {
+    {
+        std::lock_guard<std::mutex> lock(helperMutex);
+        auto count = helperCount.load();
+        for (size_t i = 0; i < count; ++i) {
+            if (helpers[i].load() == thread) {
+                helpers[i].store(helpers[count - 1].load());
+                helpers[count - 1].store(nullptr);
+                helperCount.store(count - 1);
+                break;
+            }
+        }
+    }
+    // A post() that loaded thread before it was removed may still be waking it.
+    while (wakingHelpers.load() > 0)
+        std::this_thread::yield();
+}
+
+// Own deque (LIFO) -> injection queue -> steal from workers, starting at a random victim ->
+// background queue (unless filtered).
+JobScheduler::Job* JobScheduler::findJob (Worker* self, JobFilter filter) {
+    Job* job = nullptr;
+    auto take = [this, self, &job](std::atomic<uint64_t> JobWorkerCounters::*counter) {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        if (self) {
+            JobWorkerCounters::bump(self->counters.*counter);
+            JobWorkerCounters::bump(self->counters.executed);
+        }
+        return job;
+    };
+    if (self && self->deque.pop(job))
+        return take(&JobWorkerCounters::local);
+    if (self && self->retiring.load(std::memory_order_relaxed))
+        return nullptr;     // draining: own deque only
+    if (injected->jobs.try_dequeue(job))
+        return take(&JobWorkerCounters::injected);
+
+    size_t n = workers.size();
+    size_t start = randomIndex(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto& victim = workers[(start + i) % n];
+        if (victim.get() != self && victim->deque.steal(job))
+            return take(&JobWorkerCounters::stolen);
+    }
+    if (filter == JobFilter::ANY && injected->background.try_dequeue(job)) {
+        take(&JobWorkerCounters::injected);
+        queuedBackground.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+    return nullptr;
+}
+
+void JobScheduler::runJob (Job* job) {
+    std::unique_ptr<Job> owned (job);
+    try {
+        job->task();
+    } catch (const std::exception& e) {
+        if (!exceptionHandler)
+            std::terminate();
+        exceptionHandler(e);
+    }
+}
+
+bool JobScheduler::runOne (JobFilter filter) {
+    auto self = tlsScheduler == this ? workers[tlsWorkerIndex].get() : nullptr;
+    if (auto job = findJob(self, filter)) {
+        runJob(job);
+        return true;
+    }
+    return false;
+}
+
+void JobScheduler::workerLoop (size_t index) {
+    tlsScheduler   = this;
+    tlsWorkerIndex = index;
+    auto self = workers[index].get();
+
+    while (true) {
+        if (auto job = findJob(self, JobFilter::ANY)) {
+            runJob(job);
+            continue;
+        }
+        if (self->retiring.load())
+            break;      // deque drained (only this thread pushes to it)
+        if (stopping.load() && queued.load() <= 0)
+            break;
+
+        // Nothing to do anywhere: sleep until a job is posted (or we're stopped / retired).
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        JobWorkerCounters::bump(self->counters.sleeps);
+        sleepCv.wait(lock, [this, self]() { return queued.load() > 0 || stopping.load() || self->retiring.load(); });
+        sleepers.fetch_sub(1);
+    }
+    tlsScheduler = nullptr;
+}
+
+void JobScheduler::enableAutoScale (const AutoScaleConfig& config) {
+    disableAutoScale();
+    autoScaleStop = false;
+    autoScaleThread = std::thread(&JobScheduler::autoScaleLoop, this, config);
+}
+void JobScheduler::disableAutoScale () {
+    if (!autoScaleThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(autoScaleMutex);
+        autoScaleStop = true;
+    }
+    autoScaleCv.notify_all();
+    autoScaleThread.join();
+}
+
+// Load from everyone but this pool, per hardware thread; < 0 if unknown. ownLoad: this pool's
+// runnable threads (awake workers), which the load average counts too.
+static double otherLoad (const AutoScaleConfig& config, double ownLoad) {
+    double load = -1;
+    if (!config.respectSystemLoad)
+        return -1;
+    if (config.loadAverage)
+        load = config.loadAverage();
+#if defined(__linux__)
+    else if (getloadavg(&load, 1) != 1)
+        return -1;
+#endif
+    if (load < 0)
+        return -1;
+    return std::max(load - ownLoad, 0.0) / std::max(1u, std::thread::hardware_concurrency());
+}
+
+void JobScheduler::autoScaleLoop (AutoScaleConfig config) {
+    size_t maxWorkers = config.maxWorkers ? std::min(config.maxWorkers, workers.size()) : workers.size();
+    size_t minWorkers = std::min(std::max<size_t>(config.minWorkers, 1), maxWorkers);
+    uint32_t samples = 0, growVotes = 0, shrinkVotes = 0, backoffVotes = 0;
+    double   queuedSum = 0, sleepingSum = 0;
+    bool     overloaded = false;
+
+    std::unique_lock<std::mutex> lock(autoScaleMutex);
+    while (!autoScaleCv.wait_for(lock, config.sampleInterval, [this]() { return autoScaleStop; })) {
+        queuedSum   += (double)pendingJobs();
+        sleepingSum += (double)sleepers.load(std::memory_order_relaxed);
+        if (++samples < config.samplesPerDecision)
+            continue;
+
+        auto   active     = workerCount();
+        double queueDepth = queuedSum / samples / active;
+        double idleRatio  = sleepingSum / samples / active;
+        samples = 0;
+        queuedSum = sleepingSum = 0;
+
+        // Our own awake workers are part of the load average; only back off for everyone else's.
+        // Backing off is slow (backoffAfter decisions per worker) and bounded by minWorkers, since
+        // the 1 minute average lags behind our own shrinks.
+        double load = otherLoad(config, (double)active * (1.0 - idleRatio));
+        overloaded = load >= 0 && load > (overloaded ? config.recoverFactor : config.overloadFactor);
+        bool busy = !overloaded && queueDepth > config.growQueueDepth && idleRatio < config.growIdleRatio;
+        bool idle = idleRatio > config.shrinkIdleRatio;
+        growVotes    = busy ? growVotes + 1 : 0;
+        shrinkVotes  = idle ? shrinkVotes + 1 : 0;
+        backoffVotes = overloaded ? backoffVotes + 1 : 0;
+
+        if (growVotes >= config.growAfter && active < maxWorkers) {
+            setWorkerCount(active + 1);
+            growVotes = 0;
+        } else if ((shrinkVotes >= config.shrinkAfter || backoffVotes >= config.backoffAfter) && active > minWorkers) {
+            setWorkerCount(active - 1);
+            shrinkVotes = backoffVotes = 0;
+        } else if (active < minWorkers || active > maxWorkers) {
+            setWorkerCount(std::min(std::max(active, minWorkers), maxWorkers));
+        }
+    }
+}
+
+}; // namespace thread
+}; // namespace k
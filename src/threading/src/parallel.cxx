@@ -0,0 +1,49 @@
+#include "../include/parallel.hxx"
+#include "../include/job_scheduler.hxx"
+#include <thread>
+
+namespace k {
+namespace thread {
+namespace detail {
+
+void ParallelContext::post (ThreadTask task) {
+    jobs.post(std::move(task), TaskPriority::FRAME_CRITICAL);
+}
+
+void ParallelContext::fail () {
+    std::lock_guard<std::mutex> lock(exceptionMutex);
+    if (!exception)
+        exception = std::current_exception();
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+void ParallelContext::wait () {
+    // Help w/ (non background) jobs until our range is done.
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!jobs.runOne(JobFilter::NO_BACKGROUND))
+            std::this_thread::yield();
+    }
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+size_t parallelWorkers (JobScheduler* jobs) {
+    return jobs ? jobs->workerCount() : 0;
+}
+
+// Chunks of ~PARALLEL_CHUNK_TIME, but at least ~4 chunks per thread (incl. the caller) so late
+// starters + uneven items still balance.
+size_t autoGrain (TaskClock::duration elapsed, size_t probed, size_t count, size_t workers) {
+    size_t maxGrain = std::max<size_t>(1, count / (4 * (workers + 1)));
+    if (elapsed.count() <= 0 || !probed)
+        return maxGrain;    // below clock resolution: as coarse as balancing allows
+
+    auto perItem = std::chrono::duration<double, std::nano>(elapsed).count() / (double)probed;
+    auto target  = std::chrono::duration<double, std::nano>(PARALLEL_CHUNK_TIME).count();
+    auto grain   = (size_t)std::max(1.0, target / perItem);
+    return std::min(grain, maxGrain);
+}
+
+}; // namespace detail
+}; // namespace thread
+}; // namespace k
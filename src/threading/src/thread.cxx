@@ -1,36 +1,363 @@
 
 #include "../include/thread.hxx"
+#include "../include/job_scheduler.hxx"
+#include "../include/timer_wheel.hxx"
+#include <algorithm>
 #include <thread>
 #include <atomic>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include "concurrentqueue.h"
 
+namespace k {
+namespace thread {
+
 using namespace std;
 
-class ThreadWorkerImpl {
-    using moodycamel::ConcurrentQueue;
+static constexpr size_t DEFAULT_TASK_BATCH_SIZE = 32;
+static constexpr size_t TOKEN_CACHE_SIZE        = 16;
+
+// Default starvation limits, per TaskPriority.
+static constexpr std::chrono::microseconds DEFAULT_STARVATION_LIMITS[TASK_PRIORITY_COUNT] = {
+    std::chrono::microseconds(0),       // REALTIME (unused: never passed over)
+    std::chrono::microseconds(4000),    // FRAME_CRITICAL
+    std::chrono::microseconds(16000),   // NORMAL
+    std::chrono::microseconds(100000),  // BACKGROUND
+};
+
+struct DeadlineTask {
+    TaskClock::time_point deadline;
+    ThreadTask            task;
+    bool                  keep = false;     // never dropped (see KThread::postResume())
+
+    // Min heap (std::*_heap are max heaps).
+    bool operator< (const DeadlineTask& other) const { return deadline > other.deadline; }
+};
+
+// Queues + consumer state for one priority level.
+struct TaskLevel {
+    moodycamel::ConcurrentQueue<ThreadTask>    tasks;
+    moodycamel::ConcurrentQueue<DeadlineTask>  deadlineTasks;
+    atomic<int64_t>                            pending { 0 };  // posted, not yet dequeued (tasks) / run (deadline tasks)
+    atomic<int64_t>                            droppable { 0 };    // ... of which still in tasks / deadlineTasks (not resumes)
+
+    // Consumer only:
+    moodycamel::ConsumerToken                  consumerToken { tasks };
+    std::vector<DeadlineTask>                  deadlines;      // min heap
+    std::vector<ThreadTask>                    batch;          // batch[batchHead, batchCount) not run yet
+    size_t                                     batchHead  = 0;
+    size_t                                     batchCount = 0;
+    TaskClock::duration                        starvationLimit;
+    TaskClock::time_point                      waitingSince;   // when we first saw this level non-empty
+    bool                                       waiting = false;
+
+    // Bound (see KThread::setQueueLimit()) + overflow counters (bumped by posting threads).
+    QueueLimit                                 limit;
+    atomic<uint64_t>                           overflows { 0 }, blocked { 0 }, dropped { 0 }, rejected { 0 }, coalesced { 0 };
+
+    // OverflowPolicy::COALESCE: latest task per key; a queued trampoline per key runs it.
+    std::mutex                                 keyedMutex;
+    std::unordered_map<CoalesceKey, ThreadTask> keyed;
+
+    bool hasWork () const {
+        return batchHead != batchCount || !deadlines.empty() || pending.load(std::memory_order_relaxed) > 0;
+    }
+};
+
+// Timer add / cancel (task empty => cancel), applied by the owning thread.
+struct TimerRequest {
+    TimerId               id = 0;
+    TaskClock::time_point deadline;
+    TaskClock::duration   period {};
+    ThreadTask            task;
+};
+
+// Producer tokens for one posting thread (one per queue).
+struct TaskProducerTokens {
+    std::vector<moodycamel::ProducerToken> tasks, deadlineTasks;
+
+    TaskProducerTokens (TaskLevel* levels) {
+        tasks.reserve(TASK_PRIORITY_COUNT);
+        deadlineTasks.reserve(TASK_PRIORITY_COUNT);
+        for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
+            tasks.emplace_back(levels[i].tasks);
+            deadlineTasks.emplace_back(levels[i].deadlineTasks);
+        }
+    }
+};
+
+class KThreadImpl {
 public:
     friend class KThread;
 
-    ThreadWorkerImpl (KThread& thread, IThreadWorker* worker) : worker(worker) {}
-    ~ThreadWorkerImpl () {}
+    KThreadImpl (IThreadWorker* worker) : worker(worker) {
+        setBatchSize(DEFAULT_TASK_BATCH_SIZE);
+        for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i)
+            levels[i].starvationLimit = DEFAULT_STARVATION_LIMITS[i];
+    }
+    ~KThreadImpl () {}
+
+    void run (KThread& thread);
+    void setBatchSize (size_t size) {
+        for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
+            // Background tasks run one at a time, so they never hold up newly posted work.
+            levels[i].batch.resize(i == (size_t)TaskPriority::BACKGROUND || !size ? 1 : size);
+        }
+    }
+    TaskProducerTokens& producerTokens ();
+
+    template <typename F>
+    PostStatus post (TaskPriority priority, int64_t count, const F& enqueue) {
+        auto& level  = levels[(size_t)priority];
+        auto  status = level.limit.capacity ? admit(level, count, level.limit.policy) : PostStatus::POSTED;
+        if (status != PostStatus::REJECTED)
+            push(level, count, count, enqueue);
+        return status;
+    }
+    // droppable: how many of the count tasks DROP_OLDEST may drop (all but resumes).
+    template <typename F>
+    void push (TaskLevel& level, int64_t count, int64_t droppable, const F& enqueue) {
+        enqueue(level, producerTokens());
+        if (droppable)
+            level.droppable.fetch_add(droppable, std::memory_order_relaxed);
+        level.pending.fetch_add(count, std::memory_order_release);
+        idle.wake();
+    }
+    PostStatus admit (TaskLevel& level, int64_t count, OverflowPolicy policy);
+    PostStatus postKeyed (TaskPriority priority, CoalesceKey key, ThreadTask&& task);
+    void       runKeyed (TaskLevel& level, CoalesceKey key);
+
+    TimerId postTimer (TimerRequest&& request) {
+        auto id = request.id;
+        timerRequests.enqueue(std::move(request));
+        pendingTimerRequests.fetch_add(1, std::memory_order_release);
+        idle.wake();
+        return id;
+    }
+    void   runTimers (KThread& thread);
+    bool   runSlack (KThread& thread);
+    bool   hasOtherWork (TaskClock::time_point now) const;
+
+    // Owning thread: fn(JobScheduler&) on the attached scheduler; false if there is none.
+    // setJobScheduler() (from another thread) waits for this to return.
+    template <typename F>
+    bool withScheduler (const F& fn) const {
+        bool outer = helping.exchange(true);    // seq_cst: pairs w/ setJobScheduler()
+        auto jobs  = scheduler.load();
+        bool result = jobs && fn(*jobs);
+        helping.store(outer, std::memory_order_release);
+        return result;
+    }
+
+    size_t pickLevel ();
+    bool   hasPriorityWork (size_t level) const;
+    void   runLevel (KThread& thread, size_t level);
+    void   runTask (KThread& thread, ThreadTask& task);
+
+    std::unique_ptr<IThreadWorker>          worker;
+    TaskLevel                               levels[TASK_PRIORITY_COUNT];
+    atomic<bool>                            running { false };
+    atomic<JobScheduler*>                   scheduler { nullptr };  // stealable jobs to help with
+    mutable atomic<bool>                    helping { false };      // owning thread is using scheduler
+    IdleStrategy                            idle;
+
+    // Timers: requests from any thread, applied to the wheel by the owning thread.
+    moodycamel::ConcurrentQueue<TimerRequest> timerRequests;
+    atomic<int64_t>                         pendingTimerRequests { 0 };
+    atomic<TimerId>                         nextTimerId { 1 };
+    TimerWheel                              timers;
+    TaskClock::time_point                   nextTimer = TaskClock::time_point::max();
+
+    // Slack tasks: posted from any thread, moved to slackQueue (front runs next) by the owning thread.
+    moodycamel::ConcurrentQueue<ThreadTask> slackPosted;
+    atomic<int64_t>                         pendingSlack { 0 };
+    std::deque<ThreadTask>                  slackQueue;
+    atomic<TaskClock::rep>                  frameDeadline { 0 };    // time_since_epoch(); 0 => none
+    TaskClock::rep                          skippedDeadline = 0;
+    SlackConfig                             slackConfig;
+    atomic<uint64_t>                        slackWindows { 0 }, slackRuns { 0 }, slackContinued { 0 }, slackSkipped { 0 };
+    atomic<TaskClock::rep>                  slackBusy { 0 };
 
-    void run ();
-protected:
-    std::unique_ptr<IThreadWorker> worker;
-    ConcurrentQueue<ThreadTask> tasks;
-    atomic<bool> running = false;
+    // Bumped by KThread::wake(); idle() returns once it changes (snapshot taken each loop).
+    atomic<uint64_t>                        wakeups { 0 };
+
+    // One set of producer tokens per posting thread (destroyed before the queues).
+    const uint64_t                          id = nextId++;
+    std::mutex                              tokenMutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<TaskProducerTokens>> tokens;
+
+    static atomic<uint64_t>                 nextId;
 };
+atomic<uint64_t> KThreadImpl::nextId { 1 };
+
+// Per-thread cache of producer tokens (direct mapped by KThreadImpl id; ids are never reused, so
+// entries for destroyed threads are just never hit again).
+struct ProducerTokenCacheEntry {
+    uint64_t            owner  = 0;
+    TaskProducerTokens* tokens = nullptr;
+};
+static thread_local ProducerTokenCacheEntry tlsTokenCache[TOKEN_CACHE_SIZE];
+
+// KThread running on this thread, if any (OverflowPolicy::BLOCK never blocks a thread on itself).
+static thread_local KThreadImpl* tlsCurrentThread = nullptr;
+
+// Budget of the slack task running on this thread; an expired budget (no thread) otherwise.
+static thread_local SlackBudget  tlsNoSlack;
+static thread_local SlackBudget* tlsSlackBudget = nullptr;
+
+SlackBudget& SlackBudget::current () {
+    return tlsSlackBudget ? *tlsSlackBudget : tlsNoSlack;
+}
+bool SlackBudget::expired () const {
+    if (!thread)
+        return true;
+    auto now = TaskClock::now();
+    return now >= until || thread->hasOtherWork(now);
+}
+
+TaskProducerTokens& KThreadImpl::producerTokens () {
+    auto& entry = tlsTokenCache[id % TOKEN_CACHE_SIZE];
+    if (entry.owner != id) {
+        std::lock_guard<std::mutex> lock(tokenMutex);
+        auto& threadTokens = tokens[std::this_thread::get_id()];
+        if (!threadTokens)
+            threadTokens.reset(new TaskProducerTokens(levels));
+        entry = { id, threadTokens.get() };
+    }
+    return *entry.tokens;
+}
 
 //
 // KThread methods
 //
 
 KThread::KThread (IThreadWorker* worker)
-    : impl(new ThreadWorkerImpl(*this, worker)) {}
+    : impl(new KThreadImpl(worker)) {}
+
+KThread::~KThread () {
+    setJobScheduler(nullptr);   // stop being woken by the scheduler
+}
+
+// Push task(s) to be run on thread
+PostStatus KThread::postTask (TaskPriority priority, ThreadTask&& task) {
+    return impl->post(priority, 1, [&task, priority](TaskLevel& level, TaskProducerTokens& tokens) {
+        level.tasks.enqueue(tokens.tasks[(size_t)priority], std::move(task));
+    });
+}
+PostStatus KThread::postTask (TaskPriority priority, TaskClock::time_point deadline, ThreadTask&& task) {
+    return impl->post(priority, 1, [&task, priority, deadline](TaskLevel& level, TaskProducerTokens& tokens) {
+        level.deadlineTasks.enqueue(tokens.deadlineTasks[(size_t)priority], DeadlineTask { deadline, std::move(task) });
+    });
+}
+void KThread::postResume (TaskPriority priority, ThreadTask&& task) {
+    auto& level = impl->levels[(size_t)priority];
+    if (level.limit.capacity)
+        impl->admit(level, 1, OverflowPolicy::BLOCK);
+    impl->push(level, 1, 0, [&task, priority](TaskLevel& level, TaskProducerTokens& tokens) {
+        level.deadlineTasks.enqueue(tokens.deadlineTasks[(size_t)priority], DeadlineTask { TaskClock::now(), std::move(task), true });
+    });
+}
+PostStatus KThread::postTask (TaskPriority priority, CoalesceKey key, ThreadTask&& task) {
+    if (impl->levels[(size_t)priority].limit.policy != OverflowPolicy::COALESCE)
+        return postTask(priority, std::move(task));
+    return impl->postKeyed(priority, key, std::move(task));
+}
+PostStatus KThread::postTasks (TaskPriority priority, ThreadTask* tasks, size_t count) {
+    if (!count) return PostStatus::POSTED;
+    return impl->post(priority, (int64_t)count, [tasks, count, priority](TaskLevel& level, TaskProducerTokens& tokens) {
+        level.tasks.enqueue_bulk(tokens.tasks[(size_t)priority], std::make_move_iterator(tasks), count);
+    });
+}
+
+TimerId KThread::postTaskAt (TaskClock::time_point time, ThreadTask&& task) {
+    return postPeriodic(time, TaskClock::duration::zero(), std::move(task));
+}
+TimerId KThread::postPeriodic (TaskClock::time_point first, TaskClock::duration period, ThreadTask&& task) {
+    TimerRequest request;
+    request.id       = impl->nextTimerId.fetch_add(1, std::memory_order_relaxed);
+    request.deadline = first;
+    request.period   = period;
+    request.task     = std::move(task);
+    return impl->postTimer(std::move(request));
+}
+void KThread::cancelTimer (TimerId id) {
+    TimerRequest request;
+    request.id = id;
+    impl->postTimer(std::move(request));
+}
 
-// Push task to be run on thread
-void KThread::postTask (ThreadTask& task) {
-    impl->emplace(std::move(task));
+void KThread::postSlackTask (ThreadTask&& task) {
+    impl->slackPosted.enqueue(std::move(task));
+    impl->pendingSlack.fetch_add(1, std::memory_order_release);
+    impl->idle.wake();
+}
+void KThread::setFrameDeadline (TaskClock::time_point deadline) {
+    impl->frameDeadline.store(deadline.time_since_epoch().count(), std::memory_order_release);
+    wake();
+}
+void KThread::setSlackConfig (const SlackConfig& config) {
+    impl->slackConfig = config;
+}
+SlackStats KThread::slackStats () const {
+    SlackStats stats;
+    stats.windows   = impl->slackWindows.load(std::memory_order_relaxed);
+    stats.runs      = impl->slackRuns.load(std::memory_order_relaxed);
+    stats.continued = impl->slackContinued.load(std::memory_order_relaxed);
+    stats.skipped   = impl->slackSkipped.load(std::memory_order_relaxed);
+    stats.busy      = TaskClock::duration(impl->slackBusy.load(std::memory_order_relaxed));
+    return stats;
+}
+
+void KThread::wake () {
+    impl->wakeups.fetch_add(1, std::memory_order_release);
+    impl->idle.wake();
+}
+
+void KThread::setTaskBatchSize (size_t batchSize) {
+    impl->setBatchSize(batchSize);
+}
+void KThread::setStarvationLimit (TaskPriority priority, std::chrono::microseconds limit) {
+    impl->levels[(size_t)priority].starvationLimit = limit;
+}
+
+void KThread::setJobScheduler (JobScheduler* scheduler) {
+    auto old = impl->scheduler.exchange(scheduler);
+    if (old == scheduler)
+        return;
+    if (old)
+        old->removeHelper(this);
+    if (tlsCurrentThread != impl.get()) {
+        // Wait out a job (or pendingJobs() check) that may still use the old scheduler.
+        while (impl->helping.load())
+            std::this_thread::yield();
+    }
+    if (scheduler)
+        scheduler->addHelper(this);     // woken when jobs are posted + all workers are busy
+}
+
+void KThread::setQueueLimit (TaskPriority priority, const QueueLimit& limit) {
+    impl->levels[(size_t)priority].limit = limit;
+}
+QueueStats KThread::queueStats (TaskPriority priority) const {
+    auto& level = impl->levels[(size_t)priority];
+    QueueStats stats;
+    stats.overflows = level.overflows.load(std::memory_order_relaxed);
+    stats.blocked   = level.blocked.load(std::memory_order_relaxed);
+    stats.dropped   = level.dropped.load(std::memory_order_relaxed);
+    stats.rejected  = level.rejected.load(std::memory_order_relaxed);
+    stats.coalesced = level.coalesced.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void KThread::setIdleConfig (const IdleConfig& config) {
+    impl->idle.configure(config);
+}
+IdleStats KThread::idleStats () const {
+    return impl->idle.stats();
 }
 
 // Get / set thread run state
@@ -39,6 +366,7 @@ bool KThread::isRunning () {
 }
 void KThread::setRunning (bool value) {
     impl->running = value;
+    impl->idle.wake();
 }
 
 // Helper functions that wrap worker + thread impl calls in exception wrappers
@@ -46,27 +374,27 @@ void KThread::setRunning (bool value) {
 //
 // Used to implement KThread::runMainLoop();
 
-static bool initThread (KThread& thread) {
+static bool initThread (KThread& thread, KThreadImpl& impl) {
     try {
-        impl->worker->onThreadInit(thread);
+        impl.worker->onThreadInit(thread);
         return true;
     } catch (const std::exception& e) {
-        impl->worker->onInternalException(thread, ThreadErrorLocation::USER_ON_THREAD_INIT, e);
+        impl.worker->onInternalException(thread, ThreadErrorLocation::USER_ON_THREAD_INIT, e);
         return false;
     }
 }
-static void exitThread (KThread& thread) {
+static void exitThread (KThread& thread, KThreadImpl& impl) {
     try {
-        impl->worker->onThreadExit(thread);
+        impl.worker->onThreadExit(thread);
     } catch (const std::exception& e) {
-        impl->worker->onInternalException(thread, ThreadErrorLocation::USER_ON_THREAD_EXIT, e);
+        impl.worker->onInternalException(thread, ThreadErrorLocation::USER_ON_THREAD_EXIT, e);
     }
 }
-static void runThreadMainLoop (KThread& thread) {
+static void runThreadMainLoop (KThread& thread, KThreadImpl& impl) {
     try {
-        impl->run(thread);
+        impl.run(thread);
     } catch (const std::exception& e) {
-        impl->worker->onInternalException(thread, ThreadErrorLocation::INTERNAL_MAIN_LOOP, e);
+        impl.worker->onInternalException(thread, ThreadErrorLocation::INTERNAL_MAIN_LOOP, e);
     }
 }
 
@@ -75,16 +403,18 @@ static void runThreadMainLoop (KThread& thread) {
 // thread.hxx, and runs until Thread::isRunning() returns false.
 void KThread::runMainLoop () {
     if (impl->running)
-        throw new std::runtime_exception("Usage error: thread already running.");
+        throw std::runtime_error("Usage error: thread already running.");
     impl->running = true;
+    tlsCurrentThread = impl.get();
 
     // Try thread init, and if that fails, kill the thread.
     // And yes, ignore attempts to save it; IThreadWorker::onThreadInit() MUST succeed
     // or we're in a potentially invalid state.
-    if (!initThread(*this)) {
+    if (!initThread(*this, *impl)) {
         impl->running = false;
-        exitThread(*this);
+        exitThread(*this, *impl);
         impl->running = false;
+        tlsCurrentThread = nullptr;
         return;
     }
 
@@ -93,36 +423,347 @@ void KThread::runMainLoop () {
     // the thread main loop bailed, but we "reset" w/ thread.setRunning(true) inside of the
     // exception handler to prevent the thread from actually dying).
     while (impl->running)
-        runThreadMainLoop(*this);
+        runThreadMainLoop(*this, *impl);
 
     // Signal that our thread process just died.
-    exitThread(*this);
+    exitThread(*this, *impl);
+    tlsCurrentThread = nullptr;
+}
+
+// Is there work at a higher priority than level?
+bool KThreadImpl::hasPriorityWork (size_t level) const {
+    for (size_t i = 0; i < level; ++i)
+        if (levels[i].hasWork())
+            return true;
+    return false;
+}
+
+// Highest priority level w/ work, unless a lower level has been passed over for longer than its
+// starvation limit. Returns TASK_PRIORITY_COUNT if there is no work.
+size_t KThreadImpl::pickLevel () {
+    size_t                first = TASK_PRIORITY_COUNT;
+    TaskClock::time_point now;
+    for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
+        auto& level = levels[i];
+        if (!level.hasWork()) {
+            level.waiting = false;
+            continue;
+        }
+        if (first == TASK_PRIORITY_COUNT) {
+            first = i;
+            continue;
+        }
+        // Level i is being passed over: start / check its starvation timer.
+        if (now == TaskClock::time_point())
+            now = TaskClock::now();
+        if (!level.waiting) {
+            level.waiting      = true;
+            level.waitingSince = now;
+        } else if (now - level.waitingSince > level.starvationLimit) {
+            return i;
+        }
+    }
+    return first;
+}
+
+// Bounded level: make room for count tasks per policy (normally the level's OverflowPolicy), before
+// enqueueing them.
+PostStatus KThreadImpl::admit (TaskLevel& level, int64_t count, OverflowPolicy policy) {
+    auto capacity = (int64_t)level.limit.capacity;
+    auto full = [&level, count, capacity]() {
+        auto queued = level.pending.load(std::memory_order_acquire);
+        return queued > 0 && queued + count > capacity;     // oversized bulk posts fit an empty queue
+    };
+    if (!full())
+        return PostStatus::POSTED;
+    level.overflows.fetch_add(1, std::memory_order_relaxed);
+
+    switch (policy) {
+        case OverflowPolicy::BLOCK: {
+            if (tlsCurrentThread == this)
+                return PostStatus::POSTED;      // we'd wait for ourselves
+            level.blocked.fetch_add(1, std::memory_order_relaxed);
+            for (uint32_t attempt = 0; full() && running.load(std::memory_order_relaxed); ++attempt) {
+                if (attempt < 64) cpuRelax();
+                else              std::this_thread::yield();
+            }
+            return PostStatus::POSTED;
+        }
+        case OverflowPolicy::DROP_OLDEST: {
+            // Deadline tasks the thread already moved into its heap + resumes count as pending, but
+            // can't be dropped: if dropping everything else still leaves no room, reject the post
+            // (dropping would only lose tasks and overshoot the bound anyway).
+            auto fits = [&level, count, capacity]() {
+                auto kept = level.pending.load(std::memory_order_acquire) - std::max<int64_t>(level.droppable.load(std::memory_order_acquire), 0);
+                return kept <= 0 || kept + count <= capacity;
+            };
+            if (!fits()) {
+                level.rejected.fetch_add(1, std::memory_order_relaxed);
+                return PostStatus::REJECTED;
+            }
+            // Tasks are destroyed on the posting thread. Kept tasks (resumes) are queued again
+            // afterwards; deadline tasks run by deadline, so that doesn't reorder them.
+            static thread_local std::vector<DeadlineTask> kept;     // reused: overflows don't allocate
+            ThreadTask   task;
+            DeadlineTask deadlineTask;
+            uint64_t     dropped = 0;
+            while (full() && level.droppable.load(std::memory_order_acquire) > 0 &&
+                (level.tasks.try_dequeue(task) || level.deadlineTasks.try_dequeue(deadlineTask)))
+            {
+                if (deadlineTask.keep) {
+                    kept.push_back(std::move(deadlineTask));
+                    deadlineTask.keep = false;
+                    continue;
+                }
+                level.droppable.fetch_sub(1, std::memory_order_relaxed);
+                level.pending.fetch_sub(1, std::memory_order_relaxed);
+                ++dropped;
+            }
+            if (!kept.empty()) {
+                level.deadlineTasks.enqueue_bulk(producerTokens().deadlineTasks[(size_t)(&level - levels)],
+                    std::make_move_iterator(kept.begin()), kept.size());
+                kept.clear();
+            }
+            level.dropped.fetch_add(dropped, std::memory_order_relaxed);
+            if (full()) {
+                // Lost a race w/ the thread (it moved tasks into its heap meanwhile).
+                level.rejected.fetch_add(1, std::memory_order_relaxed);
+                return PostStatus::REJECTED;
+            }
+            return dropped ? PostStatus::DROPPED_OLDEST : PostStatus::POSTED;
+        }
+        default:
+            level.rejected.fetch_add(1, std::memory_order_relaxed);
+            return PostStatus::REJECTED;
+    }
+}
+
+// OverflowPolicy::COALESCE: replace the pending task for key, or queue a trampoline that runs it.
+PostStatus KThreadImpl::postKeyed (TaskPriority priority, CoalesceKey key, ThreadTask&& task) {
+    auto& level = levels[(size_t)priority];
+    std::lock_guard<std::mutex> lock(level.keyedMutex);
+    auto it = level.keyed.find(key);
+    if (it != level.keyed.end()) {
+        it->second = std::move(task);
+        level.coalesced.fetch_add(1, std::memory_order_relaxed);
+        return PostStatus::COALESCED;
+    }
+    if (level.limit.capacity && admit(level, 1, level.limit.policy) == PostStatus::REJECTED)
+        return PostStatus::REJECTED;
+
+    level.keyed.emplace(key, std::move(task));
+    TaskLevel* keyedLevel = &level;
+    push(level, 1, 1, [this, keyedLevel, key, priority](TaskLevel& level, TaskProducerTokens& tokens) {
+        level.tasks.enqueue(tokens.tasks[(size_t)priority], ThreadTask([this, keyedLevel, key]() {
+            runKeyed(*keyedLevel, key);
+        }));
+    });
+    return PostStatus::POSTED;
+}
+void KThreadImpl::runKeyed (TaskLevel& level, CoalesceKey key) {
+    ThreadTask task;
+    {
+        std::lock_guard<std::mutex> lock(level.keyedMutex);
+        auto it = level.keyed.find(key);
+        if (it == level.keyed.end())
+            return;
+        task = std::move(it->second);
+        level.keyed.erase(it);
+    }
+    task();
+}
+
+void KThreadImpl::runTask (KThread& thread, ThreadTask& task) {
+    try {
+        worker->runTask(thread, task);
+    } catch (const std::exception& e) {
+        if (!worker->onTaskException(task, e))
+            throw;
+    }
+}
+
+// Apply timer requests, then run due timers. Adds are applied before cancels, so a cancel that
+// overtakes its add (posted from different threads) still finds it.
+void KThreadImpl::runTimers (KThread& thread) {
+    if (pendingTimerRequests.load(std::memory_order_relaxed) > 0) {
+        TimerRequest request;
+        std::vector<TimerId> cancels;
+        while (timerRequests.try_dequeue(request)) {
+            pendingTimerRequests.fetch_sub(1, std::memory_order_relaxed);
+            if (request.task)
+                timers.add(request.id, request.deadline, request.period, std::move(request.task));
+            else
+                cancels.push_back(request.id);
+        }
+        for (auto id : cancels)
+            timers.cancel(id);
+        nextTimer = timers.nextDeadline();
+    }
+    if (nextTimer != TaskClock::time_point::max()) {
+        auto now = TaskClock::now();
+        if (now >= nextTimer) {
+            try {
+                timers.runDue(now, [this, &thread](ThreadTask& task) { runTask(thread, task); });
+            } catch (...) {
+                nextTimer = timers.nextDeadline();
+                throw;
+            }
+            nextTimer = timers.nextDeadline();
+        }
+    }
+}
+
+// Owning thread: anything to do besides slack tasks (incl. stealable jobs we could help with)?
+bool KThreadImpl::hasOtherWork (TaskClock::time_point now) const {
+    for (auto& level : levels)
+        if (level.hasWork())
+            return true;
+    if (now >= nextTimer || pendingTimerRequests.load(std::memory_order_relaxed) > 0 || !running)
+        return true;
+    return withScheduler([](JobScheduler& jobs) { return jobs.pendingJobs(JobFilter::NO_BACKGROUND) > 0; });
+}
+
+// Run slack tasks (in order) until the slack window closes: maxSlice from now, but no later than
+// the frame deadline minus reserve, or the next timer. Returns false if nothing ran.
+bool KThreadImpl::runSlack (KThread& thread) {
+    ThreadTask posted;
+    while (slackPosted.try_dequeue(posted)) {
+        pendingSlack.fetch_sub(1, std::memory_order_relaxed);
+        slackQueue.push_back(std::move(posted));
+    }
+    if (slackQueue.empty())
+        return false;
+
+    auto now      = TaskClock::now();
+    auto end      = std::min(now + slackConfig.maxSlice, nextTimer);
+    auto deadline = frameDeadline.load(std::memory_order_acquire);
+    if (deadline)
+        end = std::min(end, TaskClock::time_point(TaskClock::duration(deadline)) - slackConfig.reserve);
+    if (end - now < slackConfig.minSlice) {
+        if (deadline != skippedDeadline) {
+            skippedDeadline = deadline;     // count once per frame
+            slackSkipped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    SlackBudget budget;
+    budget.thread = this;
+    budget.until  = end;
+    struct Scope {
+        Scope  (SlackBudget* budget) { tlsSlackBudget = budget; }
+        ~Scope () { tlsSlackBudget = nullptr; }
+    } scope (&budget);
+
+    slackWindows.fetch_add(1, std::memory_order_relaxed);
+    while (!slackQueue.empty()) {
+        ThreadTask task = std::move(slackQueue.front());
+        slackQueue.pop_front();
+        budget.again = false;
+
+        auto start = TaskClock::now();
+        runTask(thread, task);
+        slackRuns.fetch_add(1, std::memory_order_relaxed);
+        slackBusy.fetch_add((TaskClock::now() - start).count(), std::memory_order_relaxed);
+
+        if (budget.again) {
+            slackContinued.fetch_add(1, std::memory_order_relaxed);
+            slackQueue.push_front(std::move(task));
+            break;
+        }
+        if (budget.expired())
+            break;
+    }
+    return true;
+}
+
+// Run the earliest deadline task, or a batch of tasks, from one level.
+void KThreadImpl::runLevel (KThread& thread, size_t index) {
+    auto& level = levels[index];
+    level.waiting = false;
+
+    // Move newly posted deadline tasks into the (consumer side) heap. They stay pending until they
+    // run, so a bounded level's limit covers the heap too.
+    DeadlineTask posted;
+    while (level.deadlineTasks.try_dequeue(posted)) {
+        if (!posted.keep)
+            level.droppable.fetch_sub(1, std::memory_order_relaxed);
+        level.deadlines.push_back(std::move(posted));
+        std::push_heap(level.deadlines.begin(), level.deadlines.end());
+    }
+    if (!level.deadlines.empty()) {
+        std::pop_heap(level.deadlines.begin(), level.deadlines.end());
+        ThreadTask task = std::move(level.deadlines.back().task);
+        level.deadlines.pop_back();
+        level.pending.fetch_sub(1, std::memory_order_relaxed);
+        runTask(thread, task);
+        return;
+    }
+
+    if (level.batchHead == level.batchCount) {
+        level.batchHead  = 0;
+        level.batchCount = level.tasks.try_dequeue_bulk(level.consumerToken, level.batch.begin(), level.batch.size());
+        level.droppable.fetch_sub((int64_t)level.batchCount, std::memory_order_relaxed);
+        level.pending.fetch_sub((int64_t)level.batchCount, std::memory_order_relaxed);
+    }
+
+    // The batch cursor is advanced before running each task, so if onTaskException() rethrows, the
+    // remaining tasks still run when the main loop restarts. Stop early if higher priority work
+    // shows up; the rest of the batch runs when this level is picked again.
+    while (level.batchHead != level.batchCount && running) {
+        ThreadTask task = std::move(level.batch[level.batchHead++]);
+        runTask(thread, task);
+        if (index != 0 && hasPriorityWork(index))
+            break;
+    }
 }
 
 // Actual implementation for the thread main loop. Called via
 //  KThread::runMainLoop() -> runThreadMainLoop() -> KThreadImpl::run()
 void KThreadImpl::run (KThread& thread) {
-    ThreadTask task;
-
     // Run tasks until we're signaled to stop.
     while (running) {
-        if (!tasks.try_dequeue(task)) {
-            // Dequeue failed -- call onThreadTaskAwait
-            try {
-                worker->onAwaitTasks(thread); 
-            } catch (const std::exception& e) {
-                if (!worker->onInternalException(thread, ThreadErrorLocation::USER_ON_AWAIT_TASKS), e)
-                    throw e;
-            }
+        auto seenWakeups = wakeups.load(std::memory_order_acquire);
+        runTimers(thread);
+
+        auto level = pickLevel();
+        if (level != TASK_PRIORITY_COUNT) {
+            idle.reset();
+            runLevel(thread, level);
+            continue;
+        }
+
+        // No tasks -- help w/ a stealable job if we can, else run slack tasks if there's time
+        // before the frame deadline, otherwise call onAwaitTasks
+        if (withScheduler([](JobScheduler& jobs) { return jobs.runOne(JobFilter::NO_BACKGROUND); })) {
+            idle.reset();
+            continue;
+        }
+        if (runSlack(thread)) {
+            idle.reset();
             continue;
-        } else {
-            // Dequeue succeeded -- call runTask / onTaskException
-            try {
-                worker->runTask(thread, task);
-            } catch (const std::exception& e) {
-                if (!worker->onTaskException(thread, task))
-                    throw e;
-            }
         }
+        try {
+            worker->onAwaitTasks(thread);
+        } catch (const std::exception& e) {
+            if (!worker->onInternalException(thread, ThreadErrorLocation::USER_ON_AWAIT_TASKS, e))
+                throw;
+        }
+        // ...then spin / yield / park until a task (or slack task) gets posted, the next timer is
+        // due, wake() (incl. a new frame deadline), or a stealable job is posted (the scheduler
+        // wakes helpers when its workers are busy)
+        idle.idle([this, seenWakeups]() {
+            for (auto& level : levels)
+                if (level.pending.load(std::memory_order_relaxed) > 0)
+                    return true;
+            return pendingTimerRequests.load(std::memory_order_relaxed) > 0
+                || pendingSlack.load(std::memory_order_relaxed) > 0
+                || wakeups.load(std::memory_order_relaxed) != seenWakeups
+                || withScheduler([](JobScheduler& jobs) { return jobs.pendingJobs(JobFilter::NO_BACKGROUND) > 0; })
+                || !running;
+        }, nextTimer);
     }
 }
+
+}; // namespace thread
+}; // namespace k
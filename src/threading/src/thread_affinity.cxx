@@ -0,0 +1,226 @@
+#include "../include/thread_affinity.hxx"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace k {
+namespace thread {
+
+static const std::string SYS_CPU_PATH = "/sys/devices/system/cpu/";
+static const CpuSet      NO_CPUS;
+
+CpuSet parseCpuList (const std::string& list) {
+    CpuSet cpus;
+    std::stringstream ss (list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+        if (range.empty())
+            continue;
+        char* end = nullptr;
+        long first = std::strtol(range.c_str(), &end, 10), last = first;
+        if (end == range.c_str() || first < 0)
+            return CpuSet();
+        if (*end == '-') {
+            const char* next = end + 1;
+            last = std::strtol(next, &end, 10);
+            if (end == next || last < first)
+                return CpuSet();
+        }
+        if (*end != '\0')
+            return CpuSet();
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+static bool readLine (const std::string& path, std::string& line) {
+    std::ifstream file (path);
+    return file && std::getline(file, line);
+}
+
+// Index of set in sets (added if new).
+static int indexOf (std::vector<CpuSet>& sets, const CpuSet& set) {
+    auto it = std::find(sets.begin(), sets.end(), set);
+    if (it != sets.end())
+        return (int)(it - sets.begin());
+    sets.push_back(set);
+    return (int)sets.size() - 1;
+}
+
+static CpuSet intersect (const CpuSet& a, const CpuSet& b) {
+    CpuSet result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+// Cpus this process may run on (sched_getaffinity: taskset, container cpusets); empty if unknown.
+static CpuSet allowedCpus () {
+    CpuSet cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+    }
+#endif
+    return cpus;
+}
+
+CpuTopology CpuTopology::detect () {
+    CpuTopology topology;
+    std::string line;
+    CpuSet online, allowed = allowedCpus();
+    if (readLine(SYS_CPU_PATH + "online", line))
+        online = parseCpuList(line);
+    if (!allowed.empty())
+        online = online.empty() ? allowed : intersect(online, allowed);
+
+    // Cores / L3 domains only list allowed cpus, so nothing gets planned (or pinned) outside them.
+    auto restrict = [&](CpuSet set, int id) {
+        if (!allowed.empty())
+            set = intersect(set, allowed);
+        return set.empty() ? CpuSet { id } : set;
+    };
+
+    for (auto id : online) {
+        auto base = SYS_CPU_PATH + "cpu" + std::to_string(id) + "/";
+        Cpu cpu;
+        cpu.id = id;
+
+        CpuSet siblings { id };
+        if (readLine(base + "topology/thread_siblings_list", line) || readLine(base + "topology/core_cpus_list", line))
+            siblings = parseCpuList(line);
+        siblings = restrict(siblings, id);
+        cpu.core = indexOf(topology.cores, siblings);
+
+        // L3: the cache index w/ level 3 (fall back to the package, then the core).
+        CpuSet domain;
+        for (int index = 0; index < 8 && domain.empty(); ++index) {
+            auto cache = base + "cache/index" + std::to_string(index) + "/";
+            if (readLine(cache + "level", line) && line == "3" && readLine(cache + "shared_cpu_list", line))
+                domain = parseCpuList(line);
+        }
+        if (domain.empty() && readLine(base + "topology/package_cpus_list", line))
+            domain = parseCpuList(line);
+        domain = domain.empty() ? siblings : restrict(domain, id);
+        cpu.l3 = indexOf(topology.l3Domains, domain);
+
+        topology.cpus.push_back(cpu);
+    }
+
+    if (topology.cpus.empty()) {
+        auto count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i) {
+            Cpu cpu;
+            cpu.id = (int)i;
+            cpu.core = cpu.l3 = (int)i;
+            topology.cpus.push_back(cpu);
+            topology.cores.push_back({ (int)i });
+            topology.l3Domains.push_back({ (int)i });
+        }
+    }
+    return topology;
+}
+
+bool AffinityConfig::parsePins (const std::string& pins) {
+    std::stringstream ss (pins);
+    std::string entry;
+    while (std::getline(ss, entry, ';')) {
+        if (entry.empty())
+            continue;
+        auto eq = entry.find('=');
+        if (eq == std::string::npos || eq == 0)
+            return false;
+        auto cpus = parseCpuList(entry.substr(eq + 1));
+        if (cpus.empty())
+            return false;
+        pin[entry.substr(0, eq)] = cpus;
+    }
+    return true;
+}
+
+static CpuSet without (const CpuSet& set, const CpuSet& excluded) {
+    CpuSet result;
+    std::set_difference(set.begin(), set.end(), excluded.begin(), excluded.end(), std::back_inserter(result));
+    return result;
+}
+static CpuSet allCpus (const CpuTopology& topology) {
+    CpuSet cpus;
+    for (auto& cpu : topology.cpus)
+        cpus.push_back(cpu.id);
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+AffinityPlan::AffinityPlan (const CpuTopology& topology, const AffinityConfig& config, size_t workerCount) {
+    if (config.mode == AffinityConfig::Mode::AUTO && topology.cores.size() > 1) {
+        // main + gl: the first two physical cores (in the same L3 domain if possible; they share
+        // command buffers).
+        auto& mainCore = topology.cores[0];
+        const CpuSet* glCore = &topology.cores[1];
+        int mainL3 = topology.cpus[0].l3;
+        for (auto& cpu : topology.cpus) {
+            if (cpu.core != 0 && cpu.l3 == mainL3) {
+                glCore = &topology.cores[cpu.core];
+                break;
+            }
+        }
+        sets["main"] = mainCore;
+        sets["gl"]   = *glCore;
+
+        CpuSet reserved;
+        std::set_union(mainCore.begin(), mainCore.end(), glCore->begin(), glCore->end(), std::back_inserter(reserved));
+        sets["window"] = without(allCpus(topology), *glCore);
+
+        // Workers: round robin across L3 domains, each pinned to its domain (minus main / gl,
+        // unless that leaves nothing).
+        for (size_t i = 0; i < workerCount; ++i) {
+            auto& domain = topology.l3Domains[i % topology.l3Domains.size()];
+            auto  cpus   = without(domain, reserved);
+            sets["worker." + std::to_string(i)] = cpus.empty() ? domain : cpus;
+        }
+    }
+    for (auto& pin : config.pin)
+        sets[pin.first] = pin.second;
+}
+
+const CpuSet& AffinityPlan::cpusFor (const std::string& name) const {
+    auto it = sets.find(name);
+    return it != sets.end() ? it->second : NO_CPUS;
+}
+
+#if defined(__linux__)
+static bool setAffinity (pthread_t thread, const CpuSet& cpus) {
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+bool setThreadAffinity (std::thread& thread, const CpuSet& cpus) {
+    return setAffinity(thread.native_handle(), cpus);
+}
+bool setCurrentThreadAffinity (const CpuSet& cpus) {
+    return setAffinity(pthread_self(), cpus);
+}
+#else
+bool setThreadAffinity (std::thread&, const CpuSet&) { return false; }
+bool setCurrentThreadAffinity (const CpuSet&) { return false; }
+#endif
+
+}; // namespace thread
+}; // namespace k
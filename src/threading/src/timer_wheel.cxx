@@ -0,0 +1,215 @@
+#include "../include/timer_wheel.hxx"
+#include <limits>
+
+namespace k {
+namespace thread {
+
+static constexpr uint64_t SLOT_MASK      = TimerWheel::SLOT_COUNT - 1;
+static constexpr uint64_t MAX_TICK_DELTA = ((uint64_t)1 << (TimerWheel::SLOT_BITS * TimerWheel::LEVEL_COUNT)) - 1;
+
+// Index of the first set bit in bits at / after start, wrapping around; bits must be non-zero.
+static uint32_t firstSlotFrom (uint64_t bits, uint32_t start) {
+    uint64_t ahead = bits >> start;
+    if (ahead)
+        return start + (uint32_t)__builtin_ctzll(ahead);
+    return (uint32_t)__builtin_ctzll(bits);
+}
+
+TimerWheel::TimerWheel (TaskClock::duration resolution, TaskClock::time_point origin)
+    : resolution(resolution.count() > 0 ? resolution : TaskClock::duration(1)), origin(origin)
+{
+    for (auto& level : heads)
+        for (auto& head : level)
+            head = NONE;
+}
+
+uint64_t TimerWheel::tickOf (TaskClock::time_point time) const {
+    return time > origin ? (uint64_t)((time - origin) / resolution) : 0;
+}
+
+void TimerWheel::add (TimerId id, TaskClock::time_point deadline, TaskClock::duration period, ThreadTask&& task) {
+    uint32_t index;
+    if (!freeTimers.empty()) {
+        index = freeTimers.back();
+        freeTimers.pop_back();
+    } else {
+        index = (uint32_t)timers.size();
+        timers.emplace_back();
+    }
+    auto& timer = timers[index];
+    timer.id       = id;
+    timer.deadline = deadline;
+    timer.period   = period.count() > 0 ? period : TaskClock::duration::zero();
+    timer.task     = std::move(task);
+    ids[id] = index;
+    insert(index);
+}
+
+// Place a timer by its deadline, relative to currentTick (overdue timers go straight to due).
+void TimerWheel::insert (uint32_t index) {
+    auto& timer = timers[index];
+    auto  tick  = tickOf(timer.deadline);
+    if (tick < currentTick) {
+        timer.state = TimerState::DUE;
+        due.push_back({ timer.deadline, index });
+        std::push_heap(due.begin(), due.end());
+        return;
+    }
+    auto delta = std::min(tick - currentTick, MAX_TICK_DELTA);
+    tick = currentTick + delta;
+
+    uint32_t level = 0;
+    while (level + 1 < LEVEL_COUNT && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+        ++level;
+    auto slot = (uint32_t)((tick >> (SLOT_BITS * level)) & SLOT_MASK);
+
+    timer.state = TimerState::WHEEL;
+    timer.level = (uint8_t)level;
+    timer.slot  = (uint8_t)slot;
+    timer.prev  = NONE;
+    timer.next  = heads[level][slot];
+    if (timer.next != NONE)
+        timers[timer.next].prev = index;
+    heads[level][slot] = index;
+    occupied[level] |= (uint64_t)1 << slot;
+}
+
+void TimerWheel::unlink (uint32_t index) {
+    auto& timer = timers[index];
+    if (timer.prev != NONE) timers[timer.prev].next = timer.next;
+    else                    heads[timer.level][timer.slot] = timer.next;
+    if (timer.next != NONE) timers[timer.next].prev = timer.prev;
+    if (heads[timer.level][timer.slot] == NONE)
+        occupied[timer.level] &= ~((uint64_t)1 << timer.slot);
+}
+
+void TimerWheel::release (uint32_t index) {
+    auto& timer = timers[index];
+    timer.task.reset();
+    timer.state = TimerState::FREE;
+    freeTimers.push_back(index);
+}
+
+bool TimerWheel::cancel (TimerId id) {
+    auto it = ids.find(id);
+    if (it == ids.end())
+        return false;
+    auto index = it->second;
+    ids.erase(it);
+
+    auto& timer = timers[index];
+    switch (timer.state) {
+        case TimerState::WHEEL:
+            unlink(index);
+            release(index);
+            break;
+        case TimerState::DUE:
+            // Still in the due heap: dropped (+ released) when popped.
+            timer.state = TimerState::CANCELLED;
+            timer.task.reset();
+            break;
+        case TimerState::RUNNING:
+            timer.state = TimerState::CANCELLED;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Re-insert a higher level slot's timers (one level down, or further).
+void TimerWheel::cascade (uint32_t level, uint32_t slot) {
+    auto index = heads[level][slot];
+    heads[level][slot] = NONE;
+    occupied[level] &= ~((uint64_t)1 << slot);
+    while (index != NONE) {
+        auto next = timers[index].next;
+        insert(index);
+        index = next;
+    }
+}
+
+// Level 0 slot reached: its timers are due this tick (clamped far timers get re-inserted).
+void TimerWheel::expire (uint32_t slot) {
+    auto index = heads[0][slot];
+    heads[0][slot] = NONE;
+    occupied[0] &= ~((uint64_t)1 << slot);
+    while (index != NONE) {
+        auto& timer = timers[index];
+        auto  next  = timer.next;
+        if (tickOf(timer.deadline) > currentTick) {
+            insert(index);
+        } else {
+            timer.state = TimerState::DUE;
+            due.push_back({ timer.deadline, index });
+            std::push_heap(due.begin(), due.end());
+        }
+        index = next;
+    }
+}
+
+// Process ticks [currentTick, tick].
+void TimerWheel::advance (uint64_t tick) {
+    while (currentTick <= tick) {
+        auto index = (uint32_t)(currentTick & SLOT_MASK);
+        if (index == 0) {
+            for (uint32_t level = 1; level < LEVEL_COUNT; ++level) {
+                auto slot = (uint32_t)((currentTick >> (SLOT_BITS * level)) & SLOT_MASK);
+                if (occupied[level] & ((uint64_t)1 << slot))
+                    cascade(level, slot);
+                if (slot != 0)
+                    break;
+            }
+        }
+        if (occupied[0] & ((uint64_t)1 << index))
+            expire(index);
+
+        // Skip to the next occupied level 0 slot this round, or the next round.
+        uint64_t ahead = index == SLOT_MASK ? 0 : occupied[0] >> (index + 1);
+        uint64_t next  = ahead ? currentTick + 1 + (uint64_t)__builtin_ctzll(ahead) : (currentTick | SLOT_MASK) + 1;
+        currentTick = std::min(next, tick + 1);
+    }
+}
+
+void TimerWheel::reschedule (uint32_t index, TaskClock::time_point now) {
+    auto& timer = timers[index];
+    if (timer.state == TimerState::CANCELLED || timer.period == TaskClock::duration::zero()) {
+        if (timer.state != TimerState::CANCELLED)
+            ids.erase(timer.id);
+        release(index);
+        return;
+    }
+    timer.deadline += timer.period;
+    if (timer.deadline <= now)
+        timer.deadline += timer.period * ((now - timer.deadline) / timer.period + 1);
+    insert(index);
+}
+
+TaskClock::time_point TimerWheel::nextDeadline () const {
+    auto next = due.empty() ? TaskClock::time_point::max() : due.front().deadline;
+
+    uint64_t tick = std::numeric_limits<uint64_t>::max();
+    if (occupied[0]) {
+        auto index = (uint32_t)(currentTick & SLOT_MASK);
+        auto slot  = firstSlotFrom(occupied[0], index);
+        tick = slot >= index ? currentTick + (slot - index) : (currentTick | SLOT_MASK) + 1 + slot;
+    }
+    // Higher levels: when the first occupied slot cascades (the level below wraps to it).
+    for (uint32_t level = 1; level < LEVEL_COUNT; ++level) {
+        if (!occupied[level])
+            continue;
+        auto shift   = SLOT_BITS * level;
+        auto aligned = (currentTick & (((uint64_t)1 << shift) - 1)) == 0;
+        auto start   = (currentTick >> shift) + (aligned ? 0 : 1);
+        auto first   = (uint32_t)(start & SLOT_MASK);
+        auto slot    = firstSlotFrom(occupied[level], first);
+        auto cascade = (start + ((slot - first) & SLOT_MASK)) << shift;
+        tick = std::min(tick, cascade);
+    }
+    if (tick != std::numeric_limits<uint64_t>::max())
+        next = std::min(next, origin + resolution * (int64_t)tick);
+    return next;
+}
+
+}; // namespace thread
+}; // namespace k
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "channel.hxx"
+
+using namespace k::thread;
+
+TEST(Channel, CapacityRoundsUpToPowerOf2) {
+    Channel<int> channel (5);
+    EXPECT_EQ(channel.capacity(), 8u);
+}
+
+TEST(Channel, TrySendFailsWhenFull) {
+    Channel<int> channel (4);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_TRUE(channel.trySend(i));
+    EXPECT_FALSE(channel.trySend(4));
+    EXPECT_EQ(channel.size(), 4u);
+
+    int value = -1;
+    ASSERT_TRUE(channel.tryReceive(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(channel.trySend(4));
+    EXPECT_FALSE(channel.trySend(5));
+}
+
+TEST(Channel, WrapsAround) {
+    // Many laps around a small ring, w/ the ring partly full, keep FIFO order.
+    Channel<int> channel (4);
+    int next = 0, expected = 0;
+    for (int lap = 0; lap < 100; ++lap) {
+        while (channel.trySend(next))
+            ++next;
+        int out[3];
+        auto count = channel.tryReceive(out, 3);
+        ASSERT_EQ(count, 3u);
+        for (size_t i = 0; i < count; ++i)
+            EXPECT_EQ(out[i], expected++);
+    }
+    channel.drain([&](int&& value) { EXPECT_EQ(value, expected++); });
+    EXPECT_EQ(expected, next);
+    EXPECT_TRUE(channel.empty());
+}
+
+TEST(Channel, DestroysUnreceivedMessages) {
+    auto shared = std::make_shared<int>(1);
+    {
+        Channel<std::shared_ptr<int>> channel (4);
+        channel.send(shared);
+        channel.send(shared);
+        EXPECT_EQ(shared.use_count(), 3);
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(Channel, BlockingSendWaitsForReceiver) {
+    static constexpr int SENDERS = 4, COUNT = 10000;
+    Channel<int> channel (8);
+    std::vector<std::thread> senders;
+    for (int s = 0; s < SENDERS; ++s) {
+        senders.emplace_back([&channel, s]() {
+            for (int i = 0; i < COUNT; ++i)
+                channel.send(s * COUNT + i);
+        });
+    }
+    // Per sender order is kept.
+    std::vector<int> last (SENDERS, -1);
+    int received = 0;
+    while (received < SENDERS * COUNT) {
+        if (!channel.wait(std::chrono::microseconds(1000)))
+            continue;
+        received += (int)channel.drain([&](int&& value) {
+            auto sender = value / COUNT;
+            EXPECT_GT(value % COUNT, last[sender]);
+            last[sender] = value % COUNT;
+        });
+    }
+    for (auto& sender : senders)
+        sender.join();
+    EXPECT_TRUE(channel.empty());
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <time.h>
+#endif
+#include "frame_graph.hxx"
+#include "job_scheduler.hxx"
+
+using namespace k::thread;
+
+// Records the order nodes ran in.
+struct RunLog {
+    std::mutex       mutex;
+    std::vector<int> order;
+
+    std::function<void()> node (int id) {
+        return [this, id]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(id);
+        };
+    }
+    size_t position (int id) const {
+        for (size_t i = 0; i < order.size(); ++i)
+            if (order[i] == id)
+                return i;
+        return order.size();
+    }
+};
+
+TEST(FrameGraph, ReadersRunAfterWriter) {
+    JobScheduler jobs (4);
+    for (int run = 0; run < 50; ++run) {
+        FrameGraph graph;
+        RunLog log;
+        auto writer = graph.addNode("writer", log.node(0));
+        auto a      = graph.addNode("a", log.node(1));
+        auto b      = graph.addNode("b", log.node(2));
+        auto next   = graph.addNode("next writer", log.node(3));
+        graph.writes(writer, "input");
+        graph.reads(a, "input");
+        graph.reads(b, "input");
+        graph.writes(next, "input");
+        graph.execute(&jobs);
+
+        ASSERT_EQ(log.order.size(), 4u);
+        EXPECT_LT(log.position(0), log.position(1));
+        EXPECT_LT(log.position(0), log.position(2));
+        EXPECT_LT(log.position(1), log.position(3));
+        EXPECT_LT(log.position(2), log.position(3));
+        EXPECT_EQ(graph.stats().nodes, 4u);
+    }
+}
+
+TEST(FrameGraph, BarrierOrdersAgainstEverything) {
+    JobScheduler jobs (4);
+    for (int run = 0; run < 50; ++run) {
+        FrameGraph graph;
+        RunLog log;
+        auto a       = graph.addNode("a", log.node(0));
+        auto b       = graph.addNode("b", log.node(1));
+        auto barrier = graph.addNode("barrier", log.node(2));
+        auto c       = graph.addNode("c", log.node(3));
+        graph.writes(a, "x");
+        graph.writes(b, "y");
+        graph.barrier(barrier);
+        graph.reads(c, "z");
+        graph.execute(&jobs);
+
+        ASSERT_EQ(log.order.size(), 4u);
+        EXPECT_EQ(log.position(2), 2u);
+        EXPECT_EQ(log.position(3), 3u);
+    }
+}
+
+TEST(FrameGraph, DisabledNodesAreSkipped) {
+    FrameGraph graph;
+    RunLog log;
+    auto a = graph.addNode("a", log.node(0));
+    auto b = graph.addNode("b", log.node(1));
+    graph.writes(a, "x");
+    graph.reads(b, "x");
+    graph.setEnabled(a, false);
+    graph.execute(nullptr);
+    EXPECT_EQ(log.order, (std::vector<int> { 1 }));
+}
+
+TEST(FrameGraph, RethrowsNodeException) {
+    JobScheduler jobs (2);
+    FrameGraph graph;
+    std::atomic<int> ran { 0 };
+    graph.addNode("throws", []() { throw std::runtime_error("node"); });
+    graph.addNode("runs", [&]() { ran.fetch_add(1); });
+    EXPECT_THROW(graph.execute(&jobs), std::runtime_error);
+    EXPECT_EQ(ran.load(), 1);
+}
+
+TEST(FrameGraph, RebuildsAfterDeclarationsChange) {
+    FrameGraph graph;
+    RunLog log;
+    auto a = graph.addNode("a", log.node(0));
+    graph.execute(nullptr);
+    auto builds = graph.stats().builds;
+    graph.execute(nullptr);
+    EXPECT_EQ(graph.stats().builds, builds);
+
+    graph.writes(a, "x");
+    graph.execute(nullptr);
+    EXPECT_EQ(graph.stats().builds, builds + 1);
+    graph.removeNode(a);
+    EXPECT_EQ(graph.nodeCount(), 0u);
+}
+
+TEST(FrameGraph, CriticalPathFollowsLongestChain) {
+    FrameGraph graph;
+    auto sleep = [](int ms) { return [ms]() { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }; };
+    auto a = graph.addNode("a", sleep(1));
+    auto b = graph.addNode("b", sleep(20));
+    auto c = graph.addNode("c", sleep(1));
+    graph.writes(a, "x");
+    graph.reads (b, "x");
+    graph.reads (c, "x");
+
+    JobScheduler jobs (2);
+    for (int frame = 0; frame < 2; ++frame) {   // stats storage is reused
+        graph.execute(&jobs);
+        EXPECT_EQ(graph.stats().criticalNodes, std::vector<uint32_t>({ a, b }));
+        EXPECT_GE(graph.stats().criticalPath, std::chrono::milliseconds(21));
+    }
+}
+
+#if defined(__linux__)
+TEST(FrameGraph, ExecuteParksInsteadOfSpinning) {
+    FrameGraph graph;
+    graph.addNode("slow", []() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+    JobScheduler jobs (1);
+
+    auto cpuTime = []() {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+    };
+    auto start = cpuTime();
+    graph.execute(&jobs);
+    EXPECT_LT(cpuTime() - start, std::chrono::milliseconds(50));
+}
+#endif
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "future.hxx"
+#include "job_scheduler.hxx"
+
+using namespace k::thread;
+
+// No blocking wait on futures: spin until ready.
+template <typename T>
+static void waitReady (const Future<T>& future) {
+    while (!future.ready())
+        std::this_thread::yield();
+}
+
+TEST(Future, PromiseValueRunsContinuation) {
+    Promise<int> promise;
+    auto future = promise.getFuture().then([](int value) { return std::to_string(value * 2); });
+    EXPECT_FALSE(future.ready());
+    EXPECT_TRUE(promise.setValue(21));
+    ASSERT_TRUE(future.ready());
+    EXPECT_EQ(future.get(), "42");
+}
+
+TEST(Future, GetBeforeReadyThrows) {
+    Promise<int> promise;
+    auto future = promise.getFuture();
+    EXPECT_THROW(future.get(), std::logic_error);
+}
+
+TEST(Future, ExceptionSkipsContinuations) {
+    Promise<int> promise;
+    bool ran = false;
+    auto future = promise.getFuture()
+        .then([&](int value) { ran = true; return value; })
+        .then([&](int value) { ran = true; return value; });
+    promise.setException(std::make_exception_ptr(std::runtime_error("boom")));
+    ASSERT_TRUE(future.ready());
+    EXPECT_FALSE(ran);
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(Future, ContinuationExceptionPropagates) {
+    Promise<void> promise;
+    auto future = promise.getFuture()
+        .then([]() -> int { throw std::runtime_error("boom"); })
+        .then([](int value) { return value + 1; });
+    promise.setValue();
+    ASSERT_TRUE(future.ready());
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(Future, CancelSkipsTaskAndContinuations) {
+    JobScheduler jobs (1);
+    std::atomic<bool> gate { false }, ran { false };
+
+    // Block the only worker, so the cancelled task can't have started.
+    auto blocker = postTask(jobs, [&]() { while (!gate.load()) std::this_thread::yield(); });
+    auto future  = postTask(jobs, [&]() { ran = true; return 1; });
+    future.cancel();
+    EXPECT_TRUE(future.cancelled());
+    EXPECT_THROW(future.get(), FutureCancelled);
+    gate = true;
+    waitReady(blocker);
+    while (jobs.pendingJobs())
+        std::this_thread::yield();
+    EXPECT_FALSE(ran.load());
+}
+
+TEST(Future, CancelPropagatesDownTheChain) {
+    Promise<int> promise;
+    bool ran = false;
+    auto source = promise.getFuture();
+    source.cancel();
+    auto future = std::move(source).then([&](int value) { ran = true; return value; });
+    ASSERT_TRUE(future.ready());
+    EXPECT_TRUE(future.cancelled());
+    EXPECT_FALSE(ran);
+    EXPECT_FALSE(promise.setValue(1));
+}
+
+TEST(Future, DroppedPromiseCancels) {
+    Future<int> future;
+    {
+        Promise<int> promise;
+        future = promise.getFuture();
+    }
+    ASSERT_TRUE(future.ready());
+    EXPECT_THROW(future.get(), FutureCancelled);
+}
+
+TEST(Future, WhenAllCollectsInOrder) {
+    JobScheduler jobs (2);
+    std::vector<Future<int>> futures;
+    for (int i = 0; i < 16; ++i)
+        futures.push_back(postTask(jobs, [i]() { return i * i; }));
+    auto all = whenAll(std::move(futures));
+    waitReady(all);
+    auto values = all.get();
+    ASSERT_EQ(values.size(), 16u);
+    for (int i = 0; i < 16; ++i)
+        EXPECT_EQ(values[i], i * i);
+}
+
+TEST(Future, WhenAllEmpty) {
+    auto all = whenAll(std::vector<Future<int>>());
+    ASSERT_TRUE(all.ready());
+    EXPECT_TRUE(all.get().empty());
+}
+
+TEST(Future, WhenAllFailsWithFirstException) {
+    std::vector<Promise<void>> promises (3);
+    std::vector<Future<void>> futures;
+    for (auto& promise : promises)
+        futures.push_back(promise.getFuture());
+    auto all = whenAll(std::move(futures));
+
+    promises[2].setException(std::make_exception_ptr(std::logic_error("second")));
+    promises[0].setValue();
+    EXPECT_FALSE(all.ready());
+    promises[1].setException(std::make_exception_ptr(std::runtime_error("first")));
+    ASSERT_TRUE(all.ready());
+    EXPECT_THROW(all.get(), std::runtime_error);
+}
+
+TEST(Future, WhenAllCancelledIfAnyInputIs) {
+    std::vector<Promise<int>> promises (2);
+    std::vector<Future<int>> futures;
+    for (auto& promise : promises)
+        futures.push_back(promise.getFuture());
+    auto all = whenAll(std::move(futures));
+    promises[0].setValue(1);
+    promises[1].cancel();
+    ASSERT_TRUE(all.ready());
+    EXPECT_THROW(all.get(), FutureCancelled);
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "job_scheduler.hxx"
+
+using namespace k::thread;
+
+static void waitFor (const std::atomic<int>& counter, int value) {
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (counter.load() < value && std::chrono::steady_clock::now() < timeout)
+        std::this_thread::yield();
+}
+
+TEST(JobScheduler, RunsAllJobs) {
+    std::atomic<int> count { 0 };
+    {
+        JobScheduler jobs (4);
+        for (int i = 0; i < 10000; ++i)
+            jobs.post([&]() { count.fetch_add(1); });
+        waitFor(count, 10000);
+        EXPECT_EQ(count.load(), 10000);
+    }
+    EXPECT_EQ(count.load(), 10000);
+}
+
+TEST(JobScheduler, NestedJobsRunFromWorkers) {
+    std::atomic<int> count { 0 };
+    JobScheduler jobs (3);
+    for (int i = 0; i < 100; ++i) {
+        jobs.post([&]() {
+            for (int j = 0; j < 100; ++j)
+                jobs.post([&]() { count.fetch_add(1); });
+        });
+    }
+    waitFor(count, 100 * 100);
+    EXPECT_EQ(count.load(), 100 * 100);
+}
+
+TEST(JobScheduler, RunOneHelpsFromOtherThreads) {
+    std::atomic<int> count { 0 };
+    JobScheduler jobs (1);
+    std::atomic<bool> gate { false };
+    std::atomic<int>  blocked { 0 };
+    jobs.post([&]() {
+        blocked = 1;
+        while (!gate.load()) std::this_thread::yield();
+    });
+    waitFor(blocked, 1);     // the worker is stuck: only this thread can run the rest
+    for (int i = 0; i < 100; ++i)
+        jobs.post([&]() { count.fetch_add(1); });
+    while (count.load() < 100)
+        jobs.runOne();
+    gate = true;
+    EXPECT_EQ(count.load(), 100);
+}
+
+TEST(JobScheduler, HelpersSkipBackgroundJobs) {
+    JobScheduler jobs (1);
+    std::atomic<bool> gate { false };
+    std::atomic<int>  blocked { 0 }, background { 0 }, normal { 0 };
+    jobs.post([&]() {
+        blocked = 1;
+        while (!gate.load()) std::this_thread::yield();
+    });
+    waitFor(blocked, 1);
+    jobs.post([&]() { background.fetch_add(1); }, TaskPriority::BACKGROUND);
+    jobs.post([&]() { normal.fetch_add(1); });
+    EXPECT_EQ(jobs.pendingJobs(), 2u);
+    EXPECT_EQ(jobs.pendingJobs(JobFilter::NO_BACKGROUND), 1u);
+
+    EXPECT_TRUE(jobs.runOne(JobFilter::NO_BACKGROUND));
+    EXPECT_FALSE(jobs.runOne(JobFilter::NO_BACKGROUND));    // only the background job is left
+    EXPECT_EQ(normal.load(), 1);
+    EXPECT_EQ(background.load(), 0);
+    EXPECT_EQ(jobs.pendingJobs(JobFilter::NO_BACKGROUND), 0u);
+
+    gate = true;        // the worker takes it
+    waitFor(background, 1);
+}
+
+TEST(JobScheduler, ShrinkAndRegrowLoseNoJobs) {
+    static constexpr int JOBS = 20000;
+    std::atomic<int> count { 0 };
+    JobScheduler jobs (4, 8);
+    EXPECT_EQ(jobs.maxWorkerCount(), 8u);
+
+    // Jobs that post more jobs (to worker deques) while the pool resizes under them.
+    std::thread poster ([&]() {
+        for (int i = 0; i < JOBS / 4; ++i) {
+            jobs.post([&]() {
+                count.fetch_add(1);
+                for (int j = 0; j < 3; ++j)
+                    jobs.post([&]() { count.fetch_add(1); });
+            });
+        }
+    });
+    size_t sizes[] = { 1, 8, 2, 6, 1, 4, 8, 1 };
+    for (int round = 0; round < 4; ++round) {
+        for (auto size : sizes) {
+            jobs.setWorkerCount(size);
+            EXPECT_EQ(jobs.workerCount(), size);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    poster.join();
+    waitFor(count, JOBS);
+    EXPECT_EQ(count.load(), JOBS);
+    EXPECT_EQ(jobs.pendingJobs(), 0u);
+}
+
+TEST(JobScheduler, AutoScaleBacksOffWhileOverloaded) {
+    std::atomic<double> load { 0 };
+    auto hardwareThreads = (double)std::max(1u, std::thread::hardware_concurrency());
+    JobScheduler jobs (6, 8);
+
+    AutoScaleConfig config;
+    config.minWorkers         = 2;
+    config.sampleInterval     = std::chrono::milliseconds(1);
+    config.samplesPerDecision = 2;
+    config.shrinkAfter        = ~0u;    // idle workers never shrink the pool here
+    config.backoffAfter       = 2;
+    config.loadAverage        = [&load]() { return load.load(); };
+    jobs.enableAutoScale(config);
+
+    // Not overloaded: nothing changes.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(jobs.workerCount(), 6u);
+
+    // Other processes keep the box busy: shrink to (not below) minWorkers.
+    load = 100 * hardwareThreads;
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (jobs.workerCount() > 2 && std::chrono::steady_clock::now() < timeout)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(jobs.workerCount(), 2u);
+    jobs.disableAutoScale();
+}
+
+TEST(JobScheduler, WorkerCountIsClamped) {
+    JobScheduler jobs (2, 4);
+    jobs.setWorkerCount(0);
+    EXPECT_EQ(jobs.workerCount(), 1u);
+    jobs.setWorkerCount(100);
+    EXPECT_EQ(jobs.workerCount(), 4u);
+}
+
+TEST(JobScheduler, SetWorkerCountFromWorkerThrows) {
+    JobScheduler jobs (1);
+    std::atomic<int> done { 0 };
+    jobs.post([&]() {
+        EXPECT_THROW(jobs.setWorkerCount(2), std::logic_error);
+        done = 1;
+    });
+    waitFor(done, 1);
+    EXPECT_EQ(done.load(), 1);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "job_scheduler.hxx"
+#include "parallel.hxx"
+
+using namespace k::thread;
+
+TEST(Parallel, ForVisitsEveryIndexOnce) {
+    JobScheduler jobs (4);
+    for (size_t grain : { 0, 1, 7, 1000 }) {
+        std::vector<std::atomic<int>> visits (10007);
+        parallel_for(&jobs, { 0, visits.size() }, grain, [&](size_t i) { visits[i].fetch_add(1); });
+        for (size_t i = 0; i < visits.size(); ++i)
+            ASSERT_EQ(visits[i].load(), 1) << "grain " << grain << ", index " << i;
+    }
+}
+
+TEST(Parallel, ForRethrows) {
+    JobScheduler jobs (2);
+    EXPECT_THROW(parallel_for(&jobs, { 0, 100000 }, 16, [](size_t i) {
+        if (i == 5000) throw std::runtime_error("item");
+    }), std::runtime_error);
+}
+
+TEST(Parallel, ReduceMatchesSerial) {
+    JobScheduler jobs (4);
+    std::vector<uint64_t> values (1 << 20);
+    std::iota(values.begin(), values.end(), 0);
+    auto sum = parallel_reduce(&jobs, { 0, values.size() }, 0, (uint64_t)0,
+        [&](size_t i) { return values[i]; },
+        [](uint64_t a, uint64_t b) { return a + b; });
+    EXPECT_EQ(sum, std::accumulate(values.begin(), values.end(), (uint64_t)0));
+}
+
+TEST(Parallel, SortMatchesStdSort) {
+    JobScheduler jobs (4);
+    std::mt19937 rng (7);
+    for (size_t count : { 100, 4097, 100000, 1 << 20 }) {
+        std::vector<uint32_t> keys (count);
+        for (auto& key : keys)
+            key = (uint32_t)rng() % 1000;    // lots of duplicates
+        auto expected = keys;
+        std::sort(expected.begin(), expected.end());
+        parallel_sort(&jobs, keys.begin(), keys.end());
+        ASSERT_EQ(keys, expected) << count << " keys";
+    }
+}
+
+TEST(Parallel, SortWithComparatorAndMoveOnlyValues) {
+    JobScheduler jobs (3);
+    std::vector<std::unique_ptr<int>> values;
+    for (int i = 0; i < 50000; ++i)
+        values.emplace_back(new int((i * 7919) % 50000));
+    parallel_sort(&jobs, values.begin(), values.end(),
+        [](const std::unique_ptr<int>& a, const std::unique_ptr<int>& b) { return *a > *b; });
+    for (int i = 0; i < 50000; ++i)
+        ASSERT_EQ(*values[i], 49999 - i);
+}
+
+TEST(Parallel, SerialWithoutScheduler) {
+    std::vector<int> keys { 5, 3, 9, 1 };
+    parallel_sort(nullptr, keys.begin(), keys.end());
+    EXPECT_EQ(keys, (std::vector<int> { 1, 3, 5, 9 }));
+    int count = 0;
+    parallel_for(nullptr, { 0, 10 }, 0, [&](size_t) { ++count; });
+    EXPECT_EQ(count, 10);
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "coroutine_task.hxx"
+#include "job_scheduler.hxx"
+#include "thread.hxx"
+
+using namespace k::thread;
+
+struct TestWorker : public IThreadWorker {
+    bool onTaskException (ThreadTask&, const std::exception&) override { return true; }
+    bool onInternalException (KThread&, ThreadErrorLocation, const std::exception&) override { return true; }
+};
+
+// KThread running on its own std::thread; stopped + joined on destruction.
+struct TestThread {
+    KThread     thread { new TestWorker() };    // owns its worker
+    std::thread runner;
+
+    TestThread () {
+        runner = std::thread([this]() { thread.runMainLoop(); });
+        while (!thread.isRunning())
+            std::this_thread::yield();
+    }
+    ~TestThread () {
+        thread.setRunning(false);
+        runner.join();
+    }
+};
+
+template <typename F>
+static bool waitUntil (const F& done) {
+    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!done() && std::chrono::steady_clock::now() < timeout)
+        std::this_thread::yield();
+    return done();
+}
+
+static Task<void> count (std::atomic<int>& done) {
+    done.fetch_add(1);
+    co_return;
+}
+
+TEST(KThread, RunsPostedTasksInOrder) {
+    TestThread t;
+    std::vector<int> order;
+    std::atomic<int> ran { 0 };
+    for (int i = 0; i < 100; ++i)
+        t.thread.postTask([&, i]() { order.push_back(i); ran.fetch_add(1); });
+    ASSERT_TRUE(waitUntil([&]() { return ran.load() == 100; }));
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(order[i], i);
+}
+
+TEST(KThread, DropOldestNeverDropsResumes) {
+    TestThread t;
+    t.thread.setQueueLimit(TaskPriority::NORMAL, { 2, OverflowPolicy::DROP_OLDEST });
+    std::atomic<bool> gate { false }, blocked { false };
+    std::atomic<int>  resumed { 0 }, ran { 0 };
+    t.thread.postTask(TaskPriority::REALTIME, [&]() {
+        blocked = true;
+        while (!gate.load()) std::this_thread::yield();
+    });
+    ASSERT_TRUE(waitUntil([&]() { return blocked.load(); }));
+
+    // The queue is full of resumes; dropping can't make room, so plain posts are rejected.
+    spawn(TaskExecutor(t.thread), count(resumed));
+    spawn(TaskExecutor(t.thread), count(resumed));
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(t.thread.postTask([&]() { ran.fetch_add(1); }), PostStatus::REJECTED);
+    gate = true;
+
+    ASSERT_TRUE(waitUntil([&]() { return resumed.load() == 2; }));
+    auto stats = t.thread.queueStats(TaskPriority::NORMAL);
+    EXPECT_EQ(stats.dropped, 0u);
+    EXPECT_EQ(stats.rejected, 4u);
+    EXPECT_EQ(ran.load(), 0);
+}
+
+TEST(KThread, DropOldestRejectsWhenDeadlineHeapHoldsCapacity) {
+    TestThread t;
+    t.thread.setQueueLimit(TaskPriority::NORMAL, { 3, OverflowPolicy::DROP_OLDEST });
+    std::atomic<bool> gate { false }, heapGate { false }, blocked { false }, held { false };
+    std::atomic<int>  ran { 0 };
+    t.thread.postTask(TaskPriority::REALTIME, [&]() {
+        blocked = true;
+        while (!gate.load()) std::this_thread::yield();
+    });
+    ASSERT_TRUE(waitUntil([&]() { return blocked.load(); }));
+
+    // The thread takes all three deadline tasks into its heap, then blocks in the first one: the
+    // other two fill the level, but posters can't drop them.
+    auto now = TaskClock::now();
+    t.thread.postTask(TaskPriority::NORMAL, now, [&]() {
+        held = true;
+        while (!heapGate.load()) std::this_thread::yield();
+    });
+    t.thread.postTask(TaskPriority::NORMAL, now + std::chrono::hours(1), [&]() { ran.fetch_add(1); });
+    t.thread.postTask(TaskPriority::NORMAL, now + std::chrono::hours(1), [&]() { ran.fetch_add(1); });
+    gate = true;
+    ASSERT_TRUE(waitUntil([&]() { return held.load(); }));
+
+    EXPECT_EQ(t.thread.postTask([&]() { ran.fetch_add(1); }), PostStatus::POSTED);
+    EXPECT_EQ(t.thread.postTask([&]() { ran.fetch_add(1); }), PostStatus::DROPPED_OLDEST);
+    ThreadTask bulk[2] = { [&]() { ran.fetch_add(1); }, [&]() { ran.fetch_add(1); } };
+    EXPECT_EQ(t.thread.postTasks(bulk), PostStatus::REJECTED);      // dropping the one plain task isn't enough
+
+    auto stats = t.thread.queueStats(TaskPriority::NORMAL);
+    EXPECT_EQ(stats.dropped, 1u);
+    EXPECT_EQ(stats.rejected, 1u);
+
+    heapGate = true;
+    ASSERT_TRUE(waitUntil([&]() { return ran.load() == 3; }));
+}
+
+TEST(KThread, RejectBlocksResumesInsteadOfDroppingThem) {
+    TestThread t;
+    t.thread.setQueueLimit(TaskPriority::NORMAL, { 1, OverflowPolicy::REJECT });
+    std::atomic<bool> gate { false }, blocked { false };
+    std::atomic<int>  resumed { 0 };
+    t.thread.postTask(TaskPriority::REALTIME, [&]() {
+        blocked = true;
+        while (!gate.load()) std::this_thread::yield();
+    });
+    ASSERT_TRUE(waitUntil([&]() { return blocked.load(); }));
+    EXPECT_EQ(t.thread.postTask([]() {}), PostStatus::POSTED);
+    EXPECT_EQ(t.thread.postTask([]() {}), PostStatus::REJECTED);
+
+    std::thread spawner ([&]() { spawn(TaskExecutor(t.thread), count(resumed)); });     // waits for room
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(resumed.load(), 0);
+    gate = true;
+    spawner.join();
+    ASSERT_TRUE(waitUntil([&]() { return resumed.load() == 1; }));
+}
+
+TEST(KThread, QueueLimitCoversDeadlineTasks) {
+    // Deadline tasks wait in a heap on the thread; they count against the limit until they run.
+    static constexpr size_t CAPACITY = 4;
+    TestThread t;
+    t.thread.setQueueLimit(TaskPriority::NORMAL, { CAPACITY, OverflowPolicy::REJECT });
+    std::atomic<int> posted { 0 }, ran { 0 };
+    int maxQueued = 0;
+    for (int i = 0; i < 200; ++i) {
+        auto status = t.thread.postTask(TaskPriority::NORMAL, TaskClock::now(), [&]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            ran.fetch_add(1);
+        });
+        if (status == PostStatus::POSTED)
+            posted.fetch_add(1);
+        maxQueued = std::max(maxQueued, posted.load() - ran.load());
+    }
+    EXPECT_LE(maxQueued, (int)CAPACITY + 1);    // + the one running
+    EXPECT_GT(t.thread.queueStats(TaskPriority::NORMAL).rejected, 0u);
+    ASSERT_TRUE(waitUntil([&]() { return ran.load() == posted.load(); }));
+}
+
+TEST(KThread, SlackBudgetExpiresOnPendingJobs) {
+    JobScheduler jobs (1);
+    std::atomic<bool> gate { false }, blocked { false }, expired { false }, helped { false };
+    jobs.post([&]() {                           // keep the only worker busy
+        blocked = true;
+        while (!gate.load()) std::this_thread::yield();
+    });
+    ASSERT_TRUE(waitUntil([&]() { return blocked.load(); }));
+
+    TestThread t;
+    t.thread.setJobScheduler(&jobs);
+    t.thread.postSlackTask([&]() {
+        jobs.post([&]() { helped = true; });    // only this thread can take it
+        expired = SlackBudget::current().expired();
+    });
+    ASSERT_TRUE(waitUntil([&]() { return helped.load(); }));
+    EXPECT_TRUE(expired.load());
+
+    gate = true;
+    t.thread.setJobScheduler(nullptr);
+}
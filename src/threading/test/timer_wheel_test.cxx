@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "timer_wheel.hxx"
+
+using namespace k::thread;
+using std::chrono::milliseconds;
+
+// Wheels run on a fixed origin, so tests control time exactly (1ms ticks).
+static const TaskClock::time_point ORIGIN = TaskClock::now();
+
+TEST(TimerWheel, RunsTimersInDeadlineOrder) {
+    TimerWheel wheel (milliseconds(1), ORIGIN);
+    std::vector<int> fired;
+    wheel.add(1, ORIGIN + milliseconds(30), {}, [&]() { fired.push_back(1); });
+    wheel.add(2, ORIGIN + milliseconds(10), {}, [&]() { fired.push_back(2); });
+    wheel.add(3, ORIGIN + milliseconds(20), {}, [&]() { fired.push_back(3); });
+
+    wheel.runDue(ORIGIN + milliseconds(9));
+    EXPECT_TRUE(fired.empty());
+    wheel.runDue(ORIGIN + milliseconds(30));
+    EXPECT_EQ(fired, (std::vector<int> { 2, 3, 1 }));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, CascadesFromHigherLevels) {
+    // Past level 0 (64 ticks) + level 1 (4096 ticks): must cascade down twice to fire on time.
+    TimerWheel wheel (milliseconds(1), ORIGIN);
+    int fired = 0;
+    wheel.add(1, ORIGIN + milliseconds(5000), {}, [&]() { ++fired; });
+    wheel.add(2, ORIGIN + milliseconds(100),  {}, [&]() { ++fired; });
+
+    for (int ms = 0; ms < 5000; ms += 7) {
+        wheel.runDue(ORIGIN + milliseconds(ms));
+        EXPECT_EQ(fired, ms >= 100 ? 1 : 0) << "at " << ms << "ms";
+    }
+    wheel.runDue(ORIGIN + milliseconds(4999));
+    EXPECT_EQ(fired, 1);
+    wheel.runDue(ORIGIN + milliseconds(5000));
+    EXPECT_EQ(fired, 2);
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, CascadesAcrossSkippedTime) {
+    // One big jump over several level 1 + 2 slots fires everything due, in order.
+    TimerWheel wheel (milliseconds(1), ORIGIN);
+    std::vector<int> fired;
+    for (int i = 0; i < 10; ++i)
+        wheel.add(i, ORIGIN + milliseconds(1000 * (10 - i)), {}, [&fired, i]() { fired.push_back(i); });
+    wheel.runDue(ORIGIN + milliseconds(20000));
+    EXPECT_EQ(fired, (std::vector<int> { 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 }));
+}
+
+TEST(TimerWheel, NextDeadline) {
+    TimerWheel wheel (milliseconds(1), ORIGIN);
+    EXPECT_EQ(wheel.nextDeadline(), TaskClock::time_point::max());
+
+    wheel.add(1, ORIGIN + milliseconds(40), {}, []() {});
+    EXPECT_EQ(wheel.nextDeadline(), ORIGIN + milliseconds(40));
+    wheel.add(2, ORIGIN + milliseconds(12), {}, []() {});
+    EXPECT_EQ(wheel.nextDeadline(), ORIGIN + milliseconds(12));
+
+    // Far timers: never later than the deadline (the wheel may need to wake up to cascade).
+    TimerWheel far (milliseconds(1), ORIGIN);
+    far.add(1, ORIGIN + milliseconds(3000), {}, []() {});
+    auto next = far.nextDeadline();
+    EXPECT_LE(next, ORIGIN + milliseconds(3000));
+    EXPECT_GT(next, ORIGIN);
+
+    // Cancelling the earliest timer moves it on.
+    EXPECT_TRUE(wheel.cancel(2));
+    wheel.runDue(ORIGIN + milliseconds(13));
+    EXPECT_EQ(wheel.nextDeadline(), ORIGIN + milliseconds(40));
+    EXPECT_FALSE(wheel.cancel(2));
+}
+
+TEST(TimerWheel, PeriodicReschedule) {
+    TimerWheel wheel (milliseconds(1), ORIGIN);
+    int runs = 0;
+    wheel.add(1, ORIGIN + milliseconds(10), milliseconds(10), [&]() { ++runs; });
+
+    wheel.runDue(ORIGIN + milliseconds(10));
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(wheel.nextDeadline(), ORIGIN + milliseconds(20));
+    wheel.runDue(ORIGIN + milliseconds(20));
+    EXPECT_EQ(runs, 2);
+
+    // Fixed rate: missed periods are skipped (run once), not run back to back.
+    wheel.runDue(ORIGIN + milliseconds(55));
+    EXPECT_EQ(runs, 3);
+    EXPECT_EQ(wheel.nextDeadline(), ORIGIN + milliseconds(60));
+    EXPECT_EQ(wheel.size(), 1u);
+
+    EXPECT_TRUE(wheel.cancel(1));
+    wheel.runDue(ORIGIN + milliseconds(100));
+    EXPECT_EQ(runs, 3);
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, PeriodicTimerCancelsItself) {
+    TimerWheel wheel (milliseconds(1), ORIGIN);
+    int runs = 0;
+    wheel.add(7, ORIGIN + milliseconds(5), milliseconds(5), [&]() {
+        if (++runs == 3)
+            wheel.cancel(7);
+    });
+    for (int ms = 0; ms <= 50; ++ms)
+        wheel.runDue(ORIGIN + milliseconds(ms));
+    EXPECT_EQ(runs, 3);
+    EXPECT_TRUE(wheel.empty());
+}
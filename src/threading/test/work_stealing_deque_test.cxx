@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "work_stealing_deque.hxx"
+
+using namespace k::thread;
+
+TEST(WorkStealingDeque, OwnerIsLifoThievesAreFifo) {
+    WorkStealingDeque<int> deque (4);
+    for (int i = 0; i < 4; ++i)
+        deque.push(i);
+    int value = -1;
+    ASSERT_TRUE(deque.pop(value));
+    EXPECT_EQ(value, 3);
+    ASSERT_TRUE(deque.steal(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(deque.size(), 2u);
+}
+
+TEST(WorkStealingDeque, GrowsWhenFull) {
+    WorkStealingDeque<int> deque (2);
+    for (int i = 0; i < 1000; ++i)
+        deque.push(i);
+    EXPECT_EQ(deque.size(), 1000u);
+    int value = -1;
+    for (int i = 999; i >= 0; --i) {
+        ASSERT_TRUE(deque.pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(deque.pop(value));
+    EXPECT_TRUE(deque.empty());
+}
+
+TEST(WorkStealingDeque, EachValueTakenOnce) {
+    // Owner pushes + pops while thieves steal: every value comes out exactly once.
+    static constexpr int COUNT = 200000, THIEVES = 3;
+    WorkStealingDeque<int> deque (8);
+    std::vector<std::atomic<int>> taken (COUNT);
+    std::atomic<bool> done { false };
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < THIEVES; ++t) {
+        thieves.emplace_back([&]() {
+            int value;
+            while (!done.load() || !deque.empty()) {
+                if (deque.steal(value))
+                    taken[value].fetch_add(1);
+            }
+        });
+    }
+    int value;
+    for (int i = 0; i < COUNT; ++i) {
+        deque.push(i);
+        if (i % 3 == 0 && deque.pop(value))
+            taken[value].fetch_add(1);
+    }
+    while (deque.pop(value))
+        taken[value].fetch_add(1);
+    done = true;
+    for (auto& thief : thieves)
+        thief.join();
+    for (int i = 0; i < COUNT; ++i)
+        ASSERT_EQ(taken[i].load(), 1) << "value " << i;
+}
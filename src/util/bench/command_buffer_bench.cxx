@@ -0,0 +1,403 @@
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <hayai.hpp>
+#include <concurrentqueue.h>
+#include <readerwriterqueue.h>
+#include <boost/variant.hpp>
+#include "command_buffer.hxx"
+#include "command_stream.hxx"
+
+//
+// CommandBuffer / CommandStream vs the other queues used for cross-thread traffic in the tree:
+// – moodycamel::ConcurrentQueue<std::function<void()>>     (KThread task queue)
+// – moodycamel::ReaderWriterQueue<boost::variant<...>>     (WindowThread task queue)
+//
+// Payloads:
+// – Small      12 byte POD (fits in std::function's small buffer)
+// – Medium     128 byte POD
+// – Variable   id + 0..~250 byte string (inline record / captured std::string)
+//
+// Scenarios (each benchmark iteration moves COMMAND_COUNT commands; divide the iteration time by
+// COMMAND_COUNT for per-command cost):
+// – Local          write all, then read all, on one thread (raw transport overhead)
+// – OneToOne       1 producer thread -> 1 consumer thread
+// – ManyToOne      PRODUCER_COUNT producers -> 1 consumer (SPSC transports: one per producer)
+// – Broadcast      1 producer -> CONSUMER_COUNT consumers, each consumer sees every command
+// – Latency        single command round trips (ping-pong); iteration time / PING_COUNT / 2 is the
+//                  one-way latency
+//
+// Transports:
+// – Buffer         CommandBuffer frames (FRAME_SIZE commands) handed over by pointer; broadcast
+//                  shares one sealed frame between consumers (see CommandBuffer::seal())
+// – Stream         CommandStream (SPSC), flushed every FLUSH_INTERVAL commands
+// – FunctionQueue  ConcurrentQueue<std::function<void()>>
+// – VariantQueue   ReaderWriterQueue<boost::variant<Small, Medium, VariableString>>
+//
+// Threads are started per iteration; startup cost is the same for all transports.
+//
+
+static constexpr uint32_t COMMAND_COUNT  = 1 << 16;
+static constexpr uint32_t FRAME_SIZE     = 1024;
+static constexpr uint32_t FLUSH_INTERVAL = 64;
+static constexpr uint32_t PING_COUNT     = 1024;
+static constexpr size_t   PRODUCER_COUNT = 4;
+static constexpr size_t   CONSUMER_COUNT = 4;
+
+//
+// Payloads
+//
+
+enum class kBenchCmd { NONE = 0, SMALL, MEDIUM, VARIABLE, COUNT };
+
+struct Small {
+    uint32_t id;
+    float    x, y;
+};
+struct Medium {
+    uint32_t id;
+    float    values[31];
+};
+struct Variable {
+    uint32_t id;
+};
+struct VariableString {
+    uint32_t    id;
+    std::string text;
+};
+typedef boost::variant<Small, Medium, VariableString> BenchVariant;
+
+static const char TEXT[] = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod "
+    "tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation "
+    "ullamco laboris nisi ut aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit";
+static std::string_view textOf (uint32_t i) { return std::string_view(TEXT, ((i * 2654435761u) >> 24) % sizeof(TEXT)); }
+
+// Consumers fold payloads into a per-thread sink so reads can't be optimized out.
+static thread_local uint64_t tlsSink = 0;
+static std::atomic<uint64_t> sink { 0 };
+
+static void consume (const Small& v)  { tlsSink += v.id + (uint64_t)v.x; }
+static void consume (const Medium& v) { tlsSink += v.id + (uint64_t)v.values[30]; }
+static void consume (const Variable& v, std::string_view text) { tlsSink += v.id + text.size(); }
+static void consume (const VariableString& v) { tlsSink += v.id + v.text.size(); }
+static void flushSink () { sink.fetch_add(tlsSink, std::memory_order_relaxed); tlsSink = 0; }
+
+struct ConsumeVariant : public boost::static_visitor<void> {
+    template <typename T>
+    void operator() (const T& v) const { consume(v); }
+};
+
+typedef CommandBuffer<kBenchCmd> BenchBuffer;
+typedef CommandStream<kBenchCmd> BenchStream;
+
+// Read all (available) commands from a CommandBuffer / CommandStream; returns command count.
+template <typename Buffer>
+static size_t drain (Buffer& buffer) {
+    size_t count = 0;
+    for (kBenchCmd command; (command = buffer.readNext()) != kBenchCmd::NONE; ++count) {
+        switch (command) {
+            case kBenchCmd::SMALL:  consume(*buffer.template read<Small>()); break;
+            case kBenchCmd::MEDIUM: consume(*buffer.template read<Medium>()); break;
+            case kBenchCmd::VARIABLE: {
+                auto v = buffer.template read<Variable>();
+                consume(*v, buffer.readString());
+            } break;
+            default: assert(0 && "Unexpected command");
+        }
+    }
+    return count;
+}
+
+// Write / build the i-th command for each transport.
+struct SmallPayload {
+    static Small make (uint32_t i) { return { i, (float)i, 1.f }; }
+
+    template <typename Buffer>
+    static void write (Buffer& buffer, uint32_t i) { buffer.write(kBenchCmd::SMALL, make(i)); }
+    static std::function<void()> task (uint32_t i) { auto v = make(i); return [v]() { consume(v); }; }
+    static BenchVariant variant (uint32_t i) { return make(i); }
+};
+struct MediumPayload {
+    static Medium make (uint32_t i) {
+        Medium v;
+        v.id = i;
+        for (auto& x : v.values) x = (float)i;
+        return v;
+    }
+    template <typename Buffer>
+    static void write (Buffer& buffer, uint32_t i) { buffer.write(kBenchCmd::MEDIUM, make(i)); }
+    static std::function<void()> task (uint32_t i) { auto v = make(i); return [v]() { consume(v); }; }
+    static BenchVariant variant (uint32_t i) { return make(i); }
+};
+struct VariablePayload {
+    template <typename Buffer>
+    static void write (Buffer& buffer, uint32_t i) { buffer.writeString(kBenchCmd::VARIABLE, Variable { i }, textOf(i)); }
+    static std::function<void()> task (uint32_t i) {
+        VariableString v { i, std::string(textOf(i)) };
+        return [v]() { consume(v); };
+    }
+    static BenchVariant variant (uint32_t i) { return VariableString { i, std::string(textOf(i)) }; }
+};
+
+//
+// Transports. All SPSC except FunctionQueue (MPMC):
+//      push<Payload>(i)    producer: send command i
+//      finish()            producer: publish everything pushed so far
+//      poll()              consumer: execute available commands, returns count
+//
+
+class BufferTransport {
+    moodycamel::ReaderWriterQueue<std::unique_ptr<BenchBuffer>> frames;
+    std::unique_ptr<BenchBuffer> frame { new BenchBuffer() };
+    uint32_t                     frameSize = 0;
+public:
+    static constexpr bool SHARED = false;
+
+    template <typename Payload>
+    void push (uint32_t i) {
+        Payload::write(*frame, i);
+        if (++frameSize == FRAME_SIZE)
+            finish();
+    }
+    void finish () {
+        if (frameSize) {
+            frames.enqueue(std::move(frame));
+            frame.reset(new BenchBuffer());
+            frameSize = 0;
+        }
+    }
+    // Broadcast: write once, share the sealed frame w/ every consumer.
+    void publish (const BenchBuffer& sealed) {
+        frames.enqueue(std::unique_ptr<BenchBuffer>(new BenchBuffer(sealed)));
+    }
+    size_t poll () {
+        size_t count = 0;
+        std::unique_ptr<BenchBuffer> next;
+        while (frames.try_dequeue(next)) {
+            next->rewindReadHead();
+            count += drain(*next);
+        }
+        return count;
+    }
+};
+class StreamTransport {
+    BenchStream stream;
+    uint32_t    pending = 0;
+public:
+    static constexpr bool SHARED = false;
+
+    template <typename Payload>
+    void push (uint32_t i) {
+        Payload::write(stream, i);
+        if (++pending == FLUSH_INTERVAL)
+            finish();
+    }
+    void finish () { stream.flush(); pending = 0; }
+    size_t poll () { return drain(stream); }
+};
+class FunctionQueueTransport {
+    moodycamel::ConcurrentQueue<std::function<void()>> queue;
+public:
+    static constexpr bool SHARED = true;
+
+    template <typename Payload>
+    void push (uint32_t i) { queue.enqueue(Payload::task(i)); }
+    void finish () {}
+    size_t poll () {
+        size_t count = 0;
+        std::function<void()> task;
+        for (; queue.try_dequeue(task); ++count)
+            task();
+        return count;
+    }
+};
+class VariantQueueTransport {
+    moodycamel::ReaderWriterQueue<BenchVariant> queue;
+public:
+    static constexpr bool SHARED = false;
+
+    template <typename Payload>
+    void push (uint32_t i) { queue.enqueue(Payload::variant(i)); }
+    void finish () {}
+    size_t poll () {
+        size_t count = 0;
+        BenchVariant v;
+        for (; queue.try_dequeue(v); ++count)
+            boost::apply_visitor(ConsumeVariant(), v);
+        return count;
+    }
+};
+
+//
+// Scenarios
+//
+
+// Consumers yield when they find nothing, so oversubscribed machines don't measure spin time.
+template <typename Transport>
+static size_t pollOrYield (Transport& transport) {
+    size_t count = transport.poll();
+    if (!count)
+        std::this_thread::yield();
+    return count;
+}
+
+template <typename Transport, typename Payload>
+static void runLocal () {
+    Transport transport;
+    for (uint32_t i = 0; i < COMMAND_COUNT; ++i)
+        transport.template push<Payload>(i);
+    transport.finish();
+    size_t count = transport.poll();
+    assert(count == COMMAND_COUNT);
+    (void)count;
+    flushSink();
+}
+
+template <typename Transport, typename Payload>
+static void runOneToOne () {
+    Transport transport;
+    std::thread producer([&transport]() {
+        for (uint32_t i = 0; i < COMMAND_COUNT; ++i)
+            transport.template push<Payload>(i);
+        transport.finish();
+    });
+    for (size_t count = 0; count < COMMAND_COUNT; )
+        count += pollOrYield(transport);
+    producer.join();
+    flushSink();
+}
+
+template <typename Transport, typename Payload>
+static void runManyToOne () {
+    // SPSC transports get one instance per producer; the consumer polls them round robin.
+    std::vector<std::unique_ptr<Transport>> transports;
+    for (size_t i = 0; i < (Transport::SHARED ? 1 : PRODUCER_COUNT); ++i)
+        transports.emplace_back(new Transport());
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < PRODUCER_COUNT; ++p) {
+        auto& transport = *transports[Transport::SHARED ? 0 : p];
+        producers.emplace_back([&transport, p]() {
+            for (uint32_t i = (uint32_t)p; i < COMMAND_COUNT; i += PRODUCER_COUNT)
+                transport.template push<Payload>(i);
+            transport.finish();
+        });
+    }
+    for (size_t count = 0; count < COMMAND_COUNT; )
+        for (auto& transport : transports)
+            count += pollOrYield(*transport);
+    for (auto& producer : producers)
+        producer.join();
+    flushSink();
+}
+
+template <typename Transport, typename Payload>
+static void runBroadcast () {
+    std::vector<std::unique_ptr<Transport>> transports;
+    for (size_t i = 0; i < CONSUMER_COUNT; ++i)
+        transports.emplace_back(new Transport());
+
+    std::vector<std::thread> consumers;
+    for (auto& transport : transports) {
+        auto t = transport.get();
+        consumers.emplace_back([t]() {
+            for (size_t count = 0; count < COMMAND_COUNT; )
+                count += pollOrYield(*t);
+            flushSink();
+        });
+    }
+    if constexpr (std::is_same<Transport, BufferTransport>::value) {
+        // Write each frame once, then hand out O(1) sealed copies.
+        for (uint32_t i = 0; i < COMMAND_COUNT; ) {
+            BenchBuffer frame;
+            for (uint32_t end = std::min(i + FRAME_SIZE, COMMAND_COUNT); i < end; ++i)
+                Payload::write(frame, i);
+            frame.seal();
+            for (auto& transport : transports)
+                transport->publish(frame);
+        }
+    } else {
+        for (uint32_t i = 0; i < COMMAND_COUNT; ++i)
+            for (auto& transport : transports)
+                transport->template push<Payload>(i);
+        for (auto& transport : transports)
+            transport->finish();
+    }
+    for (auto& consumer : consumers)
+        consumer.join();
+}
+
+// Ping-pong: the consumer acks each command by bumping 'acked'; the producer waits for the ack
+// before sending the next one. Frame based CommandBuffer handoff is not latency oriented (a frame
+// per command), so it is not included here.
+template <typename Transport, typename Payload>
+static void runLatency () {
+    Transport             transport;
+    std::atomic<uint32_t> acked { 0 };
+    std::thread consumer([&transport, &acked]() {
+        for (uint32_t count = 0; count < PING_COUNT; ) {
+            if (size_t n = pollOrYield(transport)) {
+                count += (uint32_t)n;
+                acked.store(count, std::memory_order_release);
+            }
+        }
+        flushSink();
+    });
+    for (uint32_t i = 0; i < PING_COUNT; ++i) {
+        transport.template push<Payload>(i);
+        transport.finish();
+        while (acked.load(std::memory_order_acquire) != i + 1)
+            std::this_thread::yield();
+    }
+    consumer.join();
+}
+
+//
+// Benchmarks: <Scenario>.<Transport>_<Payload>
+//
+
+#define K_BENCH_PAYLOADS(Scenario, Name, runs, iterations) \
+    BENCHMARK(Scenario, Name##_Small, runs, iterations) { \
+        run##Scenario<Name##Transport, SmallPayload>(); \
+    } \
+    BENCHMARK(Scenario, Name##_Medium, runs, iterations) { \
+        run##Scenario<Name##Transport, MediumPayload>(); \
+    } \
+    BENCHMARK(Scenario, Name##_Variable, runs, iterations) { \
+        run##Scenario<Name##Transport, VariablePayload>(); \
+    }
+
+K_BENCH_PAYLOADS(Local,      Buffer,        10, 10)
+K_BENCH_PAYLOADS(Local,      Stream,        10, 10)
+K_BENCH_PAYLOADS(Local,      FunctionQueue, 10, 10)
+K_BENCH_PAYLOADS(Local,      VariantQueue,  10, 10)
+
+K_BENCH_PAYLOADS(OneToOne,   Buffer,        10, 10)
+K_BENCH_PAYLOADS(OneToOne,   Stream,        10, 10)
+K_BENCH_PAYLOADS(OneToOne,   FunctionQueue, 10, 10)
+K_BENCH_PAYLOADS(OneToOne,   VariantQueue,  10, 10)
+
+K_BENCH_PAYLOADS(ManyToOne,  Buffer,        10, 10)
+K_BENCH_PAYLOADS(ManyToOne,  Stream,        10, 10)
+K_BENCH_PAYLOADS(ManyToOne,  FunctionQueue, 10, 10)
+K_BENCH_PAYLOADS(ManyToOne,  VariantQueue,  10, 10)
+
+K_BENCH_PAYLOADS(Broadcast,  Buffer,        10, 10)
+K_BENCH_PAYLOADS(Broadcast,  Stream,        10, 10)
+K_BENCH_PAYLOADS(Broadcast,  FunctionQueue, 10, 10)
+K_BENCH_PAYLOADS(Broadcast,  VariantQueue,  10, 10)
+
+K_BENCH_PAYLOADS(Latency,    Stream,        10, 10)
+K_BENCH_PAYLOADS(Latency,    FunctionQueue, 10, 10)
+K_BENCH_PAYLOADS(Latency,    VariantQueue,  10, 10)
+
+int main (int argc, const char** argv) {
+    hayai::ConsoleOutputter outputter;
+    hayai::Benchmarker::AddOutputter(outputter);
+    hayai::Benchmarker::RunAllTests();
+    return 0;
+}
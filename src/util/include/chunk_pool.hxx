@@ -0,0 +1,172 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstddef>
+
+//
+// Shared, thread-aware freelist for fixed size memory chunks (backs ChunkedForwardList / CommandBuffer).
+//
+// – There is one pool per chunk size (ChunkPool<CHUNK_SIZE>::instance()).
+// – Each thread keeps a small local cache of free chunks, so acquire() / release() on the fast path
+//   touch no locks and no shared cache lines.
+// – Thread caches exchange chunks with a shared (mutex protected) freelist in batches of
+//   threadCacheChunks / 2 when they run empty / overflow, and flush themselves on thread exit.
+// – Memory only goes back to the system allocator when the shared freelist grows past
+//   maxFreeChunks, or when trim() is called.
+//
+// Chunks are NOT zeroed when recycled; ChunkedForwardList only ever reads back what it wrote.
+//
+
+struct ChunkPoolConfig {
+    size_t threadCacheChunks = 4;     // max free chunks cached per thread
+    size_t maxFreeChunks     = 64;    // max free chunks kept in the shared freelist
+};
+
+// Pool counters, for sizing the pool against frame rate + buffer counts. All values are cumulative
+// except resident (current) + peakResident (high water mark).
+struct ChunkPoolStats {
+    size_t hits         = 0;    // acquires served from a thread cache or the shared freelist
+    size_t misses       = 0;    // acquires that had to go to the system allocator
+    size_t releases     = 0;    // chunks returned to the pool
+    size_t resident     = 0;    // chunks currently allocated from the system (in use + cached)
+    size_t peakResident = 0;    // max value of resident over the pool's lifetime
+};
+
+template <size_t CHUNK_SIZE>
+class ChunkPool {
+    struct FreeChunk { FreeChunk* next; };
+    static_assert(CHUNK_SIZE >= sizeof(FreeChunk), "Chunk size too small");
+
+    // Per-thread chunk cache. Flushed back to the shared freelist on thread exit.
+    struct ThreadCache {
+        FreeChunk* head  = nullptr;
+        size_t     count = 0;
+
+        ~ThreadCache () { ChunkPool::instance().flush(*this, count); }
+    };
+    static ThreadCache& threadCache () {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    std::mutex          mutex;
+    FreeChunk*          freeList  = nullptr;
+    size_t              freeCount = 0;
+
+    std::atomic<size_t> threadCacheChunks { ChunkPoolConfig().threadCacheChunks };
+    std::atomic<size_t> maxFreeChunks     { ChunkPoolConfig().maxFreeChunks };
+
+    std::atomic<size_t> hits     { 0 };
+    std::atomic<size_t> misses   { 0 };
+    std::atomic<size_t> releases { 0 };
+    std::atomic<size_t> resident { 0 };
+    std::atomic<size_t> peakResident { 0 };
+
+    ChunkPool () {}
+public:
+    ChunkPool (const ChunkPool&) = delete;
+    ChunkPool& operator= (const ChunkPool&) = delete;
+    ~ChunkPool () { trim(); }
+
+    static ChunkPool& instance () {
+        static ChunkPool pool;
+        return pool;
+    }
+
+    // Set cache limits. Takes effect for subsequent acquire() / release() calls.
+    void configure (const ChunkPoolConfig& config) {
+        threadCacheChunks = config.threadCacheChunks;
+        maxFreeChunks     = config.maxFreeChunks;
+    }
+    ChunkPoolStats stats () const {
+        ChunkPoolStats s;
+        s.hits         = hits.load(std::memory_order_relaxed);
+        s.misses       = misses.load(std::memory_order_relaxed);
+        s.releases     = releases.load(std::memory_order_relaxed);
+        s.resident     = resident.load(std::memory_order_relaxed);
+        s.peakResident = peakResident.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // Get a CHUNK_SIZE block of (uninitialized) memory.
+    void* acquire () {
+        auto& cache = threadCache();
+        if (!cache.head)
+            refill(cache, threadCacheChunks.load(std::memory_order_relaxed) / 2 + 1);
+
+        if (auto chunk = cache.head) {
+            cache.head = chunk->next;
+            --cache.count;
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return static_cast<void*>(chunk);
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        auto count = resident.fetch_add(1, std::memory_order_relaxed) + 1;
+        for (auto peak = peakResident.load(std::memory_order_relaxed);
+            count > peak && !peakResident.compare_exchange_weak(peak, count, std::memory_order_relaxed); ) {}
+        return ::operator new(CHUNK_SIZE);
+    }
+
+    // Return a block previously obtained from acquire().
+    void release (void* ptr) {
+        if (!ptr) return;
+        auto& cache = threadCache();
+        auto chunk = static_cast<FreeChunk*>(ptr);
+        chunk->next = cache.head;
+        cache.head  = chunk;
+        releases.fetch_add(1, std::memory_order_relaxed);
+
+        auto limit = threadCacheChunks.load(std::memory_order_relaxed);
+        if (++cache.count > limit)
+            flush(cache, cache.count - limit / 2);
+    }
+
+    // Release all chunks in the shared freelist (not thread caches) to the system allocator.
+    void trim () {
+        FreeChunk* list;
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            list = freeList; freeList = nullptr; freeCount = 0;
+        }
+        freeChunks(list);
+    }
+private:
+    // Move up to n chunks from the shared freelist into a thread cache.
+    void refill (ThreadCache& cache, size_t n) {
+        std::lock_guard<std::mutex> lock (mutex);
+        for (; n && freeList; --n) {
+            auto chunk = freeList;
+            freeList = chunk->next; --freeCount;
+            chunk->next = cache.head; cache.head = chunk; ++cache.count;
+        }
+    }
+
+    // Move n chunks from a thread cache into the shared freelist; anything past maxFreeChunks
+    // goes back to the system allocator.
+    void flush (ThreadCache& cache, size_t n) {
+        FreeChunk* overflow = nullptr;
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            auto limit = maxFreeChunks.load(std::memory_order_relaxed);
+            for (; n && cache.head; --n) {
+                auto chunk = cache.head;
+                cache.head = chunk->next; --cache.count;
+                if (freeCount < limit) {
+                    chunk->next = freeList; freeList = chunk; ++freeCount;
+                } else {
+                    chunk->next = overflow; overflow = chunk;
+                }
+            }
+        }
+        freeChunks(overflow);
+    }
+    void freeChunks (FreeChunk* list) {
+        while (list) {
+            auto next = list->next;
+            ::operator delete(static_cast<void*>(list));
+            resident.fetch_sub(1, std::memory_order_relaxed);
+            list = next;
+        }
+    }
+};
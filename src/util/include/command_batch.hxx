@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "command_set.hxx"
+
+//
+// Type-grouped (batch) dispatch for CommandBuffers.
+//
+// CommandSet::dispatch() executes records in buffer order, bouncing between handlers when a buffer
+// interleaves many command types. BatchDispatcher instead:
+// – does a stable bucket sort of records by command type (or a stable radix sort by a user
+//   supplied sort key, eg. to run all window commands before GL commands)
+// – then calls each type's handler once per run of same-typed records:
+//      static void T::executeBatch (ArrayView<const T*> commands)     if T provides one
+//      T::execute () per record                                        otherwise
+//   Commands w/ an inline payload (see CommandPair) run per record: T::execute (payload).
+//
+// Commands of the SAME type (w/ the same key) keep their relative order; commands of different
+// types do not. Only use this for command sets where that doesn't matter.
+//
+// Usage:
+//      BatchDispatcher<MyCommandSet, MyCommandBuffer> batcher;
+//      batcher.dispatch(buffer);                                       // grouped by type
+//      batcher.dispatch(buffer, [](MyCommand cmd, const void* data) {  // grouped by key, then type
+//          return cmd == MyCommand::SWAP_BUFFERS ? 1 : 0;
+//      });
+//
+// Scratch storage is kept between calls (steady state dispatch does not allocate).
+//
+template <typename Set, typename Buffer>
+class BatchDispatcher {
+    typedef typename Set::Command Command;
+    static constexpr size_t COUNT = Set::COUNT;
+
+    struct Record {
+        Command     command;
+        const void* data;
+        InlineRef   payload;
+        uint64_t    key;
+    };
+
+    template <typename T, typename = void>
+    struct HasExecuteBatch : std::false_type {};
+    template <typename T>
+    struct HasExecuteBatch<T, std::void_t<decltype(T::executeBatch(std::declval<ArrayView<const T*>>()))>>
+        : std::true_type {};
+
+    struct ReadRecord {
+        template <typename T>
+        static const void* apply (Buffer& buffer, InlineRef& payload) {
+            return Set::template readRecord<T>(buffer, payload);
+        }
+    };
+    struct RunBatch {
+        // Execute a run of same-typed records.
+        template <typename T>
+        static void apply (const Record* begin, const Record* end) {
+            if constexpr (Set::template HasInline<T>::value) {
+                for (auto r = begin; r != end; ++r)
+                    const_cast<T*>(static_cast<const T*>(r->data))->execute(Set::template payloadOf<T>(r->payload));
+            } else if constexpr (HasExecuteBatch<T>::value) {
+                static thread_local std::vector<const T*> commands;
+                commands.clear();
+                for (auto r = begin; r != end; ++r)
+                    commands.push_back(static_cast<const T*>(r->data));
+                T::executeBatch(ArrayView<const T*> { commands.data(), commands.size() });
+            } else {
+                // Records are read in place from buffer chunks (never actually const).
+                for (auto r = begin; r != end; ++r)
+                    const_cast<T*>(static_cast<const T*>(r->data))->execute();
+            }
+        }
+    };
+    static constexpr auto readThunks  = Set::template makeThunks<ReadRecord, const void* (*)(Buffer&, InlineRef&)>();
+    static constexpr auto batchThunks = Set::template makeThunks<RunBatch, void (*)(const Record*, const Record*)>();
+
+    std::vector<Record> records;
+    std::vector<Record> sorted;
+    size_t              counts[COUNT + 1];
+    size_t              digits[256];
+
+    template <typename KeyFn>
+    void readRecords (Buffer& buffer, const KeyFn& keyFn) {
+        records.clear();
+        buffer.rewindReadHead();
+        for (Command command; (command = buffer.readNext()) != Command::NONE; ) {
+            InlineRef payload;
+            auto data = readThunks[(size_t)command](buffer, payload);
+            records.push_back({ command, data, payload, keyFn(command, data) });
+        }
+    }
+    // Counting sort records => sorted by command type (stable).
+    void sortByCommand () {
+        std::fill(&counts[0], &counts[COUNT + 1], 0);
+        for (auto& r : records)
+            ++counts[(size_t)r.command];
+        for (size_t i = 0, offset = 0; i <= COUNT; ++i) {
+            auto n = counts[i];
+            counts[i] = offset;
+            offset += n;
+        }
+        sorted.resize(records.size());
+        for (auto& r : records)
+            sorted[counts[(size_t)r.command]++] = r;
+    }
+    // Sort records => sorted by key, then command type (stable): LSD radix sort, one pass per key
+    // byte that differs between records (usually one or two), after the command type pass.
+    void sortByKey () {
+        sortByCommand();
+        uint64_t diff = 0;
+        for (auto& r : sorted)
+            diff |= r.key ^ sorted[0].key;
+        for (unsigned shift = 0; shift < 64; shift += 8) {
+            if (!((diff >> shift) & 0xff))
+                continue;
+            std::fill(&digits[0], &digits[256], 0);
+            for (auto& r : sorted)
+                ++digits[(r.key >> shift) & 0xff];
+            for (size_t i = 0, offset = 0; i < 256; ++i) {
+                auto n = digits[i];
+                digits[i] = offset;
+                offset += n;
+            }
+            for (auto& r : sorted)
+                records[digits[(r.key >> shift) & 0xff]++] = r;
+            records.swap(sorted);
+        }
+    }
+    void runBatches (const std::vector<Record>& records) {
+        for (size_t i = 0, n = records.size(); i < n; ) {
+            size_t j = i + 1;
+            while (j < n && records[j].command == records[i].command && records[j].key == records[i].key)
+                ++j;
+            batchThunks[(size_t)records[i].command](&records[i], &records[0] + j);
+            i = j;
+        }
+    }
+public:
+    // Dispatch all records, grouped by command type (in enum order).
+    void dispatch (Buffer& buffer) {
+        readRecords(buffer, [](Command, const void*) { return uint64_t(0); });
+        sortByCommand();
+        runBatches(sorted);
+    }
+
+    // Dispatch all records, ordered by keyFn(Command, const void* data) -> uint64_t, then by type.
+    template <typename KeyFn>
+    void dispatch (Buffer& buffer, const KeyFn& keyFn) {
+        readRecords(buffer, keyFn);
+        sortByKey();
+        runBatches(sorted);
+    }
+};
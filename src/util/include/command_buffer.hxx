@@ -1,335 +1,533 @@
-
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <cassert>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include "chunk_pool.hxx"
+
+// Default CommandBuffer chunk size (16 mb). Chunks are recycled through ChunkPool<CHUNK_SIZE>,
+// so the cost of a new buffer / buffer clear() is a few freelist pops, not a page fault per chunk.
+static constexpr size_t DEFAULT_COMMAND_CHUNK_SIZE = 4096 * 4096;
+
+// Header for variable length (inline) record data: followed by 'length' bytes, aligned to 'align'.
+// Header + data are always stored contiguously in one chunk.
+struct InlineHeader {
+    uint32_t length;
+    uint32_t align;
+};
 
-template <size_t CHUNK_SIZE = 4096 * 4096>
-class ChunkedForwardList {
-    constexpr SIZE = CHUNK_SIZE - sizeof(size_t) * 2;
-    struct Chunk {
-        Chunk* next; size_t head = 0;
-        uint8_t data[SIZE];
-
-        Chunk () { std::fill(&data[0], &data[SIZE], 0); }
-        Chunk (const Chunk& chunk) {
-            memcpy(static_cast<void*>(this), static_cast<void*>(&chunk), sizeof(Chunk));
-            next = chunk->next ?
-                new Chunk(*chunk->next) :
-                nullptr;
-        }
+// Non-owning view of an inline array stored in a command buffer / stream chunk.
+template <typename T>
+struct ArrayView {
+    typedef T value_type;
 
-        void rewind () { head = 0; }
-        void clear ()  { head = 0; memcpy(static_cast<void*>(&chunk->data[0]), 0, SIZE); }
+    const T* data = nullptr;
+    size_t   size = 0;
 
-        template <typename T>
-        void write (const T& value, Chunk*& head) {
-            static_assert(sizeof(T) < SIZE);
-            if (SIZE - head <= sizeof(T)) {
-                if (!next) next = new Chunk();
-                head = next;
-                next->write(value);
-            }
-            *static_cast<T*>(&data[head]) = value;
-            head += sizeof(T);
-        }
+    const T* begin () const { return data; }
+    const T* end   () const { return data + size; }
+    bool     empty () const { return size == 0; }
+    const T& operator[] (size_t i) const { return data[i]; }
+};
 
-        template <typename T>
-        const T* read (Chunk*& head) {
-            static_assert(sizeof(T) < SIZE);
-            if (SIZE - head <= sizeof(T)) {
-                if (!next) return nullptr;
-                head = next;
-                return next->read(value);
-            }
-            auto ptr = static_cast<T*>(&data[head]);
-            head += sizeof(T);
-            return *ptr;
-        }
-        ~Chunk () { if (head) delete head; }
-    };
-    Chunk* head;
-    size_t unused;
-    Chunk first;
+static inline constexpr size_t alignUp (size_t offset, size_t align) {
+    return (offset + align - 1) & ~(align - 1);
+}
 
-    void resetHead () {
-        head = &first;
-        for (auto seg = head; seg; seg = seg->next)
-            seg->rewind();
-    }
-    void clear () {
-        head = &first;
-        for (auto seg = head; seg; seg = seg->next)
-            seg->clear();
-    }
+//
+// Non-POD record support.
+//
+// Trivially copyable values are stored as raw bytes, and copied / recycled w/ memcpy (no overhead).
+// Anything else is stored as a ManagedRecord<T>: the value is preceded by a pointer to a per-type
+// RecordOps table (copy / relocate / destroy), and each chunk keeps a list of its managed records,
+// so clear(), copies + chunk recycling run the right constructors / destructors.
+//
+// Specialize IsTriviallyRelocatable<T> for types that can be moved w/ memcpy but are not trivially
+// copyable (eg. std::unique_ptr); relocating those skips the move ctor + dtor.
+//
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
 
-    template <typename T>
-    void write (const T& value) {
-        head->write(value, head);
-    }
-    template <typename T>
-    const T* value read () {
-        return head->read(head);
-    }
+template <typename T>
+struct IsManagedRecord : std::integral_constant<bool, !std::is_trivially_copyable<T>::value> {};
 
-    ChunkedForwardList () : head(&first) {}
-    ChunkedForwardList (const ChunkedForwardList &cl) 
-        : head(nullptr), 
-          first(cl.first)    // copy chunk data recursively via Chunk ctor
-    {
-        // Iterate forward until we find the node that cl.head points to.
-        // Set the matching node in our list as our head.
-        for (auto src = &cl.first, dst = &first; src; src = src->next, dst = dst->next) {
-            assert((src != nullptr) == (dst != nullptr));
-            if (src == cl.head) 
-                head = dst;
-        }
-        assert(head != nullptr);
-    }
+struct RecordOps {
+    void (*copy)     (void* dst, const void* src);  // copy construct (nullptr if T is move-only)
+    void (*relocate) (void* dst, void* src);        // move construct dst + destroy src
+    void (*destroy)  (void* record);
 };
 
-template <class CommandType>
-class CommandBuffer {
-    std::unique_ptr<ChunkedForwardList> buffer;
-    typedef CommandType CommandType;
-
-    CommandBuffer () : buffer(new decltype(buffer)());
-    CommandBuffer (CommandBuffer&& cb) : buffer(std::move(cb.buffer)) {}
-    CommandBuffer (const CommandBuffer& cb) : buffer(new decltype(buffer)(cb.buffer)) {}
-    virtual ~CommandBuffer () {}
-
-    void rewindReadHead () { buffer->resetHead(); }
-    void clear () { buffer->clear(); }
-
-    template <typename T>
-    void write (CommandType command, const T& data) {
-        buffer->write(command);
-        buffer->write(data);
-    }
-    CommandType readNext () {
-        auto ptr = buffer->read<CommandType>();
-        return ptr ? *ptr : CommandType::NONE;    // end of stream gets translated to command '0'.
+// Header for managed (non-POD) records.
+struct ManagedHeader {
+    const RecordOps* ops;   // nullptr once the record has been relocated / destroyed
+    size_t           prev;  // offset + 1 of previous managed record in this chunk (0 = none)
+};
+template <typename T>
+struct ManagedRecord {
+    ManagedHeader header;
+    T             value;
+
+    template <typename... Args>
+    ManagedRecord (const RecordOps* ops, size_t prev, Args&&... args)
+        : header { ops, prev }, value(std::forward<Args>(args)...) {}
+
+    static ManagedRecord* fromValue (const T* value) {
+        return reinterpret_cast<ManagedRecord*>(
+            reinterpret_cast<uint8_t*>(const_cast<T*>(value)) - offsetof(ManagedRecord, value));
     }
-    template <typename T>
-    const T* read () {
-        return buffer->read<T>();
+    static void copy (void* dst, const void* src) {
+        if constexpr (std::is_copy_constructible<T>::value) {
+            auto record = static_cast<const ManagedRecord*>(src);
+            new (dst) ManagedRecord(record->header.ops, record->header.prev, record->value);
+        }
     }
-
-    // Base Visitor CRTP class template. Inherit from this to provide a default visit() method.
-    template <typename Self>
-    struct Visitor {
-        typedef CommandType CommandType;
-        typedef CommandBuffer<CommandType> CommandBuffer;
-
-        Self& visit (CommandBuffer& buffer) {
-            return visit(*static_cast<Self*>(this), buffer), *static_cast<Self*>(this);
+    static void relocate (void* dst, void* src) {
+        auto record = static_cast<ManagedRecord*>(src);
+        if constexpr (IsTriviallyRelocatable<T>::value) {
+            memcpy(dst, src, sizeof(ManagedRecord));
+        } else {
+            new (dst) ManagedRecord(record->header.ops, record->header.prev, std::move(record->value));
+            record->value.~T();
         }
-    };
+        record->header.ops = nullptr;
+    }
+    static void destroy (void* record) {
+        static_cast<ManagedRecord*>(record)->value.~T();
+    }
+    static const RecordOps* ops () {
+        static constexpr RecordOps table {
+            std::is_copy_constructible<T>::value ? &ManagedRecord::copy : nullptr,
+            &ManagedRecord::relocate,
+            &ManagedRecord::destroy
+        };
+        return &table;
+    }
 };
 
-//
-// Macros to define user command buffer operations + linkage. See usage at end.
-//
-// To implement a Command or Event data structure:
-// – define an enum class w/ unique entries for all values, starting at 1.
-// – must define a special value of NONE = 0, as mentioned below
-// – define structs w/ command / event data
-// – commands must have a void execute () method
-//
-// map the struct types to enum values w/:
-// – DEFINE_COMMAND(E::VALUE, T) for commands / events
-// – DISPATCH_COMMAND(E::VALUE, T) inside a BEGIN / END block for commands
-// – DISPATCH_VISITOR(E::VALUE, T) inside a BEGIN / END block for events
-//
-// To visit events:
-// – define a Visitor struct inheriting from CommandBuffer<E>::Visitor<YourVisitorClass>.
-// – define 'void visit (T&)' methods for all event types. Missing methods => compile errors.
-// – invoke your visitor's methods w/ <yourVisitorInstance>.visit(CommandBuffer<E>& instance)
-//
-// Note:
-// – structs may double as both Commands and Events
-// – structs may be reused as backing data type for multiple different command buffers;
-//   enum classes cannot.
-// – any type can be used to implement events: existing classes / structs, int, etc.
-// – However, using non-POD types will result in undefined behavior atm; values are assigned
-//   to / from for single access, but if a CommandBuffer is copied it does so via memcpy().
-// – Implementing proper copy-construction for command elements would needlessly complicate
-//   the structure of CommandBuffer, so please use POD types + non-owning pointers to implement
-//   commands + events atm. (note: would memcpying std::weak_ptr<T> work?).
-//
-// See examples at the end for exact usage and expected patterns.
-//
-
+// Storage type for a T in a chunk (T or ManagedRecord<T>).
+template <typename T>
+using StoredRecord = typename std::conditional<IsManagedRecord<T>::value, ManagedRecord<T>, T>::type;
 
-// Defines a CommandBuffer dispatch method for a given CMD (enum class) type.
-//
-// CMD_ENUM *must* define CMD_ENUM::NONE = 0, which should not overlap with any other value.
-// – CMD_ENUM::NONE is a special value.
-// – It is illegal to define operations on CMD_ENUM::NONE, eg.
-//      DEFINE_COMMAND(<CMD_ENUM>::NONE, ...)
-//  or  DISPATCH_COMMAND(<CMD_ENUM>::NONE, ...)
-//  or  DISPATCH_VISITOR(<CMD_ENUM>::NONE, ...)
 //
-#define BEGIN_COMMAND_DISPATCH_IMPL(CMD_ENUM) \
-void dispatch (CommandBuffer<CMD>& buffer) {\
-    cb.rewindReadHead(); \
-    bool done = false; \
-    E command; \
-    while (!done) { \
-        switch (CMD command = buffer.readNext()) { \
-            case CMD::NONE: done = true; break;
-
-// End CommandBuffer dispatch method
-#define END_COMMAND_DISPATCH_IMPL \
-            default: static_assert(0, "Missing command(s)"); \
-        } \
-    } \
-}
-
-// "Connect" an enum value (must be an element of CMD), and command structure type
-// (must have a void execute() method). Must occur between BEGIN / END _COMAND_DISPATCH_IMPL.
-#define DISPATCH_COMMAND(CMD,T) \
-    case CMD: cb.read<T>->execute(); break;
-
-
-// Defines a CommandBuffer write method, "Connecting" an enum value and command structure type 
-// (must have a void execute() method). This is a freestanding declaration, bust must be matched
-// with a DISPATCH_COMMAND statement between BEGIN / END _COMMAND_DISPATCH_IMPL statements.
-#define DEFINE_COMMAND(CMD,T) \
-auto& write (CommandBuffer<decltype(E)>& buffer, const T& data) { \
-    return buffer.write(CMD, data), buffer; \
-}
-
-#define BEGIN_COMMAND_VISIT_IMPL(CMD_ENUM) \
-template <typename Visitor> \
-void visit (CommandBuffer<CMD_ENUM> cb, Visitor& visitor) { \
-    cb.rewindReadHead(); \
-    bool done = false; \
-    E command; \
-    while (!done) { \
-        switch (CMD_ENUM command = buffer.readNext()) { \
-            case CMD_ENUM::NONE: done = true; break;
-
-#define DISPATCH_VISITOR(CMD,T) \
-    case CMD: visitor.visit(*cb.read<T>); break;
-
-#define END_COMMAND_VISIT_IMPL END_COMMAND_DISPATCH_IMPL
-
+// Forward list of fixed size chunks, used to store CommandBuffer records.
 //
-// Macro usage / example:
+// Lists can be sealed (made immutable), after which copies share chunks instead of copying them:
+// – chunks are refcounted; a list holds a ref on its first chunk, and each chunk holds a ref on
+//   the next one, so the last list to let go of a shared chunk chain releases it.
+// – each copy has its own read cursor, so copying a sealed list is O(1) regardless of contents.
+// – writing to (or clear()ing) a sealed list is copy-on-write: the list gets its own private
+//   copy of the chain first (or just unseals, if it is the only remaining owner).
+// – lists holding move-only records can't be copied (std::logic_error), so neither can shared
+//   sealed copies of them be written to.
 //
+template <size_t CHUNK_SIZE = DEFAULT_COMMAND_CHUNK_SIZE>
+class ChunkedForwardList {
+public:
+    struct Chunk;
+    typedef ChunkPool<CHUNK_SIZE> Pool;
+    // Chunk data is max_align_t aligned, so record alignment (relative to data) is also absolute.
+    static constexpr size_t HEADER_SIZE = alignUp(sizeof(Chunk*) + sizeof(size_t) * 3, alignof(std::max_align_t));
+    static constexpr size_t SIZE = CHUNK_SIZE - HEADER_SIZE;
 
-#if 0
-
-//
-// Command Example
-//
+    struct Chunk {
+        Chunk*              next = nullptr;
+        size_t              size = 0;       // write head (bytes written)
+        std::atomic<size_t> refs { 1 };     // owning refs (list => first chunk, chunk => next chunk)
+        size_t              managed = 0;    // offset + 1 of last ManagedRecord (0 = none)
+        alignas(std::max_align_t) uint8_t data[SIZE];   // uninitialized
+
+        Chunk () {}
+        Chunk (const Chunk&) = delete;
+        Chunk& operator= (const Chunk&) = delete;
+
+        // Destroys managed records (in reverse order) before the chunk goes back to the pool.
+        ~Chunk () {
+            for (size_t record = managed; record; ) {
+                auto header = reinterpret_cast<ManagedHeader*>(&data[record - 1]);
+                record = header->prev;
+                if (header->ops)
+                    header->ops->destroy(header);
+            }
+        }
 
-// Command definition (header file)
-enum class kExampleCmd { NONE = 0, FOO, BAR, BAZ };
-namespace ExampleCommand {
-    struct Foo { ... void execute (); };
-    struct Bar { ... void execute (); };
-    struct Baz { ... void execute();  };
-    typedef CommandBuffer<kExampleCmd> CommandBuffer;
-}
+        // Can copyFrom() copy this chunk? (false if it holds live move-only records)
+        bool isCopyable () const {
+            for (size_t record = managed; record; ) {
+                auto header = reinterpret_cast<const ManagedHeader*>(&data[record - 1]);
+                if (header->ops && !header->ops->copy)
+                    return false;
+                record = header->prev;
+            }
+            return true;
+        }
 
-DEFINE_COMMAND(kExampleCmd::FOO, ExampleCommand::Foo)
-DEFINE_COMMAND(kExampleCmd::BAR, ExampleCommand::Bar)
-DEFINE_COMMAND(kExampleCmd::BAZ, ExampleCommand::Baz)
+        // Copy written data + managed records from another chunk (must be isCopyable()).
+        void copyFrom (const Chunk& src) {
+            memcpy(&data[0], &src.data[0], src.size);
+            size = src.size;
+            managed = src.managed;
+            for (size_t record = managed; record; ) {
+                auto header = reinterpret_cast<const ManagedHeader*>(&src.data[record - 1]);
+                if (header->ops)
+                    header->ops->copy(&data[record - 1], header);
+                record = header->prev;
+            }
+        }
 
-BEGIN_COMMAND_DISPATCH_IMPL(kExampleCmd)
-    DISPATCH_COMMAND(kExampleCmd::FOO, ExampleCommand::Foo)
-    DISPATCH_COMMAND(kExampleCmd::BAR, ExampleCommand::Bar)
-    DISPATCH_COMMAND(kExampleCmd::BAZ, ExampleCommand::Baz)
-END_COMMAND_DISPATCH_IMPL
+        // Chunk memory is always taken from / returned to the shared chunk pool.
+        static void* operator new    (size_t) { return Pool::instance().acquire(); }
+        static void  operator delete (void* ptr) { Pool::instance().release(ptr); }
 
+        // Returns offset of a T at / after offset, or SIZE if a T would not fit in this chunk.
+        template <typename T>
+        static size_t fit (size_t offset) {
+            offset = alignUp(offset, alignof(T));
+            return offset + sizeof(T) <= SIZE ? offset : SIZE;
+        }
 
-// Command implementation (source file)
-void ExampleCommand::Foo::execute () { ... }
-void ExampleCommand::Bar::execute () { ... }
-void ExampleCommand::Baz::execute () { ... }
+        // Drop a ref to a chunk chain; frees chunks whose last ref this was.
+        static void release (Chunk* chunk) {
+            while (chunk && chunk->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                auto next = chunk->next;
+                delete chunk;
+                chunk = next;
+            }
+        }
+    };
+    static_assert(sizeof(Chunk) <= CHUNK_SIZE, "Chunk header does not fit in CHUNK_SIZE");
+    static_assert(offsetof(Chunk, data) == HEADER_SIZE, "Unexpected chunk layout");
+
+private:
+    Chunk*  first     = nullptr;
+    Chunk*  last      = nullptr;    // write chunk
+    Chunk*  readChunk = nullptr;
+    size_t  readHead  = 0;
+    bool    sealed    = false;
+
+    void releaseChunks () {
+        Chunk::release(first);
+        first = last = readChunk = nullptr;
+        readHead = 0;
+        sealed   = false;
+    }
 
-//
-// Event usage:
-//
+    // Copy chunk data; data past each chunk's size is garbage, so only copy what was written.
+    // Throws std::logic_error (before copying anything) if the list holds move-only records.
+    void copyChunks (const ChunkedForwardList& cl) {
+        for (auto src = cl.first; src; src = src->next)
+            if (!src->isCopyable())
+                throw std::logic_error("Cannot copy CommandBuffer containing move-only records");
+        for (auto src = cl.first; src; src = src->next) {
+            auto chunk = new Chunk();
+            (last ? last->next : first) = chunk;
+            chunk->copyFrom(*src);
+            last = chunk;
+            if (src == cl.readChunk)
+                readChunk = chunk;
+        }
+        readHead = cl.readHead;
+    }
 
-void pushEvents (ExampleCommand::CommandBuffer& cb) {
-    cb.write(ExampleCommand::Foo{ ... });
-    cb.write(ExampleCommand::Foo{ ... });
-    cb.write(ExampleCommand::Baz{ ... });
-}
-void runEvents (ExampleCommand::CommandBuffer& cb) {
-    dispatch(cb);
-}
+    // Copy-on-write: get a private (writable) chain before modifying a sealed list.
+    void unseal () {
+        if (first && first->refs.load(std::memory_order_acquire) != 1) {
+            ChunkedForwardList copy (*this, false);
+            swap(copy);
+        }
+        sealed = false;
+    }
+    ChunkedForwardList (const ChunkedForwardList& cl, bool) { copyChunks(cl); }
+public:
+    ChunkedForwardList () {}
+    ChunkedForwardList (const ChunkedForwardList& cl) {
+        if (!cl.sealed) {
+            copyChunks(cl);
+        } else {
+            // Share chunks; only the read cursor is copied.
+            if (cl.first)
+                cl.first->refs.fetch_add(1, std::memory_order_relaxed);
+            first     = cl.first;
+            last      = cl.last;
+            readChunk = cl.readChunk;
+            readHead  = cl.readHead;
+            sealed    = true;
+        }
+    }
+    ChunkedForwardList (ChunkedForwardList&& cl) { swap(cl); }
+    ChunkedForwardList& operator= (const ChunkedForwardList&) = delete;
+    ~ChunkedForwardList () { releaseChunks(); }
+
+    void swap (ChunkedForwardList& cl) {
+        std::swap(first, cl.first);
+        std::swap(last, cl.last);
+        std::swap(readChunk, cl.readChunk);
+        std::swap(readHead, cl.readHead);
+        std::swap(sealed, cl.sealed);
+    }
 
+    // Rewind read head to start of buffer.
+    void resetHead () {
+        readChunk = first;
+        readHead  = 0;
+    }
 
-//
-// Event Example
-//
+    // Iterate over written chunk data, in order: fn(const uint8_t* data, size_t size).
+    template <typename F>
+    void forEachChunk (const F& fn) const {
+        for (auto chunk = first; chunk; chunk = chunk->next)
+            fn(&chunk->data[0], chunk->size);
+    }
 
-// Event definition (header file)
-enum class kExampleEvent { NONE = 0, FOO, BAR, BAZ };
-namespace ExampleEvent {
-    struct Foo { ... };
-    struct Bar { ... };
-    struct Baz { ... };
-    typedef CommandBuffer<kExampleEvent> CommandBuffer;
-}
+    // Does any chunk hold managed (non-POD) records? Those can't be serialized as raw bytes.
+    bool hasManagedRecords () const {
+        for (auto chunk = first; chunk; chunk = chunk->next)
+            if (chunk->managed)
+                return true;
+        return false;
+    }
 
-DEFINE_COMMAND(kExampleEvent::FOO, ExampleEvent::Foo)
-DEFINE_COMMAND(kExampleEvent::BAR, ExampleEvent::Bar)
-DEFINE_COMMAND(kExampleEvent::BAZ, ExampleEvent::Baz)
+    // Clear buffer contents. Chunks get returned to the chunk pool (once no sealed copies use them).
+    void clear () { releaseChunks(); }
 
-BEGIN_COMMAND_VISIT_IMPL(kExampleEvent)
-    DISPATCH_VISITOR(kExampleEvent::FOO, ExampleEvent::Foo)
-    DISPATCH_VISITOR(kExampleEvent::BAR, ExampleEvent::Bar)
-    DISPATCH_VISITOR(kExampleEvent::BAZ, ExampleEvent::Baz)
-END_COMMAND_VISIT_IMPL
+    // Make contents immutable, so copies share chunks. Writes will copy (see unseal()).
+    void seal () { sealed = true; }
+    bool isSealed () const { return sealed; }
 
-// Event usage (source file)
+    bool empty () const { return !first || !first->size; }
 
-struct MyVisitor {
-    ...
-    MyVisitor (...) : ... {}
+    template <typename T>
+    void write (T&& value) {
+        typedef typename std::decay<T>::type V;
+        typedef StoredRecord<V> Stored;
+        static_assert(sizeof(Stored) <= SIZE, "Value too large for chunk");
+        if (sealed) unseal();
+        size_t offset = last ? Chunk::template fit<Stored>(last->size) : SIZE;
+        if (offset == SIZE) {
+            auto chunk = new Chunk();
+            (last ? last->next : first) = chunk;
+            last   = chunk;
+            offset = 0;
+        }
+        if constexpr (IsManagedRecord<V>::value) {
+            new (&last->data[offset]) Stored(Stored::ops(), last->managed, std::forward<T>(value));
+            last->managed = offset + 1;
+        } else {
+            memcpy(&last->data[offset], &value, sizeof(V));
+        }
+        last->size = offset + sizeof(Stored);
+    }
 
-    void visit (ExampleEvent::Foo& ev) { ... }
-    void visit (ExampleEvent::Bar& ev) { ... }
-    void visit (ExampleEvent::Baz& ev) { ... }
+    // Move a managed record (previously returned by read<T>()) from another list into this one.
+    // The source record is left destroyed (+ skipped when its chunk is released).
+    template <typename T>
+    void writeRelocated (const T* value) {
+        static_assert(IsManagedRecord<T>::value, "writeRelocated() is only needed for managed records");
+        typedef ManagedRecord<T> Stored;
+        if (sealed) unseal();
+        size_t offset = last ? Chunk::template fit<Stored>(last->size) : SIZE;
+        if (offset == SIZE) {
+            auto chunk = new Chunk();
+            (last ? last->next : first) = chunk;
+            last   = chunk;
+            offset = 0;
+        }
+        auto src = Stored::fromValue(value);
+        auto ops = src->header.ops;
+        assert(ops && "Record already relocated / destroyed");
+        ops->relocate(&last->data[offset], src);
+        auto dst = reinterpret_cast<Stored*>(&last->data[offset]);
+        dst->header.ops  = ops;
+        dst->header.prev = last->managed;
+        last->managed = offset + 1;
+        last->size = offset + sizeof(Stored);
+    }
 
-    MyVisitor& visit (ExampleEvent::CommandBuffer& events) {
-        return visit(events, *this), *this;
+    // Byte length of an inline block of count values (size bytes each, aligned to align). Inline
+    // blocks never span chunks: throws std::length_error if it can't fit in one. Check before
+    // writing the rest of the record, so a failed write leaves the buffer as it was.
+    static uint32_t inlineLength (size_t count, size_t size, size_t align) {
+        if (align > SIZE || count > (SIZE - alignUp(sizeof(InlineHeader), align)) / size)
+            throw std::length_error("Inline data too large for command buffer chunk");
+        return (uint32_t)(count * size);
     }
-};
 
-void visitExample (ExampleEvent::CommandBuffer& events) {
-    MyVisitor visitor { ... };
-    visitor.visit(events);
-}
+    // Write a variable length block (InlineHeader + length bytes aligned to align).
+    // Throws std::length_error if it can't fit in one chunk (see inlineLength()).
+    void writeInline (const void* src, uint32_t length, uint32_t align) {
+        assert(align && !(align & (align - 1)));
+        inlineLength(length, 1, align);
+        if (sealed) unseal();
+        size_t offset     = last ? Chunk::template fit<InlineHeader>(last->size) : SIZE;
+        size_t dataOffset = alignUp(offset + sizeof(InlineHeader), align);
+        if (offset == SIZE || dataOffset + length > SIZE) {
+            auto chunk = new Chunk();
+            (last ? last->next : first) = chunk;
+            last       = chunk;
+            offset     = 0;
+            dataOffset = alignUp(sizeof(InlineHeader), align);
+        }
+        InlineHeader header { length, align };
+        memcpy(&last->data[offset], &header, sizeof(InlineHeader));
+        memcpy(&last->data[dataOffset], src, length);
+        last->size = dataOffset + length;
+    }
 
-// OR
+    // Read a variable length block (in-place); returns nullptr if at end of stream.
+    const InlineHeader* readInline (const uint8_t*& data) {
+        auto header = read<InlineHeader>();
+        if (header) {
+            size_t offset = alignUp(readHead, header->align);
+            data     = &readChunk->data[offset];
+            readHead = offset + header->length;
+        }
+        return header;
+    }
 
-struct MyVisitor : public ExampleEvent::CommandBuffer::Visitor<MyVisitor> {
-    ...
-    MyVisitor (...) : ... {}
+    // Returns pointer to next value (in-place), or nullptr if at end of stream.
+    template <typename T>
+    const T* read () {
+        typedef StoredRecord<T> Stored;
+        static_assert(sizeof(Stored) <= SIZE, "Value too large for chunk");
+        if (!readChunk && !(readChunk = first))
+            return nullptr;
+
+        // Writes that did not fit in a chunk start at the beginning of the next one.
+        size_t offset = Chunk::template fit<Stored>(readHead);
+        while (offset == SIZE || offset + sizeof(Stored) > readChunk->size) {
+            if (!readChunk->next)
+                return nullptr;
+            readChunk = readChunk->next;
+            offset = 0;
+        }
+        readHead = offset + sizeof(Stored);
+        if constexpr (IsManagedRecord<T>::value)
+            return &reinterpret_cast<const Stored*>(&readChunk->data[offset])->value;
+        else
+            return reinterpret_cast<const T*>(&readChunk->data[offset]);
+    }
+};
 
-    void visit (ExampleEvent::Foo& ev) { ... }
-    void visit (ExampleEvent::Bar& ev) { ... }
-    void visit (ExampleEvent::Baz& ev) { ... }
+template <class CommandType, size_t CHUNK_SIZE = DEFAULT_COMMAND_CHUNK_SIZE>
+class CommandBuffer {
+    typedef ChunkedForwardList<CHUNK_SIZE> Buffer;
+    Buffer buffer;
+public:
+    typedef CommandType Command;
+    typedef ChunkPool<CHUNK_SIZE> Pool;
 
-    // Automatic visit() method + typedefs for:
-    // – CommandType    (enum class type)
-    // – CommandBuffer  (CommandBuffer<Command>)
-};
+    CommandBuffer () {}
+    CommandBuffer (CommandBuffer&& cb) : buffer(std::move(cb.buffer)) {}
+    CommandBuffer (const CommandBuffer& cb) : buffer(cb.buffer) {}
+    virtual ~CommandBuffer () {}
 
-void visitExample (MyVisitor::CommandBuffer& events) {
-    MyVisitor visitor { ... };
-    visitor.visit(events);
-}
+    void rewindReadHead () { buffer.resetHead(); }
+    void clear () { buffer.clear(); }
+    bool empty () const { return buffer.empty(); }
+    void swap (CommandBuffer& other) { buffer.swap(other.buffer); }
+
+    // Broadcasting: seal() makes buffer contents immutable, after which copies share chunks and only
+    // get their own read cursor (O(1) per copy). Use this to fan out one event buffer to many
+    // consumers, eg.
+    //      events.seal();
+    //      for (auto& client : clients)
+    //          client->send(events);     // copies CommandBuffer, not contents
+    //
+    // Sealed buffers (and their copies) may be read concurrently from different threads. Writing to a
+    // sealed buffer copies its contents first (copy-on-write).
+    void seal () { buffer.seal(); }
+    bool isSealed () const { return buffer.isSealed(); }
+
+    // Iterate over raw chunk data (eg. for serialization): fn(const uint8_t* data, size_t size).
+    template <typename F>
+    void forEachChunk (const F& fn) const { buffer.forEachChunk(fn); }
+    bool hasManagedRecords () const { return buffer.hasManagedRecords(); }
+
+    // Chunk pool stats / configuration (shared by all buffers w/ the same CHUNK_SIZE).
+    static ChunkPoolStats poolStats () { return Pool::instance().stats(); }
+    static void configurePool (const ChunkPoolConfig& config) { Pool::instance().configure(config); }
+
+    // Values may be any copy or move constructible type; non-POD values are stored as managed
+    // records (see RecordOps), so they are copied / destroyed properly by copies + clear().
+    template <typename T>
+    void write (CommandType command, T&& data) {
+        buffer.write(command);
+        buffer.write(std::forward<T>(data));
+    }
 
-// OR
+    // Move a managed record (from read<T>() on another buffer) into this buffer.
+    template <typename T>
+    void writeRelocated (CommandType command, const T* data) {
+        buffer.write(command);
+        buffer.writeRelocated(data);
+    }
+    // Variable length records; string / array data is stored inline in the buffer (no allocations).
+    // Inline data must fit in one chunk (else std::length_error; nothing is written).
+    // An optional fixed size value may precede the inline data, eg.
+    //      cb.writeString(kCmd::SET_TITLE, windowId, title);
+    // is read back w/
+    //      auto id = cb.read<WindowId>(); auto title = cb.readString();
+    //
+    void writeString (CommandType command, std::string_view str) {
+        auto length = Buffer::inlineLength(str.size(), 1, 1);
+        buffer.write(command);
+        buffer.writeInline(str.data(), length, 1);
+    }
+    template <typename T>
+    void writeString (CommandType command, const T& data, std::string_view str) {
+        static_assert(std::is_trivially_copyable<T>::value, "Inline records must be trivially copyable");
+        auto length = Buffer::inlineLength(str.size(), 1, 1);
+        write(command, data);
+        buffer.writeInline(str.data(), length, 1);
+    }
+    template <typename U>
+    void writeArray (CommandType command, const U* values, size_t count) {
+        static_assert(std::is_trivially_copyable<U>::value, "Inline records must be trivially copyable");
+        auto length = Buffer::inlineLength(count, sizeof(U), alignof(U));
+        buffer.write(command);
+        buffer.writeInline(values, length, alignof(U));
+    }
+    template <typename T, typename U>
+    void writeArray (CommandType command, const T& data, const U* values, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_copyable<U>::value,
+            "Inline records must be trivially copyable");
+        auto length = Buffer::inlineLength(count, sizeof(U), alignof(U));
+        write(command, data);
+        buffer.writeInline(values, length, alignof(U));
+    }
 
-void visitExample (CommandBuffer<MyVisitor::CommandType>& events) {
-    MyVisitor visitor { ... };
-    visitor.visit(events);   
-}
+    CommandType readNext () {
+        auto ptr = buffer.template read<CommandType>();
+        return ptr ? *ptr : CommandType::NONE;    // end of stream gets translated to command '0'.
+    }
+    template <typename T>
+    const T* read () {
+        return buffer.template read<T>();
+    }
 
-#endif
+    // Read inline data written w/ writeString() / writeArray(). Views point into the buffer, and are
+    // valid until the buffer is cleared / destroyed.
+    std::string_view readString () {
+        const uint8_t* data;
+        auto header = buffer.readInline(data);
+        return header ?
+            std::string_view(reinterpret_cast<const char*>(data), header->length) :
+            std::string_view();
+    }
+    template <typename U>
+    ArrayView<U> readArray () {
+        const uint8_t* data;
+        auto header = buffer.readInline(data);
+        if (!header) return {};
+        assert(header->align == alignof(U) && header->length % sizeof(U) == 0);
+        return { reinterpret_cast<const U*>(data), header->length / sizeof(U) };
+    }
+};
 
+// Command / event type registration, write() overloads + dispatch / visit: see command_set.hxx.
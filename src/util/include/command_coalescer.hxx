@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "command_set.hxx"
+
+//
+// Optional coalescing pass for CommandBuffers, run before dispatch.
+//
+// Clients often set the same property many times per frame (window size during a drag, cursor
+// pos, title, etc). Command types that declare a merge key
+//
+//      struct SetWindowSize {
+//          WindowId   window;
+//          glm::ivec2 size;
+//          uint64_t mergeKey () const { return window; }
+//          void execute ();
+//      };
+//
+// are folded so only the LAST write per (command type, merge key) survives, at the position of that
+// last write. Commands w/out a mergeKey() method are never folded, and keep their relative order.
+// Inline payloads (see CommandPair) are kept w/ their records.
+//
+// Usage (once per frame, on the thread that owns the buffer):
+//
+//      CommandCoalescer<MyCommandSet, MyCommandBuffer> coalescer;
+//      coalescer.coalesce(buffer);
+//      MyCommandSet::dispatch(buffer);
+//
+// Scratch storage (record list, sorted merge keys, output buffer) is kept between passes, so a
+// steady state pass only allocates chunks from the chunk pool.
+//
+// Surviving non-POD records are moved into the output buffer, unless the buffer is sealed (its
+// chunks may be shared w/ copies; see CommandBuffer::seal()): then they're copied, and a sealed
+// buffer w/ move-only records that need to be rewritten throws std::logic_error (buffer unchanged).
+//
+
+struct CoalesceStats {
+    size_t passes  = 0;     // number of coalesce() calls
+    size_t records = 0;     // records read
+    size_t folded  = 0;     // records dropped (superseded by a later write w/ the same merge key)
+};
+
+template <typename Set, typename Buffer>
+class CommandCoalescer {
+    typedef typename Set::Command Command;
+
+    struct Record {
+        Command     command;
+        const void* data;
+        InlineRef   payload;
+        bool        folded;
+    };
+    struct MergeKey {
+        Command  command;
+        uint64_t key;
+        size_t   index;     // record index
+
+        bool operator< (const MergeKey& other) const {
+            if (command != other.command) return command < other.command;
+            if (key != other.key)         return key < other.key;
+            return index < other.index;
+        }
+        bool sameKey (const MergeKey& other) const {
+            return command == other.command && key == other.key;
+        }
+    };
+
+    // Per-type thunks (see CommandSet::makeThunks()).
+    template <typename T, typename = void>
+    struct HasMergeKey : std::false_type {};
+    template <typename T>
+    struct HasMergeKey<T, std::void_t<decltype(std::declval<const T&>().mergeKey())>> : std::true_type {};
+
+    struct ReadRecord {
+        template <typename T>
+        static const void* apply (Buffer& buffer, InlineRef& payload) {
+            return Set::template readRecord<T>(buffer, payload);
+        }
+    };
+    struct GetMergeKey {
+        template <typename T>
+        static bool apply (const void* data, uint64_t& key) {
+            if constexpr (HasMergeKey<T>::value) {
+                key = (uint64_t)static_cast<const T*>(data)->mergeKey();
+                return true;
+            }
+            return false;
+        }
+    };
+    struct WriteRecord {
+        // Surviving non-POD records are moved into the output buffer, or copied if the input's
+        // chunks are shared (relocating would destroy the records other copies still read).
+        template <typename T>
+        static void apply (Buffer& buffer, const void* data, InlineRef payload, bool shared) {
+            if constexpr (IsManagedRecord<T>::value) {
+                if (!shared)
+                    buffer.writeRelocated(Set::template idOf<T>(), static_cast<const T*>(data));
+                else if constexpr (std::is_copy_constructible<T>::value)
+                    Set::write(buffer, *static_cast<const T*>(data));
+                else
+                    throw std::logic_error("Cannot coalesce sealed CommandBuffer containing move-only records");
+            } else if constexpr (Set::template HasInline<T>::value)
+                Set::write(buffer, *static_cast<const T*>(data), Set::template payloadOf<T>(payload));
+            else
+                Set::write(buffer, *static_cast<const T*>(data));
+        }
+    };
+    static constexpr auto readThunks  = Set::template makeThunks<ReadRecord,  const void* (*)(Buffer&, InlineRef&)>();
+    static constexpr auto keyThunks   = Set::template makeThunks<GetMergeKey, bool (*)(const void*, uint64_t&)>();
+    static constexpr auto writeThunks = Set::template makeThunks<WriteRecord, void (*)(Buffer&, const void*, InlineRef, bool)>();
+
+    std::vector<Record>     records;
+    std::vector<MergeKey>   keys;       // records w/ a merge key; sorted => last write per key is last in its run
+    Buffer                  scratch;
+    CoalesceStats           last, total;
+public:
+    // Fold buffer contents in place. Leaves the buffer rewound.
+    void coalesce (Buffer& buffer) {
+        records.clear();
+        keys.clear();
+
+        buffer.rewindReadHead();
+        for (Command command; (command = buffer.readNext()) != Command::NONE; ) {
+            InlineRef payload;
+            auto data = readThunks[(size_t)command](buffer, payload);
+            uint64_t key;
+            if (keyThunks[(size_t)command](data, key))
+                keys.push_back({ command, key, records.size() });
+            records.push_back({ command, data, payload, false });
+        }
+
+        // Mark records superseded by a later write w/ the same merge key.
+        last = CoalesceStats();
+        last.passes  = 1;
+        last.records = records.size();
+        std::sort(keys.begin(), keys.end());
+        for (size_t i = 0; i + 1 < keys.size(); ++i) {
+            if (keys[i].sameKey(keys[i + 1])) {
+                records[keys[i].index].folded = true;
+                ++last.folded;
+            }
+        }
+        total.passes  += last.passes;
+        total.records += last.records;
+        total.folded  += last.folded;
+
+        // Nothing folded => keep the original buffer as is.
+        if (last.folded) {
+            bool shared = buffer.isSealed();
+            try {
+                for (auto& record : records)
+                    if (!record.folded)
+                        writeThunks[(size_t)record.command](scratch, record.data, record.payload, shared);
+            } catch (...) {
+                scratch.clear();
+                records.clear();
+                buffer.rewindReadHead();
+                throw;
+            }
+            buffer.swap(scratch);
+            scratch.clear();
+        }
+        records.clear();
+        buffer.rewindReadHead();
+    }
+
+    // Stats for the last coalesce() call (ie. per frame), and cumulative totals.
+    const CoalesceStats& lastStats  () const { return last; }
+    const CoalesceStats& totalStats () const { return total; }
+};
@@ -0,0 +1,306 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "command_buffer.hxx"
+
+//
+// Binary record / replay of CommandBuffer streams.
+//
+// CommandRecorder captures whole buffers (eg. one CommandBuffer<kAppEvent> + one AppClientCommand
+// buffer per frame), tagged w/ a stream id + frame number, and appends them to a file on a
+// background thread. Recording a buffer snapshots its chunks (memcpy of the bytes written, into
+// chunks from the buffer's ChunkPool), so the caller can dispatch / clear / reuse it right away:
+// commands that modify themselves in execute() don't race the writer, and the file gets the
+// buffer as it was when recorded. The calling thread never touches the file.
+//
+// Write errors (eg. a full disk) stop the recording: the file keeps the frames written before the
+// error (replay ignores a truncated last block), and flush() / close() throw std::runtime_error.
+//
+// Only trivially copyable records can be recorded (chunks are written as raw bytes); recording a
+// buffer w/ managed (non-POD) records throws.
+//
+// CommandReplay mmaps a recording and hands out ReplayBuffers that read records in place, w/ the
+// same readNext() / read<T>() / readString() interface as CommandBuffer, so recorded traffic can be
+// fed back through the same CommandSet::dispatch() / visit() path at full speed (no GPU / window
+// needed).
+//
+// File layout (all blocks 16 byte aligned, native endianness; recordings are not portable):
+//
+//      FileHeader
+//      { FrameHeader, { SegmentHeader, data }... }...      // one block per record() call
+//      { IndexEntry... }, IndexFooter                      // frame index, written by close()
+//
+// If a recording was not closed cleanly (no footer), CommandReplay rebuilds the index by scanning
+// frame blocks. Frame + segment headers are bounds checked against the file, so a corrupt recording
+// throws std::runtime_error instead of reading past the mapping.
+//
+
+namespace recording {
+    static constexpr uint32_t FILE_MAGIC   = 0x4345524b;     // "KREC"
+    static constexpr uint32_t FRAME_MAGIC  = 0x4d415246;     // "FRAM"
+    static constexpr uint32_t INDEX_MAGIC  = 0x5844494b;     // "KIDX"
+    static constexpr uint32_t VERSION      = 1;
+    static constexpr size_t   ALIGN        = 16;
+
+    struct FileHeader {
+        uint32_t magic   = FILE_MAGIC;
+        uint32_t version = VERSION;
+        uint64_t reserved = 0;
+    };
+    struct FrameHeader {
+        uint32_t magic        = FRAME_MAGIC;
+        uint32_t stream       = 0;
+        uint64_t frame        = 0;
+        uint32_t segmentCount = 0;
+        uint32_t reserved     = 0;
+        uint64_t blockSize    = 0;   // size of this block (incl. header), for skipping
+    };
+    struct SegmentHeader {
+        uint64_t size     = 0;       // data bytes (data is padded to ALIGN)
+        uint64_t reserved = 0;
+    };
+    struct IndexEntry {
+        uint64_t frame  = 0;
+        uint32_t stream = 0;
+        uint32_t reserved = 0;
+        uint64_t offset = 0;         // file offset of FrameHeader
+        uint64_t reserved2 = 0;
+    };
+    struct IndexFooter {
+        uint64_t count  = 0;         // number of IndexEntries
+        uint64_t offset = 0;         // file offset of first IndexEntry
+        uint32_t magic  = INDEX_MAGIC;
+        uint32_t reserved = 0;
+        uint64_t reserved2 = 0;
+    };
+}; // namespace recording
+
+// Appends recorded buffers to a file on a background writer thread.
+class CommandRecorder {
+public:
+    // Opens (truncates) path. Throws std::runtime_error if the file can't be opened / written.
+    CommandRecorder (const std::string& path);
+    ~CommandRecorder ();    // calls close(); write errors are dropped (call close() to see them)
+
+    CommandRecorder (const CommandRecorder&) = delete;
+    CommandRecorder& operator= (const CommandRecorder&) = delete;
+
+    // Record a buffer (snapshot of its contents; the buffer isn't modified). Any thread.
+    // Throws std::logic_error if the buffer holds managed records (their bytes are heap pointers),
+    // or after close().
+    template <typename E, size_t CHUNK_SIZE>
+    void record (uint32_t stream, uint64_t frame, const CommandBuffer<E, CHUNK_SIZE>& buffer) {
+        if (buffer.hasManagedRecords())
+            throw std::logic_error("Cannot record CommandBuffer containing managed (non-POD) records");
+        Frame f { stream, frame, {}, &releaseChunk<CHUNK_SIZE> };
+        try {
+            buffer.forEachChunk([&f](const uint8_t* data, size_t size) {
+                f.segments.push_back({ nullptr, size });
+                auto chunk = static_cast<uint8_t*>(ChunkPool<CHUNK_SIZE>::instance().acquire());
+                memcpy(chunk, data, size);
+                f.segments.back().data = chunk;
+            });
+        } catch (...) {
+            release(f);
+            throw;
+        }
+        enqueue(std::move(f));
+    }
+
+    // Block until all recorded frames have been written. Throws std::runtime_error if a write
+    // failed.
+    void flush ();
+
+    // Flush, write the frame index + stop the writer thread. Throws std::runtime_error if a write
+    // failed (the index is not written then; replay scans the frames that made it to the file).
+    void close ();
+
+    // Number of bytes written so far (writer thread; approximate).
+    uint64_t bytesWritten () const;
+private:
+    struct Segment {
+        const uint8_t* data;
+        size_t         size;
+    };
+    struct Frame {
+        uint32_t                    stream;
+        uint64_t                    frame;
+        std::vector<Segment>        segments;   // snapshot chunks (from a ChunkPool)
+        void                        (*releaseChunk) (const uint8_t*);
+    };
+    template <size_t CHUNK_SIZE>
+    static void releaseChunk (const uint8_t* chunk) {
+        ChunkPool<CHUNK_SIZE>::instance().release(const_cast<uint8_t*>(chunk));
+    }
+    static void release (Frame& frame);
+    void enqueue (Frame&& frame);
+    bool writeFrame (const Frame& frame);
+    bool write (const void* data, size_t size);
+    void writerLoop ();
+    void throwIfFailed ();
+
+    std::FILE*                          file = nullptr;
+    std::atomic<uint64_t>               offset { 0 };   // written by the writer thread
+    std::vector<recording::IndexEntry>  index;
+
+    std::mutex                          mutex;
+    std::condition_variable             frameQueued;
+    std::condition_variable             queueEmpty;
+    std::deque<Frame>                   queue;
+    size_t                              pending = 0;    // frames queued or being written
+    bool                                closing = false;
+    bool                                failed  = false;    // a write failed; nothing more is written
+    std::thread                         writer;
+};
+
+// View of one recorded buffer (mmapped). Same read interface as CommandBuffer.
+// Valid while the CommandReplay it came from is alive. Records are read in place from a private
+// (copy-on-write) mapping, so commands may modify themselves in execute(); the file is never written.
+template <typename CommandType>
+class ReplayBuffer {
+    struct Segment {
+        const uint8_t* data;
+        size_t         size;
+    };
+    const uint8_t* block    = nullptr;  // first SegmentHeader
+    uint32_t       segments = 0;
+    uint32_t       segment  = 0;        // read cursor (segment index, segment, offset)
+    Segment        current  {};
+    const uint8_t* next     = nullptr;
+    size_t         readHead = 0;
+
+    bool nextSegment () {
+        if (segment == segments) return false;
+        recording::SegmentHeader header;
+        memcpy(&header, next, sizeof(header));
+        current = { next + sizeof(header), header.size };
+        next    = current.data + alignUp(header.size, recording::ALIGN);
+        ++segment;
+        readHead = 0;
+        return true;
+    }
+    template <typename T>
+    static size_t fit (size_t offset, size_t size) {
+        offset = alignUp(offset, alignof(T));
+        return offset + sizeof(T) <= size ? offset : size_t(-1);
+    }
+public:
+    typedef CommandType Command;
+
+    ReplayBuffer () {}
+    ReplayBuffer (const uint8_t* block, uint32_t segments) : block(block), segments(segments) {
+        rewindReadHead();
+    }
+
+    void rewindReadHead () {
+        segment = 0; next = block; current = {}; readHead = 0;
+        nextSegment();
+    }
+    bool empty () const { return segments == 0; }
+
+    // Same semantics as ChunkedForwardList::read(): values that didn't fit in a chunk were written
+    // at the start of the next one.
+    template <typename T>
+    const T* read () {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable records can be replayed");
+        size_t offset;
+        while ((offset = fit<T>(readHead, current.size)) == size_t(-1))
+            if (!nextSegment()) return nullptr;
+        readHead = offset + sizeof(T);
+        return reinterpret_cast<const T*>(current.data + offset);
+    }
+    CommandType readNext () {
+        auto ptr = read<CommandType>();
+        return ptr ? *ptr : CommandType::NONE;
+    }
+    std::string_view readString () {
+        const uint8_t* data;
+        auto header = readInline(data);
+        return header ?
+            std::string_view(reinterpret_cast<const char*>(data), header->length) :
+            std::string_view();
+    }
+    template <typename U>
+    ArrayView<U> readArray () {
+        const uint8_t* data;
+        auto header = readInline(data);
+        if (!header) return {};
+        return { reinterpret_cast<const U*>(data), header->length / sizeof(U) };
+    }
+private:
+    // Segment bounds are checked by CommandReplay; inline headers are checked here.
+    const InlineHeader* readInline (const uint8_t*& data) {
+        auto header = read<InlineHeader>();
+        if (header) {
+            if (!header->align || (header->align & (header->align - 1)))
+                throw std::runtime_error("Corrupt recording: bad inline data alignment");
+            size_t offset = alignUp(readHead, header->align);
+            if (offset > current.size || header->length > current.size - offset)
+                throw std::runtime_error("Corrupt recording: inline data out of bounds");
+            data     = current.data + offset;
+            readHead = offset + header->length;
+        }
+        return header;
+    }
+};
+
+// Memory maps a recording made w/ CommandRecorder.
+class CommandReplay {
+public:
+    // Throws std::runtime_error if the file can't be opened / is not a valid recording.
+    CommandReplay (const std::string& path);
+    ~CommandReplay ();
+
+    CommandReplay (const CommandReplay&) = delete;
+    CommandReplay& operator= (const CommandReplay&) = delete;
+
+    // Frame index (in recording order).
+    size_t size () const { return index.size(); }
+    const recording::IndexEntry& entry (size_t i) const { return index[i]; }
+
+    // Get a reader for the i-th recorded buffer.
+    template <typename E>
+    ReplayBuffer<E> buffer (size_t i) const {
+        recording::FrameHeader header;
+        memcpy(&header, base + index[i].offset, sizeof(header));
+        return ReplayBuffer<E>(base + index[i].offset + sizeof(header), header.segmentCount);
+    }
+
+    // Replay driver: dispatch / visit all recorded buffers for a stream, in recording order.
+    template <typename Set>
+    void dispatchAll (uint32_t stream) const {
+        for (size_t i = 0; i < index.size(); ++i) {
+            if (index[i].stream == stream) {
+                auto buf = buffer<typename Set::Command>(i);
+                Set::dispatch(buf);
+            }
+        }
+    }
+    template <typename Set, typename Visitor>
+    Visitor& visitAll (uint32_t stream, Visitor& visitor) const {
+        for (size_t i = 0; i < index.size(); ++i) {
+            if (index[i].stream == stream) {
+                auto buf = buffer<typename Set::Command>(i);
+                Set::visit(buf, visitor);
+            }
+        }
+        return visitor;
+    }
+private:
+    void buildIndex ();
+    bool validFrame (uint64_t pos) const;
+
+    const uint8_t*                     base = nullptr;
+    size_t                             length = 0;
+    std::vector<recording::IndexEntry> index;
+};
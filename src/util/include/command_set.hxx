@@ -0,0 +1,305 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include "command_buffer.hxx"
+
+//
+// Compile-time command / event type lists for CommandBuffer + CommandStream.
+//
+// CommandSet<E, CommandPair<E::FOO, Foo>, ...> maps enum values to command / event structs, and
+// generates (at compile time):
+// – write() overloads for each struct type (Set::write(buffer, Foo{ ... }))
+// – a constexpr jump table of dispatch thunks, indexed by enum value; dispatching a record is a
+//   single indirect call, and each thunk has its handler (T::execute / visitor.visit(T)) inlined.
+// – size + alignment metadata per enum value (Set::sizeOf[], Set::alignOf[], Set::MAX_SIZE)
+//
+// Exhaustiveness is checked at compile time:
+// – enum values must be unique + cover 1..N, where N = number of pairs (E::NONE = 0 is reserved).
+// – if E defines a trailing E::COUNT value, N must equal COUNT - 1, so adding an enum value w/out
+//   adding it to the CommandSet is a compile error.
+//
+// To implement a Command or Event data structure:
+// – define an enum class w/ NONE = 0, then unique entries for all values, starting at 1
+//   (+ optionally a trailing COUNT value)
+// – define structs w/ command / event data
+// – commands must have a void execute () method; events are passed to visitor.visit(const T&).
+// – a pair may declare an inline payload (string / array data stored after the struct; see
+//   CommandBuffer::writeString() / writeArray()) by its element type:
+//      CommandPair<kExampleCmd::SET_TITLE, SetTitle, char>     => std::string_view payload
+//      CommandPair<kExampleCmd::SET_PATH,  SetPath,  vec2>     => ArrayView<vec2> payload
+//   Those are written w/ Set::write(buffer, SetTitle{ ... }, title), and their handlers take the
+//   payload as well: void execute (std::string_view) / visitor.visit(const SetTitle&, std::string_view).
+//   Payload views point into the buffer (see readString() / readArray()). Structs w/ a payload must
+//   be trivially copyable.
+//
+// Note:
+// – structs may double as both Commands and Events
+// – structs may be reused as backing data type for multiple different command sets;
+//   enum values may not be repeated within one set.
+// – records are read in-place from buffer chunks. Non-POD types (std::string, std::weak_ptr, etc)
+//   are supported by CommandBuffer (see RecordOps in command_buffer.hxx), but not CommandStream /
+//   recordings; prefer inline string / array records where possible.
+//
+// Example:
+//
+//  enum class kExampleCmd { NONE = 0, FOO, BAR, BAZ, COUNT };
+//  namespace ExampleCommand {
+//      struct Foo { ... void execute (); };
+//      struct Bar { ... void execute (); };
+//      struct Baz { ... void execute (); };
+//
+//      typedef CommandSet<kExampleCmd,
+//          CommandPair<kExampleCmd::FOO, Foo>,
+//          CommandPair<kExampleCmd::BAR, Bar>,
+//          CommandPair<kExampleCmd::BAZ, Baz>
+//      > Set;
+//      typedef CommandBuffer<kExampleCmd> CommandBuffer;
+//  }
+//
+//  void pushCommands (ExampleCommand::CommandBuffer& cb) {
+//      ExampleCommand::Set::write(cb, ExampleCommand::Foo{ ... });
+//      ExampleCommand::Set::write(cb, ExampleCommand::Baz{ ... });
+//  }
+//  void runCommands (ExampleCommand::CommandBuffer& cb) {
+//      ExampleCommand::Set::dispatch(cb);      // calls Foo::execute(), Baz::execute()
+//  }
+//
+//  struct MyVisitor {
+//      void visit (const ExampleCommand::Foo& ev) { ... }
+//      void visit (const ExampleCommand::Bar& ev) { ... }
+//      void visit (const ExampleCommand::Baz& ev) { ... }
+//  };
+//  void visitEvents (ExampleCommand::CommandBuffer& cb) {
+//      MyVisitor visitor { ... };
+//      ExampleCommand::Set::visit(cb, visitor); // missing visit() methods => compile errors
+//  }
+//
+
+// Maps an enum value to its command / event struct type, and optionally the element type of an
+// inline payload (void => none).
+template <auto VALUE, typename T, typename Inline = void>
+struct CommandPair {
+    typedef decltype(VALUE) Command;
+    typedef T               Type;
+    typedef Inline          InlineType;
+    static constexpr Command value = VALUE;
+
+    static_assert(std::is_void<Inline>::value || std::is_trivially_copyable<T>::value,
+        "Records w/ an inline payload must be trivially copyable");
+};
+
+// Type erased reference to a record's inline payload (size in elements); see CommandSet::readRecord().
+struct InlineRef {
+    const void* data = nullptr;
+    size_t      size = 0;
+};
+
+namespace detail {
+    // Detects a trailing E::COUNT enum value.
+    template <typename E, typename = void>
+    struct EnumCount : std::integral_constant<size_t, 0> {};
+    template <typename E>
+    struct EnumCount<E, std::void_t<decltype(E::COUNT)>> : std::integral_constant<size_t, (size_t)E::COUNT> {};
+
+    // View type for an inline payload of U elements.
+    template <typename U> struct InlineView       { typedef ArrayView<U>     type; };
+    template <>           struct InlineView<char> { typedef std::string_view type; };
+
+    // Inline payload element type for T in Pairs (void if T has none).
+    template <typename T, typename... Pairs>
+    struct InlineOf { typedef void type; };
+    template <typename T, typename Pair, typename... Pairs>
+    struct InlineOf<T, Pair, Pairs...> {
+        typedef typename std::conditional<std::is_same<T, typename Pair::Type>::value,
+            typename Pair::InlineType, typename InlineOf<T, Pairs...>::type>::type type;
+    };
+
+    // Provides Set::write() for a single pair.
+    template <typename Pair, typename Inline = typename Pair::InlineType>
+    struct CommandWriter {
+        typedef typename Pair::Type               Type;
+        typedef typename InlineView<Inline>::type View;
+
+        template <typename Buffer>
+        static void write (Buffer& buffer, const Type& value, View payload) {
+            if constexpr (std::is_same<Inline, char>::value)
+                buffer.writeString(Pair::value, value, payload);
+            else
+                buffer.writeArray(Pair::value, value, payload.data, payload.size);
+        }
+    };
+    template <typename Pair>
+    struct CommandWriter<Pair, void> {
+        template <typename Buffer>
+        static void write (Buffer& buffer, const typename Pair::Type& value) {
+            buffer.write(Pair::value, value);
+        }
+        template <typename Buffer>
+        static void write (Buffer& buffer, typename Pair::Type&& value) {
+            buffer.write(Pair::value, std::move(value));
+        }
+    };
+
+    // Rewinds CommandBuffers before dispatch. Streams (no rewindReadHead()) are read from where they are.
+    template <typename Buffer>
+    static auto rewind (Buffer& buffer, int) -> decltype(buffer.rewindReadHead(), void()) {
+        buffer.rewindReadHead();
+    }
+    template <typename Buffer>
+    static void rewind (Buffer&, long) {}
+}; // namespace detail
+
+template <typename E, typename... Pairs>
+struct CommandSet : public detail::CommandWriter<Pairs>... {
+    typedef E Command;
+    static constexpr size_t COUNT = sizeof...(Pairs);
+
+    using detail::CommandWriter<Pairs>::write...;
+
+private:
+    static constexpr bool isExhaustive () {
+        constexpr size_t values[] = { (size_t)Pairs::value... };
+        bool seen[COUNT + 1] {};
+        for (auto v : values) {
+            if (v < 1 || v > COUNT || seen[v]) return false;
+            seen[v] = true;
+        }
+        return true;
+    }
+    static_assert(COUNT > 0, "Empty CommandSet");
+    static_assert((std::is_same<typename Pairs::Command, E>::value && ...),
+        "CommandSet pairs must all use the same enum type");
+    static_assert(isExhaustive(),
+        "CommandSet enum values must be unique + cover 1..N (NONE = 0 is reserved)");
+    static_assert(detail::EnumCount<E>::value == 0 || detail::EnumCount<E>::value == COUNT + 1,
+        "Missing command(s): CommandSet does not cover all values up to E::COUNT");
+
+    static constexpr std::array<size_t, COUNT + 1> makeSizes () {
+        std::array<size_t, COUNT + 1> table {};
+        ((table[(size_t)Pairs::value] = sizeof(typename Pairs::Type)), ...);
+        return table;
+    }
+    static constexpr std::array<size_t, COUNT + 1> makeAligns () {
+        std::array<size_t, COUNT + 1> table {};
+        ((table[(size_t)Pairs::value] = alignof(typename Pairs::Type)), ...);
+        return table;
+    }
+
+    // Dispatch thunks. Records are read in place, and commands execute() on the chunk memory
+    // (owned by the buffer, and never actually const).
+    template <typename Buffer, typename T>
+    static void dispatchOne (Buffer& buffer) {
+        InlineRef payload;
+        auto value = const_cast<T*>(readRecord<T>(buffer, payload));
+        if constexpr (HasInline<T>::value)
+            value->execute(payloadOf<T>(payload));
+        else
+            value->execute();
+    }
+    template <typename Buffer, typename Visitor, typename T>
+    static void visitOne (Buffer& buffer, Visitor& visitor) {
+        InlineRef payload;
+        auto value = readRecord<T>(buffer, payload);
+        if constexpr (HasInline<T>::value)
+            visitor.visit(*value, payloadOf<T>(payload));
+        else
+            visitor.visit(*value);
+    }
+
+    template <typename Buffer>
+    struct DispatchTable {
+        typedef void (*Thunk)(Buffer&);
+        static constexpr std::array<Thunk, COUNT + 1> make () {
+            std::array<Thunk, COUNT + 1> table {};
+            ((table[(size_t)Pairs::value] = &dispatchOne<Buffer, typename Pairs::Type>), ...);
+            return table;
+        }
+        static constexpr std::array<Thunk, COUNT + 1> thunks = make();
+    };
+    template <typename Buffer, typename Visitor>
+    struct VisitTable {
+        typedef void (*Thunk)(Buffer&, Visitor&);
+        static constexpr std::array<Thunk, COUNT + 1> make () {
+            std::array<Thunk, COUNT + 1> table {};
+            ((table[(size_t)Pairs::value] = &visitOne<Buffer, Visitor, typename Pairs::Type>), ...);
+            return table;
+        }
+        static constexpr std::array<Thunk, COUNT + 1> thunks = make();
+    };
+
+public:
+    // Builds a table indexed by enum value, w/ table[value] = &Fn::template apply<T> for each pair.
+    // Used to implement passes over buffers outside of CommandSet (eg. CommandCoalescer).
+    template <typename Fn, typename Thunk>
+    static constexpr std::array<Thunk, COUNT + 1> makeThunks () {
+        std::array<Thunk, COUNT + 1> table {};
+        ((table[(size_t)Pairs::value] = &Fn::template apply<typename Pairs::Type>), ...);
+        return table;
+    }
+
+    // Inline payload element type declared for T (void => none), and the view type passed to its
+    // handlers (std::string_view for char, ArrayView<U> otherwise).
+    template <typename T>
+    using InlineOf = typename detail::InlineOf<T, Pairs...>::type;
+    template <typename T>
+    using HasInline = std::integral_constant<bool, !std::is_void<InlineOf<T>>::value>;
+    template <typename T>
+    using PayloadOf = typename detail::InlineView<InlineOf<T>>::type;
+
+    // Read the data for the command returned by readNext(), incl. its inline payload, if T declares
+    // one. Passes over buffers outside of CommandSet must read records w/ this, not read<T>(), or
+    // they'll lose sync w/ the buffer on records w/ a payload.
+    template <typename T, typename Buffer>
+    static const T* readRecord (Buffer& buffer, InlineRef& payload) {
+        auto value = buffer.template read<T>();
+        if constexpr (HasInline<T>::value) {
+            if constexpr (std::is_same<InlineOf<T>, char>::value) {
+                auto str = buffer.readString();
+                payload  = { str.data(), str.size() };
+            } else {
+                auto array = buffer.template readArray<InlineOf<T>>();
+                payload    = { array.data, array.size };
+            }
+        }
+        return value;
+    }
+    template <typename T>
+    static PayloadOf<T> payloadOf (InlineRef payload) {
+        static_assert(HasInline<T>::value, "T has no inline payload");
+        return { static_cast<const typename PayloadOf<T>::value_type*>(payload.data), payload.size };
+    }
+
+    // Size / alignment of the struct mapped to each enum value (index 0 = NONE = 0).
+    static constexpr std::array<size_t, COUNT + 1> sizeOf  = makeSizes();
+    static constexpr std::array<size_t, COUNT + 1> alignOf = makeAligns();
+    static constexpr size_t MAX_SIZE = std::max({ sizeof(typename Pairs::Type)... });
+
+    // Enum value for a struct type (compile error if T is not in this set).
+    template <typename T>
+    static constexpr E idOf () {
+        static_assert((std::is_same<T, typename Pairs::Type>::value || ...), "Type not in CommandSet");
+        E id = E::NONE;
+        ((id = std::is_same<T, typename Pairs::Type>::value ? Pairs::value : id), ...);
+        return id;
+    }
+
+    // Execute all commands in a CommandBuffer (from the start) or CommandStream (all published).
+    template <typename Buffer>
+    static void dispatch (Buffer& buffer) {
+        detail::rewind(buffer, 0);
+        for (E command; (command = buffer.readNext()) != E::NONE; )
+            DispatchTable<Buffer>::thunks[(size_t)command](buffer);
+    }
+
+    // Pass all events in a CommandBuffer / CommandStream to visitor.visit(const T&).
+    template <typename Buffer, typename Visitor>
+    static Visitor& visit (Buffer& buffer, Visitor& visitor) {
+        detail::rewind(buffer, 0);
+        for (E command; (command = buffer.readNext()) != E::NONE; )
+            VisitTable<Buffer, Visitor>::thunks[(size_t)command](buffer, visitor);
+        return visitor;
+    }
+};
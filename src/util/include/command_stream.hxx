@@ -0,0 +1,212 @@
+#pragma once
+#include <atomic>
+#include <stdexcept>
+#include "command_buffer.hxx"
+
+//
+// Single producer / single consumer streaming variant of CommandBuffer.
+//
+// CommandBuffer is write-all, rewindReadHead(), then read-all. CommandStream lets one thread append
+// commands while another thread consumes them:
+//
+// – The producer writes records into its current chunk, and publishes them with a release store of
+//   the chunk's committed size on flush() (or when the chunk fills up + a new one is linked in).
+// – The consumer reads up to the committed size (acquire), and follows / recycles full chunks as
+//   it goes. readNext() returns NONE when it has caught up with the producer, NOT at end of stream;
+//   call it again later (eg. next loop iteration) to pick up newly published commands.
+//
+// Chunks use the same layout as ChunkedForwardList (next ptr + size header, then data) and come
+// from the same ChunkPool<CHUNK_SIZE>, so streams + buffers share recycled memory.
+//
+// Unlike CommandBuffer, a record (command + data) never spans two chunks, so a published command is
+// always readable together w/ its data.
+//
+// Thread rules:
+// – write() / flush() may only be called from a single producer thread.
+// – readNext() / read() may only be called from a single consumer thread.
+// – pointers returned from read() are valid until the next call to readNext().
+//
+template <class CommandType, size_t CHUNK_SIZE = DEFAULT_COMMAND_CHUNK_SIZE>
+class CommandStream {
+    typedef ChunkedForwardList<CHUNK_SIZE> List;
+    typedef typename List::Chunk Layout;
+    static constexpr size_t SIZE = ChunkedForwardList<CHUNK_SIZE>::SIZE;
+
+    struct Chunk {
+        std::atomic<Chunk*> next { nullptr };
+        std::atomic<size_t> committed { 0 };    // published size (bytes readable by consumer)
+        size_t              refs = 1;           // unused; matches ChunkedForwardList::Chunk
+        size_t              managed = 0;        // unused; matches ChunkedForwardList::Chunk
+        alignas(std::max_align_t) uint8_t data[SIZE];
+
+        static void* operator new    (size_t) { return ChunkPool<CHUNK_SIZE>::instance().acquire(); }
+        static void  operator delete (void* ptr) { ChunkPool<CHUNK_SIZE>::instance().release(ptr); }
+    };
+    static_assert(sizeof(Chunk) == sizeof(Layout), "CommandStream chunk layout must match ChunkedForwardList");
+
+    // Producer state
+    alignas(64) Chunk* writeChunk;
+    size_t             writeHead = 0;
+
+    // Consumer state
+    alignas(64) Chunk* readChunk;
+    size_t             readHead = 0;
+
+    // Offsets of one record: command, [fixed size data], [InlineHeader + inline data].
+    struct RecordLayout {
+        size_t command, data, header, bytes, end;
+    };
+
+    // Lay out a record at / after offset. Returns false if it doesn't fit in the rest of the chunk.
+    static bool layoutRecord (size_t offset, size_t dataSize, size_t dataAlign,
+        size_t inlineLength, size_t inlineAlign, RecordLayout& r)
+    {
+        r.command = Layout::template fit<CommandType>(offset);
+        if (r.command == SIZE) return false;
+        r.data = r.end = alignUp(r.command + sizeof(CommandType), dataAlign);
+        r.end += dataSize;
+        if (inlineAlign) {
+            r.header = alignUp(r.end, alignof(InlineHeader));
+            r.bytes  = alignUp(r.header + sizeof(InlineHeader), inlineAlign);
+            r.end    = r.bytes + inlineLength;
+        }
+        return r.end <= SIZE;
+    }
+
+    // Write a record (dataSize == 0 => no fixed data, inlineAlign == 0 => no inline data).
+    void writeRecord (CommandType command, const void* data, size_t dataSize, size_t dataAlign,
+        const void* bytes, uint32_t inlineLength, uint32_t inlineAlign)
+    {
+        RecordLayout r {};
+        if (!layoutRecord(writeHead, dataSize, dataAlign, inlineLength, inlineAlign, r)) {
+            if (!layoutRecord(0, dataSize, dataAlign, inlineLength, inlineAlign, r))
+                throw std::length_error("Record too large for command stream chunk");
+
+            // Publish remainder of this chunk, then link in (+ publish) a new one.
+            auto chunk = new Chunk();
+            writeChunk->committed.store(writeHead, std::memory_order_release);
+            writeChunk->next.store(chunk, std::memory_order_release);
+            writeChunk = chunk;
+            layoutRecord(0, dataSize, dataAlign, inlineLength, inlineAlign, r);
+        }
+        memcpy(&writeChunk->data[r.command], &command, sizeof(CommandType));
+        if (dataSize)
+            memcpy(&writeChunk->data[r.data], data, dataSize);
+        if (inlineAlign) {
+            InlineHeader header { inlineLength, inlineAlign };
+            memcpy(&writeChunk->data[r.header], &header, sizeof(InlineHeader));
+            memcpy(&writeChunk->data[r.bytes], bytes, inlineLength);
+        }
+        writeHead = r.end;
+    }
+
+    const uint8_t* readInline (uint32_t& length, uint32_t& align) {
+        InlineHeader header;
+        size_t offset = alignUp(readHead, alignof(InlineHeader));
+        memcpy(&header, &readChunk->data[offset], sizeof(InlineHeader));
+        offset   = alignUp(offset + sizeof(InlineHeader), header.align);
+        readHead = offset + header.length;
+        length   = header.length;
+        align    = header.align;
+        return &readChunk->data[offset];
+    }
+public:
+    typedef CommandType Command;
+
+    CommandStream () : writeChunk(new Chunk()), readChunk(writeChunk) {}
+    CommandStream (const CommandStream&) = delete;
+    CommandStream& operator= (const CommandStream&) = delete;
+
+    // Must not be destroyed while either thread is still using it.
+    ~CommandStream () {
+        for (auto chunk = readChunk; chunk; ) {
+            auto next = chunk->next.load(std::memory_order_relaxed);
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    //
+    // Producer methods
+    //
+
+    // Records are handed to another thread as raw bytes, so values must be trivially copyable.
+    template <typename T>
+    void write (CommandType command, const T& data) {
+        static_assert(std::is_trivially_copyable<T>::value, "CommandStream values must be trivially copyable");
+        writeRecord(command, &data, sizeof(T), alignof(T), nullptr, 0, 0);
+    }
+
+    // Variable length records (see CommandBuffer::writeString() / writeArray()). A record (command,
+    // data + inline data) must fit in one chunk, else std::length_error (nothing is written).
+    void writeString (CommandType command, std::string_view str) {
+        writeRecord(command, nullptr, 0, 1, str.data(), List::inlineLength(str.size(), 1, 1), 1);
+    }
+    template <typename T>
+    void writeString (CommandType command, const T& data, std::string_view str) {
+        writeRecord(command, &data, sizeof(T), alignof(T), str.data(), List::inlineLength(str.size(), 1, 1), 1);
+    }
+    template <typename U>
+    void writeArray (CommandType command, const U* values, size_t count) {
+        writeRecord(command, nullptr, 0, 1, values, List::inlineLength(count, sizeof(U), alignof(U)), alignof(U));
+    }
+    template <typename T, typename U>
+    void writeArray (CommandType command, const T& data, const U* values, size_t count) {
+        writeRecord(command, &data, sizeof(T), alignof(T), values, List::inlineLength(count, sizeof(U), alignof(U)), alignof(U));
+    }
+
+    // Publish all commands written so far to the consumer.
+    void flush () {
+        writeChunk->committed.store(writeHead, std::memory_order_release);
+    }
+
+    //
+    // Consumer methods
+    //
+
+    // Returns next published command, or CommandType::NONE if no more commands are available (yet).
+    CommandType readNext () {
+        while (true) {
+            size_t committed = readChunk->committed.load(std::memory_order_acquire);
+            size_t offset    = Layout::template fit<CommandType>(readHead);
+            if (offset < committed) {
+                CommandType command;
+                memcpy(&command, &readChunk->data[offset], sizeof(CommandType));
+                readHead = offset + sizeof(CommandType);
+                return command;
+            }
+            // Caught up w/ this chunk; move on iff the producer has moved on. committed is final
+            // once next is set, so recheck it before dropping the chunk.
+            auto next = readChunk->next.load(std::memory_order_acquire);
+            if (!next)
+                return CommandType::NONE;
+            if (offset < readChunk->committed.load(std::memory_order_acquire))
+                continue;
+            delete readChunk;
+            readChunk = next;
+            readHead  = 0;
+        }
+    }
+
+    // Read data for the command returned by readNext().
+    template <typename T>
+    const T* read () {
+        size_t offset = alignUp(readHead, alignof(T));
+        readHead = offset + sizeof(T);
+        return reinterpret_cast<const T*>(&readChunk->data[offset]);
+    }
+
+    // Read inline data for the current command. Views are valid until the next call to readNext().
+    std::string_view readString () {
+        uint32_t length, align;
+        auto data = readInline(length, align);
+        return std::string_view(reinterpret_cast<const char*>(data), length);
+    }
+    template <typename U>
+    ArrayView<U> readArray () {
+        uint32_t length, align;
+        auto data = readInline(length, align);
+        assert(align == alignof(U) && length % sizeof(U) == 0);
+        return { reinterpret_cast<const U*>(data), length / sizeof(U) };
+    }
+};
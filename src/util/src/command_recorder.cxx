@@ -0,0 +1,227 @@
+#include "../include/command_recorder.hxx"
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace recording;
+
+static const uint8_t PADDING[ALIGN] = {};
+
+//
+// CommandRecorder
+//
+
+CommandRecorder::CommandRecorder (const std::string& path)
+    : file(std::fopen(path.c_str(), "wb"))
+{
+    if (!file)
+        throw std::runtime_error("Could not open recording file '" + path + "'");
+    FileHeader header;
+    if (!write(&header, sizeof(header))) {
+        std::fclose(file);
+        throw std::runtime_error("Could not write recording file '" + path + "'");
+    }
+    offset.store(sizeof(header), std::memory_order_relaxed);
+    writer = std::thread(&CommandRecorder::writerLoop, this);
+}
+CommandRecorder::~CommandRecorder () {
+    try {
+        close();
+    } catch (const std::runtime_error&) {}
+}
+
+void CommandRecorder::release (Frame& frame) {
+    for (auto& segment : frame.segments)
+        if (segment.data)
+            frame.releaseChunk(segment.data);
+    frame.segments.clear();
+}
+void CommandRecorder::enqueue (Frame&& frame) {
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        if (!closing) {
+            queue.push_back(std::move(frame));
+            ++pending;
+            frameQueued.notify_one();
+            return;
+        }
+    }
+    release(frame);
+    throw std::logic_error("CommandRecorder: record() after close()");
+}
+void CommandRecorder::throwIfFailed () {
+    if (failed)
+        throw std::runtime_error("CommandRecorder: write to recording file failed");
+}
+void CommandRecorder::flush () {
+    std::unique_lock<std::mutex> lock (mutex);
+    queueEmpty.wait(lock, [this](){ return pending == 0; });
+    throwIfFailed();
+}
+void CommandRecorder::close () {
+    if (!writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        closing = true;
+    }
+    frameQueued.notify_one();
+    writer.join();
+
+    // Write frame index + footer (unless the recording is already truncated).
+    if (!failed) {
+        IndexFooter footer;
+        footer.count  = index.size();
+        footer.offset = offset.load(std::memory_order_relaxed);
+        failed = !write(index.data(), index.size() * sizeof(IndexEntry)) ||
+                 !write(&footer, sizeof(footer));
+    }
+    if (std::fclose(file) != 0)
+        failed = true;
+    file = nullptr;
+    throwIfFailed();
+}
+uint64_t CommandRecorder::bytesWritten () const {
+    return offset.load(std::memory_order_relaxed);
+}
+
+bool CommandRecorder::write (const void* data, size_t size) {
+    return !size || std::fwrite(data, 1, size, file) == size;
+}
+
+// Runs on the writer thread. Returns false if a write failed.
+bool CommandRecorder::writeFrame (const Frame& frame) {
+    FrameHeader header;
+    header.stream       = frame.stream;
+    header.frame        = frame.frame;
+    header.segmentCount = (uint32_t)frame.segments.size();
+    header.blockSize    = sizeof(header);
+    for (auto& segment : frame.segments)
+        header.blockSize += sizeof(SegmentHeader) + alignUp(segment.size, ALIGN);
+
+    auto start = offset.load(std::memory_order_relaxed);
+    if (!write(&header, sizeof(header)))
+        return false;
+    for (auto& segment : frame.segments) {
+        SegmentHeader sh;
+        sh.size = segment.size;
+        if (!write(&sh, sizeof(sh)) ||
+            !write(segment.data, segment.size) ||
+            !write(PADDING, alignUp(segment.size, ALIGN) - segment.size))
+            return false;
+    }
+    index.push_back({ frame.frame, frame.stream, 0, start, 0 });
+    offset.store(start + header.blockSize, std::memory_order_relaxed);
+    return true;
+}
+void CommandRecorder::writerLoop () {
+    std::unique_lock<std::mutex> lock (mutex);
+    while (true) {
+        frameQueued.wait(lock, [this](){ return closing || !queue.empty(); });
+        while (!queue.empty()) {
+            Frame frame = std::move(queue.front());
+            queue.pop_front();
+            bool skip = failed;     // after a failed write, frames are dropped (file is truncated)
+            lock.unlock();
+            bool ok = skip || writeFrame(frame);
+            release(frame);         // snapshot chunks back to the chunk pool
+            lock.lock();
+            failed = failed || !ok;
+            --pending;
+        }
+        if (!failed && std::fflush(file) != 0)
+            failed = true;
+        queueEmpty.notify_all();
+        if (closing)
+            return;
+    }
+}
+
+//
+// CommandReplay
+//
+
+CommandReplay::CommandReplay (const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Could not open recording file '" + path + "'");
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Invalid recording file '" + path + "'");
+    }
+    length = (size_t)st.st_size;
+    // Writable, private mapping: dispatch runs execute() on records in place (see ReplayBuffer).
+    auto ptr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+        throw std::runtime_error("Could not mmap recording file '" + path + "'");
+    base = static_cast<const uint8_t*>(ptr);
+
+    FileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (header.magic != FILE_MAGIC || header.version != VERSION) {
+        ::munmap(const_cast<uint8_t*>(base), length);
+        throw std::runtime_error("Invalid recording file '" + path + "'");
+    }
+    try {
+        buildIndex();
+    } catch (...) {
+        ::munmap(const_cast<uint8_t*>(base), length);
+        throw;
+    }
+}
+CommandReplay::~CommandReplay () {
+    if (base)
+        ::munmap(const_cast<uint8_t*>(base), length);
+}
+
+// Does a complete, well formed frame block start at pos?
+bool CommandReplay::validFrame (uint64_t pos) const {
+    if (pos < sizeof(FileHeader) || pos % ALIGN || pos > length || length - pos < sizeof(FrameHeader))
+        return false;
+    FrameHeader header;
+    memcpy(&header, base + pos, sizeof(header));
+    if (header.magic != FRAME_MAGIC || header.blockSize < sizeof(header) || header.blockSize > length - pos)
+        return false;
+    uint64_t at = sizeof(header);
+    for (uint32_t i = 0; i < header.segmentCount; ++i) {
+        if (header.blockSize - at < sizeof(SegmentHeader))
+            return false;
+        SegmentHeader segment;
+        memcpy(&segment, base + pos + at, sizeof(segment));
+        at += sizeof(segment);
+        if (segment.size > header.blockSize - at || alignUp(segment.size, ALIGN) > header.blockSize - at)
+            return false;
+        at += alignUp(segment.size, ALIGN);
+    }
+    return true;
+}
+void CommandReplay::buildIndex () {
+    // Use the stored index if the recording was closed cleanly...
+    if (length >= sizeof(FileHeader) + sizeof(IndexFooter)) {
+        IndexFooter footer;
+        memcpy(&footer, base + length - sizeof(footer), sizeof(footer));
+        size_t maxCount = (length - sizeof(FileHeader) - sizeof(footer)) / sizeof(IndexEntry);
+        if (footer.magic == INDEX_MAGIC && footer.count <= maxCount &&
+            footer.offset == length - sizeof(footer) - footer.count * sizeof(IndexEntry))
+        {
+            index.resize(footer.count);
+            if (footer.count)
+                memcpy(index.data(), base + footer.offset, footer.count * sizeof(IndexEntry));
+            for (auto& entry : index)
+                if (entry.offset >= footer.offset || !validFrame(entry.offset))
+                    throw std::runtime_error("Corrupt recording: bad frame index entry");
+            return;
+        }
+    }
+    // ...otherwise scan frame blocks (ignoring a truncated / corrupt last block).
+    for (size_t pos = sizeof(FileHeader); validFrame(pos); ) {
+        FrameHeader header;
+        memcpy(&header, base + pos, sizeof(header));
+        index.push_back({ header.frame, header.stream, 0, pos, 0 });
+        pos += header.blockSize;
+    }
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "command_batch.hxx"
+
+enum class kBatchCmd { NONE = 0, DRAW, RESIZE, TITLE, SWAP, COUNT };
+
+namespace {     // test command types (other tests define commands w/ the same names)
+
+std::vector<std::string> executed;
+
+struct Draw {           // batched
+    int id;
+    static void executeBatch (ArrayView<const Draw*> commands) {
+        std::string ids;
+        for (auto command : commands)
+            ids += (ids.empty() ? "" : ",") + std::to_string(command->id);
+        executed.push_back("draw [" + ids + "]");
+    }
+};
+struct Resize {
+    int id;
+    void execute () { executed.push_back("resize " + std::to_string(id)); }
+};
+struct Title {
+    int id;
+    void execute (std::string_view title) { executed.push_back("title " + std::to_string(id) + "=" + std::string(title)); }
+};
+struct Swap {
+    int id;
+    void execute () { executed.push_back("swap " + std::to_string(id)); }
+};
+
+}; // namespace
+
+typedef CommandSet<kBatchCmd,
+    CommandPair<kBatchCmd::DRAW,   Draw>,
+    CommandPair<kBatchCmd::RESIZE, Resize>,
+    CommandPair<kBatchCmd::TITLE,  Title, char>,
+    CommandPair<kBatchCmd::SWAP,   Swap>
+> BatchSet;
+typedef CommandBuffer<kBatchCmd, 256> BatchBuffer;      // small chunks: tests span several
+typedef BatchDispatcher<BatchSet, BatchBuffer> Batcher;
+
+static BatchBuffer makeFrame () {
+    BatchBuffer buffer;
+    BatchSet::write(buffer, Swap { 0 });
+    BatchSet::write(buffer, Draw { 1 });
+    BatchSet::write(buffer, Resize { 2 });
+    BatchSet::write(buffer, Title { 3 }, "a");
+    BatchSet::write(buffer, Draw { 4 });
+    BatchSet::write(buffer, Resize { 5 });
+    BatchSet::write(buffer, Title { 6 }, "b");
+    BatchSet::write(buffer, Draw { 7 });
+    return buffer;
+}
+
+TEST(BatchDispatcher, GroupsByTypeInEnumOrder) {
+    auto buffer = makeFrame();
+    Batcher batcher;
+    for (int pass = 0; pass < 2; ++pass) {     // scratch storage is reused
+        executed.clear();
+        batcher.dispatch(buffer);
+        EXPECT_EQ(executed, std::vector<std::string>({
+            "draw [1,4,7]", "resize 2", "resize 5", "title 3=a", "title 6=b", "swap 0" }));
+    }
+}
+
+TEST(BatchDispatcher, GroupsByKeyThenType) {
+    auto buffer = makeFrame();
+    Batcher batcher;
+    executed.clear();
+    batcher.dispatch(buffer, [](kBatchCmd command, const void*) {
+        return command == kBatchCmd::SWAP ? uint64_t(2) : command == kBatchCmd::DRAW ? uint64_t(1) : uint64_t(0);
+    });
+    EXPECT_EQ(executed, std::vector<std::string>({
+        "resize 2", "resize 5", "title 3=a", "title 6=b", "draw [1,4,7]", "swap 0" }));
+}
+
+TEST(BatchDispatcher, KeysSplitBatchesAndKeepOrderWithinKey) {
+    // Wide keys (several radix passes); same-typed records w/ the same key keep buffer order.
+    BatchBuffer buffer;
+    std::vector<uint64_t> keys = { 1ull << 40, 7, 1ull << 40, 300, 7, 1ull << 40 };
+    for (int i = 0; i < (int)keys.size(); ++i)
+        BatchSet::write(buffer, Draw { i });
+    BatchSet::write(buffer, Resize { 9 });
+
+    Batcher batcher;
+    executed.clear();
+    batcher.dispatch(buffer, [&keys](kBatchCmd command, const void* data) {
+        return command == kBatchCmd::DRAW ? keys[static_cast<const Draw*>(data)->id] : uint64_t(300);
+    });
+    EXPECT_EQ(executed, std::vector<std::string>({
+        "draw [1,4]", "draw [3]", "resize 9", "draw [0,2,5]" }));
+}
+
+TEST(BatchDispatcher, EmptyBuffer) {
+    BatchBuffer buffer;
+    Batcher batcher;
+    executed.clear();
+    batcher.dispatch(buffer);
+    batcher.dispatch(buffer, [](kBatchCmd, const void*) { return uint64_t(1); });
+    EXPECT_TRUE(executed.empty());
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "command_buffer.hxx"
+#include "command_stream.hxx"
+
+enum class kTestCmd { NONE = 0, VALUE, NAME, COUNT };
+
+typedef CommandBuffer<kTestCmd, 256> TestBuffer;    // small chunks: tests span several
+
+static std::vector<int> readValues (TestBuffer buffer) {
+    std::vector<int> values;
+    buffer.rewindReadHead();
+    for (kTestCmd command; (command = buffer.readNext()) != kTestCmd::NONE; ) {
+        EXPECT_EQ(command, kTestCmd::VALUE);
+        values.push_back(*buffer.read<int>());
+    }
+    return values;
+}
+static TestBuffer makeBuffer (int count) {
+    TestBuffer buffer;
+    for (int i = 0; i < count; ++i)
+        buffer.write(kTestCmd::VALUE, i);
+    return buffer;
+}
+static std::vector<int> range (int count) {
+    std::vector<int> values;
+    for (int i = 0; i < count; ++i)
+        values.push_back(i);
+    return values;
+}
+
+TEST(CommandBuffer, ReadsBackWhatWasWritten) {
+    TestBuffer buffer;
+    buffer.write(kTestCmd::VALUE, 42);
+    buffer.writeString(kTestCmd::NAME, 7, "hello");
+    buffer.write(kTestCmd::NAME, std::string("managed"));
+
+    EXPECT_EQ(buffer.readNext(), kTestCmd::VALUE);
+    EXPECT_EQ(*buffer.read<int>(), 42);
+    EXPECT_EQ(buffer.readNext(), kTestCmd::NAME);
+    EXPECT_EQ(*buffer.read<int>(), 7);
+    EXPECT_EQ(buffer.readString(), "hello");
+    EXPECT_EQ(buffer.readNext(), kTestCmd::NAME);
+    EXPECT_EQ(*buffer.read<std::string>(), "managed");
+    EXPECT_EQ(buffer.readNext(), kTestCmd::NONE);
+}
+
+TEST(CommandBuffer, UnsealedCopiesAreDeep) {
+    auto buffer = makeBuffer(100);
+    TestBuffer copy (buffer);
+    copy.write(kTestCmd::VALUE, 100);
+    EXPECT_EQ(readValues(buffer), range(100));
+    EXPECT_EQ(readValues(copy), range(101));
+}
+
+TEST(CommandBuffer, SealedCopiesShareChunks) {
+    auto buffer = makeBuffer(200);
+    buffer.seal();
+    auto before = TestBuffer::poolStats();
+
+    std::vector<TestBuffer> copies (8, buffer);
+    auto after = TestBuffer::poolStats();
+    EXPECT_EQ(after.misses + after.hits, before.misses + before.hits);     // no chunks taken
+    for (auto& copy : copies) {
+        EXPECT_TRUE(copy.isSealed());
+        EXPECT_EQ(readValues(copy), range(200));
+    }
+}
+
+TEST(CommandBuffer, WritingToSealedCopyIsCopyOnWrite) {
+    auto buffer = makeBuffer(200);
+    buffer.seal();
+    TestBuffer copy (buffer);
+
+    copy.write(kTestCmd::VALUE, 200);
+    EXPECT_FALSE(copy.isSealed());
+    EXPECT_TRUE(buffer.isSealed());
+    EXPECT_EQ(readValues(copy), range(201));
+    EXPECT_EQ(readValues(buffer), range(200));
+
+    // Clearing a shared copy leaves the others intact.
+    TestBuffer other (buffer);
+    other.clear();
+    EXPECT_TRUE(other.empty());
+    EXPECT_EQ(readValues(buffer), range(200));
+}
+
+TEST(CommandBuffer, LastOwnerReleasesSharedChunks) {
+    auto shared = std::make_shared<int>(1);
+    {
+        TestBuffer buffer;
+        for (int i = 0; i < 50; ++i)
+            buffer.write(kTestCmd::NAME, shared);
+        buffer.seal();
+        TestBuffer copy (buffer);
+        EXPECT_EQ(shared.use_count(), 51);
+        buffer.clear();
+        EXPECT_EQ(shared.use_count(), 51);     // copy still holds the chain
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(CommandBuffer, SealedCopiesReadConcurrently) {
+    auto buffer = makeBuffer(5000);
+    buffer.seal();
+    std::vector<std::thread> readers;
+    std::vector<int> ok (4);
+    for (size_t i = 0; i < ok.size(); ++i) {
+        readers.emplace_back([&ok, i, copy = buffer]() mutable {
+            ok[i] = readValues(copy) == range(5000);
+        });
+    }
+    for (auto& reader : readers)
+        reader.join();
+    for (size_t i = 0; i < ok.size(); ++i)
+        EXPECT_TRUE(ok[i]);
+}
+
+TEST(CommandBuffer, MoveOnlyRecordsCantBeCopied) {
+    TestBuffer buffer;
+    buffer.write(kTestCmd::VALUE, std::unique_ptr<int>(new int(1)));
+    EXPECT_THROW(TestBuffer copy (buffer), std::logic_error);
+    buffer.seal();
+    TestBuffer shared (buffer);     // sealed: shares, no copy
+    EXPECT_THROW(shared.write(kTestCmd::VALUE, 2), std::logic_error);
+}
+
+TEST(CommandBuffer, OversizedInlineDataThrows) {
+    TestBuffer buffer;
+    buffer.write(kTestCmd::VALUE, 1);
+    std::string text (1000, 'x');
+    std::vector<double> values (1000);
+    EXPECT_THROW(buffer.writeString(kTestCmd::NAME, text), std::length_error);
+    EXPECT_THROW(buffer.writeString(kTestCmd::NAME, 7, text), std::length_error);
+    EXPECT_THROW(buffer.writeArray(kTestCmd::NAME, values.data(), values.size()), std::length_error);
+    EXPECT_THROW(buffer.writeArray(kTestCmd::NAME, values.data(), SIZE_MAX / 4), std::length_error);  // count * size overflows
+
+    // Nothing of the failed records was written.
+    buffer.write(kTestCmd::VALUE, 2);
+    EXPECT_EQ(readValues(buffer), std::vector<int>({ 1, 2 }));
+}
+
+TEST(CommandStream, OversizedRecordThrows) {
+    CommandStream<kTestCmd, 256> stream;
+    stream.write(kTestCmd::VALUE, 1);
+    EXPECT_THROW(stream.writeString(kTestCmd::NAME, 7, std::string(1000, 'x')), std::length_error);
+    EXPECT_THROW(stream.writeArray(kTestCmd::NAME, (const double*)nullptr, SIZE_MAX / 4), std::length_error);
+    stream.write(kTestCmd::VALUE, 2);
+    stream.flush();
+
+    EXPECT_EQ(stream.readNext(), kTestCmd::VALUE);
+    EXPECT_EQ(*stream.read<int>(), 1);
+    EXPECT_EQ(stream.readNext(), kTestCmd::VALUE);
+    EXPECT_EQ(*stream.read<int>(), 2);
+    EXPECT_EQ(stream.readNext(), kTestCmd::NONE);
+}
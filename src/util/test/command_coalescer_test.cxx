@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "command_coalescer.hxx"
+
+enum class kCoalesceCmd { NONE = 0, SET_SIZE, SET_TITLE, SET_NAME, LOG, TAKE, COUNT };
+
+static std::vector<std::string> executed;
+
+struct SetSize {
+    int window, size;
+    uint64_t mergeKey () const { return window; }
+    void execute () { executed.push_back("size " + std::to_string(window) + "=" + std::to_string(size)); }
+};
+struct SetTitle {
+    int window;
+    uint64_t mergeKey () const { return window; }
+    void execute (std::string_view title) { executed.push_back("title " + std::to_string(window) + "=" + std::string(title)); }
+};
+struct SetName {        // managed (non-POD) record w/ a merge key
+    int         window;
+    std::string name;
+    uint64_t mergeKey () const { return window; }
+    void execute () { executed.push_back("name " + std::to_string(window) + "=" + name); }
+};
+struct Log {            // no merge key: never folded
+    int value;
+    void execute () { executed.push_back("log " + std::to_string(value)); }
+};
+struct Take {           // move-only
+    std::unique_ptr<int> value;
+    uint64_t mergeKey () const { return 0; }
+    void execute () { executed.push_back("take " + std::to_string(*value)); }
+};
+
+typedef CommandSet<kCoalesceCmd,
+    CommandPair<kCoalesceCmd::SET_SIZE,  SetSize>,
+    CommandPair<kCoalesceCmd::SET_TITLE, SetTitle, char>,
+    CommandPair<kCoalesceCmd::SET_NAME,  SetName>,
+    CommandPair<kCoalesceCmd::LOG,       Log>,
+    CommandPair<kCoalesceCmd::TAKE,      Take>
+> CoalesceSet;
+typedef CommandBuffer<kCoalesceCmd, 256> CoalesceBuffer;   // small chunks: tests span several
+typedef CommandCoalescer<CoalesceSet, CoalesceBuffer> Coalescer;
+
+static std::vector<std::string> run (CoalesceBuffer& buffer) {
+    executed.clear();
+    CoalesceSet::dispatch(buffer);
+    return executed;
+}
+
+TEST(CommandCoalescer, KeepsLastWritePerKeyAtItsPosition) {
+    CoalesceBuffer buffer;
+    CoalesceSet::write(buffer, SetSize { 1, 10 });
+    CoalesceSet::write(buffer, SetSize { 2, 20 });
+    CoalesceSet::write(buffer, Log { 0 });
+    CoalesceSet::write(buffer, SetSize { 1, 11 });
+    CoalesceSet::write(buffer, SetTitle { 1 }, "a");
+    CoalesceSet::write(buffer, SetTitle { 1 }, "b");
+    CoalesceSet::write(buffer, Log { 1 });
+
+    Coalescer coalescer;
+    coalescer.coalesce(buffer);
+    EXPECT_EQ(run(buffer), std::vector<std::string>({ "size 2=20", "log 0", "size 1=11", "title 1=b", "log 1" }));
+}
+
+TEST(CommandCoalescer, PreservesOrderOfUnkeyedCommands) {
+    CoalesceBuffer buffer;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 100; ++i) {
+        CoalesceSet::write(buffer, Log { i });
+        CoalesceSet::write(buffer, SetSize { 0, i });
+        expected.push_back("log " + std::to_string(i));
+    }
+    expected.push_back("size 0=99");
+
+    Coalescer coalescer;
+    coalescer.coalesce(buffer);
+    EXPECT_EQ(run(buffer), expected);
+}
+
+TEST(CommandCoalescer, CountsFoldedRecords) {
+    Coalescer coalescer;
+    for (int pass = 0; pass < 3; ++pass) {
+        CoalesceBuffer buffer;
+        for (int i = 0; i < 10; ++i)
+            CoalesceSet::write(buffer, SetSize { i % 2, i });
+        CoalesceSet::write(buffer, Log { 0 });
+        coalescer.coalesce(buffer);
+
+        EXPECT_EQ(coalescer.lastStats().passes, 1u);
+        EXPECT_EQ(coalescer.lastStats().records, 11u);
+        EXPECT_EQ(coalescer.lastStats().folded, 8u);
+    }
+    EXPECT_EQ(coalescer.totalStats().passes, 3u);
+    EXPECT_EQ(coalescer.totalStats().records, 33u);
+    EXPECT_EQ(coalescer.totalStats().folded, 24u);
+}
+
+TEST(CommandCoalescer, MovesManagedRecords) {
+    CoalesceBuffer buffer;
+    CoalesceSet::write(buffer, SetName { 1, "first" });
+    CoalesceSet::write(buffer, SetName { 1, "second" });
+    CoalesceSet::write(buffer, Take { std::make_unique<int>(7) });
+
+    Coalescer coalescer;
+    coalescer.coalesce(buffer);
+    EXPECT_EQ(run(buffer), std::vector<std::string>({ "name 1=second", "take 7" }));
+}
+
+TEST(CommandCoalescer, CopiesManagedRecordsOutOfSealedBuffers) {
+    CoalesceBuffer buffer;
+    CoalesceSet::write(buffer, SetName { 1, std::string(40, 'a') });
+    CoalesceSet::write(buffer, SetName { 1, std::string(40, 'b') });
+    CoalesceSet::write(buffer, SetName { 2, std::string(40, 'c') });
+    buffer.seal();
+    CoalesceBuffer copy (buffer);      // shares chunks w/ buffer
+
+    Coalescer coalescer;
+    coalescer.coalesce(buffer);
+    EXPECT_EQ(coalescer.lastStats().folded, 1u);
+    EXPECT_EQ(run(buffer).size(), 2u);
+
+    // The shared records weren't relocated out from under the copy.
+    EXPECT_EQ(run(copy), std::vector<std::string>({
+        "name 1=" + std::string(40, 'a'), "name 1=" + std::string(40, 'b'), "name 2=" + std::string(40, 'c') }));
+}
+
+TEST(CommandCoalescer, SealedMoveOnlyRecordsThrow) {
+    CoalesceBuffer buffer;
+    CoalesceSet::write(buffer, SetSize { 1, 1 });
+    CoalesceSet::write(buffer, SetSize { 1, 2 });
+    CoalesceSet::write(buffer, Take { std::make_unique<int>(7) });
+    buffer.seal();
+
+    Coalescer coalescer;
+    EXPECT_THROW(coalescer.coalesce(buffer), std::logic_error);
+    EXPECT_EQ(run(buffer), std::vector<std::string>({ "size 1=1", "size 1=2", "take 7" }));
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "command_recorder.hxx"
+#include "command_set.hxx"
+
+enum class kRecordCmd { NONE = 0, VALUE, TITLE, BUMP, COUNT };
+
+static std::vector<std::string> executed;
+
+struct Value {
+    int value;
+    void execute () { executed.push_back("value " + std::to_string(value)); }
+};
+struct Title {
+    int window;
+    void execute (std::string_view title) { executed.push_back("title " + std::to_string(window) + "=" + std::string(title)); }
+};
+struct Bump {           // modifies itself in execute()
+    int value;
+    void execute () { executed.push_back("bump " + std::to_string(value++)); }
+};
+
+typedef CommandSet<kRecordCmd,
+    CommandPair<kRecordCmd::VALUE, Value>,
+    CommandPair<kRecordCmd::TITLE, Title, char>,
+    CommandPair<kRecordCmd::BUMP,  Bump>
+> RecordSet;
+typedef CommandBuffer<kRecordCmd, 256> RecordBuffer;    // small chunks: frames span several
+
+static std::string tempPath (const char* name) {
+    return testing::TempDir() + name;
+}
+static std::vector<std::string> replay (const CommandReplay& replay, uint32_t stream) {
+    executed.clear();
+    replay.dispatchAll<RecordSet>(stream);
+    return executed;
+}
+
+TEST(CommandRecorder, RoundTripsFramesAndStreams) {
+    auto path = tempPath("round_trip.krec");
+    std::vector<std::string> expected[2];
+    {
+        CommandRecorder recorder (path);
+        for (uint64_t frame = 0; frame < 4; ++frame) {
+            for (uint32_t stream = 0; stream < 2; ++stream) {
+                RecordBuffer buffer;
+                for (int i = 0; i < 50; ++i) {
+                    int value = (int)(frame * 100 + stream * 1000) + i;
+                    RecordSet::write(buffer, Value { value });
+                    expected[stream].push_back("value " + std::to_string(value));
+                }
+                RecordSet::write(buffer, Title { (int)stream }, "frame " + std::to_string(frame));
+                expected[stream].push_back("title " + std::to_string(stream) + "=frame " + std::to_string(frame));
+                recorder.record(stream, frame, buffer);
+            }
+        }
+        recorder.close();
+    }
+    CommandReplay file (path);
+    ASSERT_EQ(file.size(), 8u);
+    EXPECT_EQ(file.entry(3).frame, 1u);
+    EXPECT_EQ(file.entry(3).stream, 1u);
+    EXPECT_EQ(replay(file, 0), expected[0]);
+    EXPECT_EQ(replay(file, 1), expected[1]);
+    std::remove(path.c_str());
+}
+
+TEST(CommandRecorder, RecordsSnapshotNotLaterState) {
+    auto path = tempPath("snapshot.krec");
+    {
+        CommandRecorder recorder (path);
+        RecordBuffer buffer;
+        RecordSet::write(buffer, Bump { 1 });
+        recorder.record(0, 0, buffer);
+
+        // Dispatch (modifies the record in place), then clear + reuse the buffer, before the
+        // writer thread necessarily got to the frame.
+        RecordSet::dispatch(buffer);
+        RecordSet::dispatch(buffer);
+        buffer.clear();
+        RecordSet::write(buffer, Value { 2 });
+        recorder.record(0, 1, buffer);
+    }
+    CommandReplay file (path);
+    EXPECT_EQ(replay(file, 0), std::vector<std::string>({ "bump 1", "value 2" }));
+    std::remove(path.c_str());
+}
+
+TEST(CommandRecorder, RecordAfterCloseThrows) {
+    auto path = tempPath("closed.krec");
+    CommandRecorder recorder (path);
+    RecordBuffer buffer;
+    RecordSet::write(buffer, Value { 1 });
+    recorder.record(0, 0, buffer);
+    recorder.close();
+    EXPECT_THROW(recorder.record(0, 1, buffer), std::logic_error);
+    recorder.flush();   // doesn't block
+    std::remove(path.c_str());
+}
+
+TEST(CommandRecorder, WriteErrorsThrow) {
+    std::FILE* full = std::fopen("/dev/full", "wb");
+    if (!full)
+        GTEST_SKIP() << "no /dev/full";
+    std::fclose(full);
+
+    // The file header is buffered, so the first failure shows up when the writer thread flushes.
+    CommandRecorder recorder ("/dev/full");
+    RecordBuffer buffer;
+    for (int i = 0; i < 1000; ++i)
+        RecordSet::write(buffer, Value { i });
+    recorder.record(0, 0, buffer);
+    EXPECT_THROW(recorder.flush(), std::runtime_error);
+    recorder.record(0, 1, buffer);      // dropped, doesn't block
+    EXPECT_THROW(recorder.close(), std::runtime_error);
+}
+
+static void writeRecording (const std::string& path) {
+    CommandRecorder recorder (path);
+    for (uint64_t frame = 0; frame < 3; ++frame) {
+        RecordBuffer buffer;
+        RecordSet::write(buffer, Value { (int)frame });
+        recorder.record(0, frame, buffer);
+    }
+    recorder.close();
+}
+static std::vector<uint8_t> readFile (const std::string& path) {
+    std::vector<uint8_t> data;
+    auto file = std::fopen(path.c_str(), "rb");
+    for (int c; (c = std::fgetc(file)) != EOF; )
+        data.push_back((uint8_t)c);
+    std::fclose(file);
+    return data;
+}
+static void writeFile (const std::string& path, const std::vector<uint8_t>& data) {
+    auto file = std::fopen(path.c_str(), "wb");
+    std::fwrite(data.data(), 1, data.size(), file);
+    std::fclose(file);
+}
+
+TEST(CommandReplay, RebuildsIndexOfUnclosedRecording) {
+    auto path = tempPath("unclosed.krec");
+    writeRecording(path);
+
+    // Drop the index + footer, and truncate the last frame.
+    auto data = readFile(path);
+    data.erase(data.end() - (sizeof(recording::IndexFooter) + 3 * sizeof(recording::IndexEntry) + 8), data.end());
+    writeFile(path, data);
+
+    CommandReplay file (path);
+    ASSERT_EQ(file.size(), 2u);
+    EXPECT_EQ(replay(file, 0), std::vector<std::string>({ "value 0", "value 1" }));
+    std::remove(path.c_str());
+}
+
+TEST(CommandReplay, RejectsCorruptIndex) {
+    auto path = tempPath("corrupt_index.krec");
+    writeRecording(path);
+
+    auto data = readFile(path);
+    recording::IndexEntry entry;
+    size_t at = data.size() - sizeof(recording::IndexFooter) - sizeof(entry);
+    memcpy(&entry, &data[at], sizeof(entry));
+    entry.offset = 1u << 30;
+    memcpy(&data[at], &entry, sizeof(entry));
+    writeFile(path, data);
+
+    EXPECT_THROW(CommandReplay file (path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST(CommandReplay, RejectsCorruptSegmentSize) {
+    auto path = tempPath("corrupt_segment.krec");
+    writeRecording(path);
+
+    // First frame's first segment claims more data than the file holds.
+    auto data = readFile(path);
+    recording::SegmentHeader segment;
+    size_t at = sizeof(recording::FileHeader) + sizeof(recording::FrameHeader);
+    memcpy(&segment, &data[at], sizeof(segment));
+    segment.size = ~uint64_t(0) - 4;
+    memcpy(&data[at], &segment, sizeof(segment));
+    writeFile(path, data);
+
+    EXPECT_THROW(CommandReplay file (path), std::runtime_error);
+    std::remove(path.c_str());
+}
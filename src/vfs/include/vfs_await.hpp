@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "vfs.hpp"
+#include "threading/coroutine_task.hxx"
+
+// co_await-able FSInstance::loadAsync(), for k::thread::Task coroutines:
+//
+//  k::thread::Task<void> load (FSInstance& fs) {
+//      std::unique_ptr<FileData> file = co_await loadFile(fs, "shaders/basic.fs");  // throws FileException
+//      ...
+//  }
+//
+// The coroutine is suspended (holding no thread) until the file is loaded, then resumes on its own
+// executor. Only the initial load resumes the coroutine; later reloads are ignored.
+// FSInstance only keeps a weak_ptr to the request, so the completion holds it until the load is done.
+inline auto loadFile (FSInstance& fs, std::string path) {
+    typedef std::unique_ptr<FileData> Result;
+    return k::thread::awaitCallback<Result>([&fs, path](k::thread::Completion<Result> done) {
+        done.keepAlive(fs.loadAsync(path,
+            [done](const FileData& file) {
+                auto data = file.data;
+                done.resolve(Result(new FileData(file.path, data)));
+            },
+            [done](const FileException& error) {
+                done.reject(std::make_exception_ptr(error));
+            }));
+    });
+}